@@ -0,0 +1,186 @@
+#include "analyticbeambackend.h"
+
+#include <cmath>
+
+namespace {
+	const double speedOfLight = 299792458.0;
+
+	typedef BeamBackend::Vector3 Vector3;
+
+	double dot(const Vector3& a, const Vector3& b)
+	{
+		return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+	}
+
+	Vector3 cross(const Vector3& a, const Vector3& b)
+	{
+		const Vector3 result = {{ a[1]*b[2] - a[2]*b[1], a[2]*b[0] - a[0]*b[2], a[0]*b[1] - a[1]*b[0] }};
+		return result;
+	}
+
+	Vector3 normalize(const Vector3& a)
+	{
+		const double norm = std::sqrt(dot(a, a));
+		const Vector3 result = {{ a[0]/norm, a[1]/norm, a[2]/norm }};
+		return result;
+	}
+
+	Vector3 toVector(const double* values)
+	{
+		const Vector3 result = {{ values[0], values[1], values[2] }};
+		return result;
+	}
+}
+
+AnalyticBeamBackend::AnalyticBeamBackend(const std::vector<StationLayout>& stations)
+{
+	_stations.reserve(stations.size());
+	for(const StationLayout& layout : stations)
+	{
+		_stations.emplace_back();
+		Station& station = _stations.back();
+		station.name = layout.name;
+		const Vector3 phaseReference = toVector(layout.phaseReference);
+		size_t elementCount = 0;
+		for(const AntennaFieldLayout& fieldLayout : layout.fields)
+		{
+			station.fields.emplace_back();
+			Field& field = station.fields.back();
+			field.p = toVector(fieldLayout.axes[0]);
+			field.q = toVector(fieldLayout.axes[1]);
+			field.r = toVector(fieldLayout.axes[2]);
+			size_t enabledCount[2] = { 0, 0 };
+			for(const ElementLayout& elementLayout : fieldLayout.elements)
+			{
+				Element element;
+				for(size_t i=0; i!=3; ++i)
+					element.position[i] = fieldLayout.origin[i] + elementLayout.offset[i] - phaseReference[i];
+				for(size_t p=0; p!=2; ++p)
+				{
+					element.enabled[p] = elementLayout.enabled[p];
+					if(element.enabled[p])
+						++enabledCount[p];
+				}
+				field.elements.push_back(element);
+			}
+			for(size_t p=0; p!=2; ++p)
+				field.normalization[p] = enabledCount[p] == 0 ? 0.0 : 1.0 / enabledCount[p];
+			if(fieldLayout.hasTileConfig)
+			{
+				for(size_t i=0; i!=16; ++i)
+					field.tileElements.push_back(toVector(fieldLayout.tileConfig[i]));
+			}
+			elementCount += field.elements.size();
+		}
+		if(station.fields.empty())
+		{
+			// A single element at the station position, with the dipoles along
+			// the local east and north directions
+			Field field;
+			const Vector3 position = toVector(layout.position);
+			const Vector3 pole = {{ 0.0, 0.0, 1.0 }};
+			if(dot(position, position) == 0.0)
+			{
+				field.p = {{ 1.0, 0.0, 0.0 }};
+				field.q = {{ 0.0, 1.0, 0.0 }};
+				field.r = pole;
+			}
+			else {
+				field.r = normalize(position);
+				field.p = normalize(cross(pole, field.r));
+				field.q = cross(field.r, field.p);
+			}
+			Element element;
+			for(size_t i=0; i!=3; ++i)
+				element.position[i] = position[i] - phaseReference[i];
+			element.enabled[0] = true;
+			element.enabled[1] = true;
+			field.elements.push_back(element);
+			field.normalization[0] = 1.0;
+			field.normalization[1] = 1.0;
+			station.fields.push_back(field);
+			elementCount = 1;
+		}
+		for(Field& field : station.fields)
+			field.weight = elementCount == 0 ? 0.0 : double(field.elements.size()) / elementCount;
+	}
+}
+
+void AnalyticBeamBackend::addFieldResponse(const Field& field, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, const double* frequencies, size_t frequencyCount, std::complex<double>* jones, size_t jonesStride)
+{
+	const double cosZenith = dot(direction, field.r);
+	if(cosZenith <= 0.0)
+		return;
+	// Horizontal dipole a quarter wavelength above a ground plane
+	const double groundFactor = std::sin(0.5 * M_PI * cosZenith) * field.weight;
+
+	// Project the dipoles on a basis perpendicular to the direction, of which
+	// the first axis is aligned with the P dipole
+	const double pAlongDirection = dot(field.p, direction);
+	const Vector3 pPerpendicular = {{
+		field.p[0] - pAlongDirection*direction[0],
+		field.p[1] - pAlongDirection*direction[1],
+		field.p[2] - pAlongDirection*direction[2] }};
+	if(dot(pPerpendicular, pPerpendicular) < 1e-24)
+		return;
+	const Vector3 x = normalize(pPerpendicular);
+	const Vector3 y = cross(direction, x);
+	const double element[4] = { dot(field.p, x), dot(field.p, y), dot(field.q, x), dot(field.q, y) };
+
+	const Vector3 delayOffset = {{
+		direction[0] - delayDirection[0],
+		direction[1] - delayDirection[1],
+		direction[2] - delayDirection[2] }};
+	const Vector3 tileOffset = {{
+		direction[0] - tileBeamDirection[0],
+		direction[1] - tileBeamDirection[1],
+		direction[2] - tileBeamDirection[2] }};
+	for(size_t f=0; f!=frequencyCount; ++f)
+	{
+		const double waveNumber = 2.0 * M_PI * frequencies[f] / speedOfLight;
+		std::complex<double> arrayFactor[2] = { 0.0, 0.0 };
+		for(const Element& e : field.elements)
+		{
+			const std::complex<double> phasor = std::polar(1.0, waveNumber * dot(e.position, delayOffset));
+			if(e.enabled[0])
+				arrayFactor[0] += phasor;
+			if(e.enabled[1])
+				arrayFactor[1] += phasor;
+		}
+		std::complex<double> gain = groundFactor;
+		if(!field.tileElements.empty())
+		{
+			std::complex<double> tileFactor = 0.0;
+			for(const Vector3& position : field.tileElements)
+				tileFactor += std::polar(1.0, waveNumber * dot(position, tileOffset));
+			gain *= tileFactor / double(field.tileElements.size());
+		}
+		const std::complex<double> gainX = gain * arrayFactor[0] * field.normalization[0];
+		const std::complex<double> gainY = gain * arrayFactor[1] * field.normalization[1];
+		std::complex<double>* matrix = jones + f * jonesStride;
+		matrix[0] += gainX * element[0];
+		matrix[1] += gainX * element[1];
+		matrix[2] += gainY * element[2];
+		matrix[3] += gainY * element[3];
+	}
+}
+
+void AnalyticBeamBackend::Response(size_t station, double, double frequency, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const
+{
+	for(size_t i=0; i!=4; ++i)
+		jones[i] = 0.0;
+	for(const Field& field : _stations[station].fields)
+		addFieldResponse(field, direction, delayDirection, tileBeamDirection, &frequency, 1, jones, 4);
+}
+
+void AnalyticBeamBackend::Responses(double, const double* frequencies, size_t frequencyCount, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const
+{
+	const size_t stationCount = _stations.size();
+	for(size_t i=0; i!=frequencyCount*stationCount*4; ++i)
+		jones[i] = 0.0;
+	for(size_t station=0; station!=stationCount; ++station)
+	{
+		for(const Field& field : _stations[station].fields)
+			addFieldResponse(field, direction, delayDirection, tileBeamDirection, frequencies, frequencyCount, jones + station*4, stationCount*4);
+	}
+}
@@ -0,0 +1,74 @@
+#ifndef ANALYTIC_BEAM_BACKEND_H
+#define ANALYTIC_BEAM_BACKEND_H
+
+#include "beambackend.h"
+
+/**
+ * Beam backend with an analytic model that does not need any external
+ * library. Every element is a pair of ideal, orthogonal dipoles along the
+ * P and Q axes of its antenna field, a quarter wavelength above a ground
+ * plane. The station response is the element response multiplied with the
+ * array factor of the enabled elements, steered towards the delay
+ * direction, and for HBA fields with the array factor of the tile, steered
+ * towards the tile beam direction. Stations with several antenna fields
+ * (e.g. split HBA core stations) are averaged, weighted by their number of
+ * elements. Stations without LOFAR antenna fields are modelled as a single
+ * element at the station position, with horizontal dipoles along the east
+ * and north directions.
+ *
+ * The responses have the right order of magnitude and the right dependence
+ * on direction, frequency and time, but they are not a substitute for the
+ * LOFAR beam model: the backend is meant to run and benchmark the pipeline
+ * on machines without the LOFAR libraries.
+ */
+class AnalyticBeamBackend : public BeamBackend
+{
+public:
+	explicit AnalyticBeamBackend(const std::vector<StationLayout>& stations);
+
+	const char* Name() const override { return "analytic"; }
+
+	size_t StationCount() const override { return _stations.size(); }
+
+	const std::string& StationName(size_t station) const override { return _stations[station].name; }
+
+	void Response(size_t station, double time, double frequency, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const override;
+
+	void Responses(double time, const double* frequencies, size_t frequencyCount, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const override;
+
+private:
+	struct Element
+	{
+		/** ITRF position relative to the phase reference of the station. */
+		Vector3 position;
+		bool enabled[2];
+	};
+
+	struct Field
+	{
+		Vector3 p, q, r;
+		std::vector<Element> elements;
+		/** Inverse of the number of enabled X and Y dipoles, or zero. */
+		double normalization[2];
+		/** Element offsets of an HBA tile; empty for LBA fields. */
+		std::vector<Vector3> tileElements;
+		/** Fraction of the elements of the station that are in this field. */
+		double weight;
+	};
+
+	struct Station
+	{
+		std::string name;
+		std::vector<Field> fields;
+	};
+
+	/**
+	 * Adds the response of one antenna field to the matrices for the given
+	 * frequencies, which are jonesStride values apart.
+	 */
+	static void addFieldResponse(const Field& field, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, const double* frequencies, size_t frequencyCount, std::complex<double>* jones, size_t jonesStride);
+
+	std::vector<Station> _stations;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#include "beambackend.h"
+
+#include "analyticbeambackend.h"
+
+#ifdef HAVE_LOFAR_BEAM
+#include "lofarbeambackend.h"
+#endif
+
+#include <stdexcept>
+
+void BeamBackend::Responses(double time, const double* frequencies, size_t frequencyCount, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const
+{
+	const size_t stationCount = StationCount();
+	for(size_t f=0; f!=frequencyCount; ++f)
+	{
+		for(size_t station=0; station!=stationCount; ++station)
+			Response(station, time, frequencies[f], direction, delayDirection, tileBeamDirection, jones + (f*stationCount + station)*4);
+	}
+}
+
+std::vector<std::string> BeamBackendNames()
+{
+	std::vector<std::string> names;
+#ifdef HAVE_LOFAR_BEAM
+	names.push_back("lofar");
+#endif
+	names.push_back("analytic");
+	return names;
+}
+
+std::shared_ptr<const BeamBackend> CreateBeamBackend(const std::string& name, const std::vector<StationLayout>& stations)
+{
+#ifdef HAVE_LOFAR_BEAM
+	if(name == "lofar")
+		return std::make_shared<LofarBeamBackend>(stations);
+#endif
+	if(name == "analytic")
+		return std::make_shared<AnalyticBeamBackend>(stations);
+	throw std::runtime_error("Beam backend '" + name + "' is not available in this build");
+}
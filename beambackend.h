@@ -0,0 +1,70 @@
+#ifndef BEAM_BACKEND_H
+#define BEAM_BACKEND_H
+
+#include "stationlayout.h"
+
+#include <array>
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Evaluates the beam responses of the stations of an observation. The
+ * response calculation only uses this interface, so that it can run with
+ * the LOFAR station response library or with an analytic model that does
+ * not need any external library.
+ *
+ * Directions are ITRF unit vectors, see @ref DirectionConverter. Jones
+ * matrices are stored as 4 complex values in row-major order. The
+ * evaluation functions are const and can be called concurrently from
+ * several threads.
+ */
+class BeamBackend
+{
+public:
+	typedef std::array<double, 3> Vector3;
+
+	virtual ~BeamBackend() { }
+
+	/**
+	 * Name of the backend, as used to select it. It is included in the keys
+	 * of cached responses, because the backends give different responses.
+	 */
+	virtual const char* Name() const = 0;
+
+	virtual size_t StationCount() const = 0;
+
+	virtual const std::string& StationName(size_t station) const = 0;
+
+	/**
+	 * Calculates the Jones matrix of a single station.
+	 * @param delayDirection Direction towards which the station beam is formed.
+	 * @param tileBeamDirection Direction towards which the analog tile beam is
+	 * formed (HBA only).
+	 */
+	virtual void Response(size_t station, double time, double frequency, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const = 0;
+
+	/**
+	 * Calculates the Jones matrices of all stations for several frequencies.
+	 * The default implementation calls @ref Response() for every station and
+	 * frequency; backends can override it to share the work that does not
+	 * depend on the frequency.
+	 * @param jones Array of frequencyCount x StationCount() matrices.
+	 */
+	virtual void Responses(double time, const double* frequencies, size_t frequencyCount, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const;
+};
+
+/**
+ * Names of the backends that are available in this build. The first one is
+ * the default.
+ */
+std::vector<std::string> BeamBackendNames();
+
+/**
+ * Creates a backend for the given station layouts. Throws when no backend
+ * with the given name is available.
+ */
+std::shared_ptr<const BeamBackend> CreateBeamBackend(const std::string& name, const std::vector<StationLayout>& stations);
+
+#endif
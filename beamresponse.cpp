@@ -0,0 +1,33 @@
+#include "beamresponse.h"
+
+#include "profiler.h"
+
+#include <aocommon/matrix2x2.h>
+
+#include <algorithm>
+
+using aocommon::MC2x2;
+
+void stationGains(const BeamBackend& beam, double time, double frequency, const BeamBackend::Vector3& direction, const BeamBackend::Vector3& delayDir, const BeamBackend::Vector3& tileBeamDir, double& maxGain, double& averageGain)
+{
+	MC2x2 response = MC2x2::Zero();
+	const size_t count = beam.StationCount();
+	Profiler::Count(Profiler::ResponseCalls, count);
+	double maxEigenValue = 0.0;
+	for(size_t station=0; station!=count; ++station)
+	{
+		std::complex<double> gainMatrix[4];
+		beam.Response(station, time, frequency, direction, delayDir, tileBeamDir, gainMatrix);
+
+		MC2x2 stationResponse( gainMatrix[0], gainMatrix[1], gainMatrix[2], gainMatrix[3] );
+		response += stationResponse;
+		std::complex<double> e1,e2;
+		stationResponse.EigenValues(e1, e2);
+		maxEigenValue = std::max(maxEigenValue, std::max(std::abs(e1), std::abs(e2)));
+	}
+	response = response * (1.0 / count);
+	std::complex<double> e1, e2;
+	response.EigenValues(e1, e2);
+	maxGain = maxEigenValue;
+	averageGain = std::max(std::abs(e1), std::abs(e2));
+}
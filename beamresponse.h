@@ -0,0 +1,14 @@
+#ifndef BEAM_RESPONSE_H
+#define BEAM_RESPONSE_H
+
+#include "beambackend.h"
+
+/**
+ * Calculates the beam gain towards an ITRF direction for unit flux density.
+ * maxGain is set to the largest eigenvalue of the responses of the
+ * individual stations, and averageGain to the largest eigenvalue of the
+ * station-averaged response.
+ */
+void stationGains(const BeamBackend& beam, double time, double frequency, const BeamBackend::Vector3& direction, const BeamBackend::Vector3& delayDir, const BeamBackend::Vector3& tileBeamDir, double& maxGain, double& averageGain);
+
+#endif
@@ -0,0 +1,302 @@
+/*
+ * End-to-end benchmark of the response calculation. It creates a synthetic
+ * measurement set and model, runs the phases of a sourceresponse run on
+ * them and reports the time spent in every phase as JSON, so that runs on
+ * different versions or machines can be compared.
+ */
+#include "syntheticdata.h"
+
+#include "../beambackend.h"
+#include "../metadata.h"
+#include "../observation.h"
+#include "../responseengine.h"
+#include "../responseoutput.h"
+
+#include "../model/model.h"
+
+#include <aocommon/parallelfor.h>
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	class Stopwatch
+	{
+	public:
+		Stopwatch() : _start(std::chrono::steady_clock::now()) { }
+
+		double Seconds() const
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+		}
+
+	private:
+		std::chrono::steady_clock::time_point _start;
+	};
+
+	std::string jsonString(const std::string& value)
+	{
+		std::string result = "\"";
+		for(char c : value)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			if(static_cast<unsigned char>(c) < 0x20)
+				result += ' ';
+			else
+				result += c;
+		}
+		return result + '"';
+	}
+
+	void printUsage()
+	{
+		std::cout <<
+			"Syntax: sourceresponse-benchmark [options]\n"
+			"Creates a synthetic measurement set and model, calculates the responses\n"
+			"and writes the time spent in every phase as JSON to standard output.\n"
+			"Options:\n"
+			"-stations <n>            Number of stations. Default: 24.\n"
+			"-elements <n>            Number of elements per station. Default: 48.\n"
+			"-timesteps <n>           Number of timesteps. Default: 100.\n"
+			"-channels <n>            Number of channels. Default: 64.\n"
+			"-rows-per-timestep <n>   Rows in the main table per timestep. Default: all baselines.\n"
+			"-frequencies <n>         Number of frequencies, spread over the channels, at which\n"
+			"                         the response is calculated. Default: 1.\n"
+			"-sources <n>             Number of sources in the model. Default: 1000.\n"
+			"-components <n>          Number of components per source. Default: 1.\n"
+			"-beam <name>             Beam backend. Default: " << BeamBackendNames().front() << ".\n"
+			"-threads <n>             Number of threads. Default: all cores.\n"
+			"-directory <dir>         Directory for the synthetic data and outputs. Default:\n"
+			"                         sourceresponse-benchmark.tmp\n"
+			"-keep                    Keep the synthetic data and outputs.\n"
+			"-label <text>            Label that is included in the output, e.g. a version.\n"
+			"-output <file>           Write the JSON to a file instead of standard output.\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	SyntheticMSOptions msOptions;
+	SyntheticModelOptions modelOptions;
+	size_t frequencyCount = 1;
+	std::string beamName = BeamBackendNames().front();
+	size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+	std::string directory = "sourceresponse-benchmark.tmp";
+	bool keep = false;
+	std::string label, outputFilename;
+	for(int argi=1; argi!=argc; ++argi)
+	{
+		const std::string param = argv[argi][0] == '-' ? &argv[argi][1] : "";
+		const bool hasValue = argi+1 < argc;
+		if(param == "stations" && hasValue)
+			msOptions.stationCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "elements" && hasValue)
+			msOptions.elementsPerStation = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "timesteps" && hasValue)
+			msOptions.timestepCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "channels" && hasValue)
+			msOptions.channelCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "rows-per-timestep" && hasValue)
+			msOptions.rowsPerTimestep = std::max(0ll, std::atoll(argv[++argi]));
+		else if(param == "frequencies" && hasValue)
+			frequencyCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "sources" && hasValue)
+			modelOptions.sourceCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "components" && hasValue)
+			modelOptions.componentsPerSource = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "beam" && hasValue)
+			beamName = argv[++argi];
+		else if(param == "threads" && hasValue)
+			threadCount = std::max(1ll, std::atoll(argv[++argi]));
+		else if(param == "directory" && hasValue)
+			directory = argv[++argi];
+		else if(param == "keep")
+			keep = true;
+		else if(param == "label" && hasValue)
+			label = argv[++argi];
+		else if(param == "output" && hasValue)
+			outputFilename = argv[++argi];
+		else {
+			printUsage();
+			return -1;
+		}
+	}
+	frequencyCount = std::min(frequencyCount, msOptions.channelCount);
+	modelOptions.ra = msOptions.ra;
+	modelOptions.dec = msOptions.dec;
+
+	if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("Could not create directory " + directory);
+	const std::string msFilename = directory + "/synthetic.ms";
+	const std::string modelFilename = directory + "/synthetic-model.txt";
+
+	std::vector<std::pair<std::string, double>> phases;
+	Stopwatch generateWatch;
+	CreateSyntheticMS(msFilename, msOptions);
+	CreateSyntheticModel(modelFilename, modelOptions);
+	const double generateTime = generateWatch.Seconds();
+
+	// Without the binary cache, so that the text parsing is measured
+	Stopwatch watch;
+	Model model(modelFilename, false);
+	phases.emplace_back("model_parse", watch.Seconds());
+
+	// The phases call the same library and output functions as sourceresponse
+	watch = Stopwatch();
+	std::unique_ptr<casacore::MeasurementSet> ms;
+	const MetaData metaData = ReadMetaData(msFilename, std::string(), ms);
+	StationCache stationCache(beamName);
+	std::shared_ptr<const BeamBackend> beam = ReadBeam(metaData, stationCache);
+	phases.emplace_back("ms_open", watch.Seconds());
+
+	watch = Stopwatch();
+	TimeIndex timeIndex = ReadTimeIndex(*ms, metaData, TimeSelection());
+	const size_t rowCount = timeIndex.rowCount;
+	ms.reset();
+	phases.emplace_back("time_index", watch.Seconds());
+
+	const aocommon::BandData band = metaData.Band(0);
+	std::vector<double> frequencies(frequencyCount);
+	for(size_t f=0; f!=frequencyCount; ++f)
+		frequencies[f] = band.ChannelFrequency((2 * f + 1) * band.ChannelCount() / (2 * frequencyCount));
+
+	watch = Stopwatch();
+	const ObservationInfo info = MakeObservationInfo(metaData, beam, std::move(timeIndex), 1, frequencies);
+	phases.emplace_back("direction_conversion", watch.Seconds());
+
+	struct Direction
+	{
+		double ra, dec;
+		std::string name;
+	};
+	std::vector<Direction> directions;
+	std::vector<double> fluxes;
+	for(const ModelSource& source : model)
+	{
+		for(size_t c=0; c!=source.ComponentCount(); ++c)
+		{
+			const ModelComponent& component = source.Component(c);
+			directions.push_back(Direction{ double(component.PosRA()), double(component.PosDec()), ComponentName(source, c) });
+			for(double frequency : frequencies)
+				fluxes.push_back(std::fabs(component.SED().FluxAtFrequency(frequency, aocommon::Polarization::StokesI)));
+		}
+	}
+	const FieldInfo& field = info.fields.front();
+	const std::vector<double>& times = field.times;
+	const size_t timeCount = times.size();
+	const size_t valuesPerDirection = timeCount * frequencyCount;
+
+	// The gains for unit flux density, which the outputs scale with the flux density
+	watch = Stopwatch();
+	std::vector<double> maxGains(directions.size() * valuesPerDirection), averageGains(maxGains.size());
+	aocommon::ParallelFor<size_t> loop(threadCount);
+	loop.Run(0, directions.size(), [&](size_t d, size_t)
+	{
+		field.engine->ApparentFluxes(&directions[d].ra, &directions[d].dec, 1, 0, timeCount,
+			frequencies.data(), frequencyCount, nullptr,
+			&maxGains[d * valuesPerDirection], &averageGains[d * valuesPerDirection]);
+	});
+	const double evaluationTime = watch.Seconds();
+	phases.emplace_back("response_evaluation", evaluationTime);
+
+	// One file per component and frequency and the plot scripts, as written by sourceresponse
+	watch = Stopwatch();
+	const std::string outputDirectory = directory + "/";
+	std::vector<std::string> outputFilenames;
+	PlotScript maxPlot, averagePlot;
+	maxPlot.Open(outputDirectory, "response-max", 2);
+	averagePlot.Open(outputDirectory, "response-avg", 3);
+	outputFilenames.push_back(outputDirectory + "response-max.plt");
+	outputFilenames.push_back(outputDirectory + "response-avg.plt");
+	std::vector<ResponseCache::Sample> samples(timeCount);
+	for(size_t d=0; d!=directions.size(); ++d)
+	{
+		for(size_t f=0; f!=frequencyCount; ++f)
+		{
+			for(size_t t=0; t!=timeCount; ++t)
+			{
+				const size_t index = d * valuesPerDirection + t * frequencyCount + f;
+				samples[t].time = times[t] - times.front();
+				samples[t].maxGain = maxGains[index];
+				samples[t].averageGain = averageGains[index];
+			}
+			const std::string name = OutputName(directions[d].name, info, field, frequencies[f]);
+			const std::string filename = outputDirectory + name + ".txt";
+			outputFilenames.push_back(filename);
+			std::ofstream file(filename);
+			file << FormatSamples(samples.data(), samples.data() + timeCount, fluxes[d * frequencyCount + f]);
+			if(!file.good())
+				throw std::runtime_error("Could not write " + filename);
+			maxPlot.AddOutput(name);
+			averagePlot.AddOutput(name);
+		}
+	}
+	maxPlot.Close();
+	averagePlot.Close();
+	phases.emplace_back("output", watch.Seconds());
+
+	double totalTime = 0.0;
+	for(const std::pair<std::string, double>& phase : phases)
+		totalTime += phase.second;
+	const size_t evaluationCount = directions.size() * valuesPerDirection;
+
+	std::ostringstream json;
+	json.precision(9);
+	json << "{\n"
+		"  \"benchmark\": \"end-to-end\",\n"
+		"  \"label\": " << jsonString(label) << ",\n"
+		"  \"parameters\": {\n"
+		"    \"stations\": " << msOptions.stationCount << ",\n"
+		"    \"elements_per_station\": " << msOptions.elementsPerStation << ",\n"
+		"    \"timesteps\": " << msOptions.timestepCount << ",\n"
+		"    \"channels\": " << msOptions.channelCount << ",\n"
+		"    \"rows\": " << rowCount << ",\n"
+		"    \"frequencies\": " << frequencyCount << ",\n"
+		"    \"sources\": " << modelOptions.sourceCount << ",\n"
+		"    \"components\": " << directions.size() << ",\n"
+		"    \"beam\": " << jsonString(beam->Name()) << ",\n"
+		"    \"threads\": " << threadCount << "\n"
+		"  },\n"
+		"  \"generate_seconds\": " << generateTime << ",\n"
+		"  \"phases\": {\n";
+	for(size_t i=0; i!=phases.size(); ++i)
+		json << "    " << jsonString(phases[i].first) << ": " << phases[i].second << (i+1 == phases.size() ? "\n" : ",\n");
+	json << "  },\n"
+		"  \"total_seconds\": " << totalTime << ",\n"
+		"  \"evaluations\": " << evaluationCount << ",\n"
+		"  \"evaluations_per_second\": " << (evaluationCount / evaluationTime) << "\n"
+		"}\n";
+	if(outputFilename.empty())
+		std::cout << json.str();
+	else {
+		std::ofstream file(outputFilename);
+		file << json.str();
+	}
+
+	if(!keep)
+	{
+		for(const std::string& filename : outputFilenames)
+			std::remove(filename.c_str());
+		std::remove(modelFilename.c_str());
+		casacore::Table::deleteTable(msFilename, true);
+		rmdir(directory.c_str());
+	}
+}
@@ -0,0 +1,332 @@
+/*
+ * Micro-benchmarks of the hot paths of the model code: SED evaluation,
+ * spectral fitting, model parsing and coordinate parsing. For every
+ * benchmark, the time and the number of heap allocations per call are
+ * written as JSON.
+ *
+ * Allocations are counted by replacing the global operator new, so that
+ * allocations inside the library are counted as well.
+ */
+#include "syntheticdata.h"
+
+#include "../nlplfitter.h"
+#include "../polynomialfitter.h"
+
+#include "../model/measuredsed.h"
+#include "../model/model.h"
+#include "../model/modelparser.h"
+#include "../model/powerlawsed.h"
+
+#include "../units/radeccoord.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	std::atomic<size_t> allocationCount(0);
+}
+
+void* operator new(std::size_t size)
+{
+	++allocationCount;
+	if(void* pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
+
+namespace {
+	/** Keeps the results of the benchmarked calls alive. */
+	volatile double sink;
+
+	struct Result
+	{
+		std::string name;
+		size_t calls;
+		double nsPerCall;
+		double allocationsPerCall;
+	};
+
+	/**
+	 * Runs call(i) for i in [0, warmupCalls) to warm up, and then for i in
+	 * [0, calls) while measuring the time and allocations.
+	 */
+	template<typename Function>
+	Result measure(const std::string& name, size_t calls, Function call, size_t warmupCalls = 100)
+	{
+		for(size_t i=0; i!=std::min(calls, warmupCalls); ++i)
+			call(i);
+		const size_t allocationsBefore = allocationCount;
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		for(size_t i=0; i!=calls; ++i)
+			call(i);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		const size_t allocations = allocationCount - allocationsBefore;
+		Result result;
+		result.name = name;
+		result.calls = calls;
+		result.nsPerCall = seconds * 1e9 / calls;
+		result.allocationsPerCall = double(allocations) / calls;
+		std::cerr << name << ": " << result.nsPerCall << " ns/call, " << result.allocationsPerCall << " allocations/call\n";
+		return result;
+	}
+
+	/**
+	 * Fluxes of a spectrum with a spectral index around -0.7, some
+	 * curvature and 5% noise, at frequencies between 100 and 200 MHz.
+	 */
+	void randomSpectrum(std::mt19937& rng, size_t pointCount, std::vector<double>& frequencies, std::vector<double>& fluxes)
+	{
+		std::normal_distribution<double> spectralIndex(-0.7, 0.2), curvature(0.0, 0.1), noise(0.0, 0.05);
+		std::uniform_real_distribution<double> logFlux(-1.0, 2.0);
+		const double flux150 = std::pow(10.0, logFlux(rng));
+		const double a = spectralIndex(rng), b = curvature(rng);
+		frequencies.resize(pointCount);
+		fluxes.resize(pointCount);
+		for(size_t i=0; i!=pointCount; ++i)
+		{
+			frequencies[i] = 100e6 + 100e6 * i / std::max<size_t>(1, pointCount - 1);
+			const double x = std::log10(frequencies[i] / 150e6);
+			fluxes[i] = flux150 * std::pow(10.0, a*x + b*x*x) + flux150 * noise(rng);
+		}
+	}
+
+	std::string formatSexagesimal(double value, char first, char second, char third, bool hasSign)
+	{
+		std::ostringstream str;
+		if(value < 0.0)
+			str << '-';
+		else if(hasSign)
+			str << '+';
+		value = std::fabs(value);
+		const int whole = int(value);
+		const int minutes = int((value - whole) * 60.0);
+		const double seconds = ((value - whole) * 60.0 - minutes) * 60.0;
+		str << whole << first << minutes << second;
+		str.precision(3);
+		str << std::fixed << seconds;
+		if(third != 0)
+			str << third;
+		return str.str();
+	}
+
+	void printUsage()
+	{
+		std::cout <<
+			"Syntax: sourceresponse-microbenchmarks [options]\n"
+			"Writes the time and allocations per call of the hot paths of the model\n"
+			"code as JSON to standard output.\n"
+			"Options:\n"
+			"-scale <factor>    Multiply the number of calls per benchmark. Default: 1.\n"
+			"-label <text>      Label that is included in the output, e.g. a version.\n"
+			"-output <file>     Write the JSON to a file instead of standard output.\n";
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	double scale = 1.0;
+	std::string label, outputFilename;
+	for(int argi=1; argi!=argc; ++argi)
+	{
+		const std::string param = argv[argi][0] == '-' ? &argv[argi][1] : "";
+		if(param == "scale" && argi+1 < argc)
+			scale = std::max(0.001, std::atof(argv[++argi]));
+		else if(param == "label" && argi+1 < argc)
+			label = argv[++argi];
+		else if(param == "output" && argi+1 < argc)
+			outputFilename = argv[++argi];
+		else {
+			printUsage();
+			return -1;
+		}
+	}
+	auto callCount = [scale](size_t calls) { return std::max<size_t>(1, size_t(calls * scale)); };
+
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::vector<Result> results;
+
+	// Measured SEDs with 2 to 8 measurements; evaluated inside and outside
+	// the measured range
+	{
+		std::vector<MeasuredSED> seds(1000);
+		std::vector<double> frequencies, fluxes;
+		for(MeasuredSED& sed : seds)
+		{
+			randomSpectrum(rng, 2 + rng() % 7, frequencies, fluxes);
+			for(size_t i=0; i!=frequencies.size(); ++i)
+				sed.AddMeasurement(fluxes[i], frequencies[i]);
+		}
+		std::vector<double> evaluationFrequencies(997);
+		for(double& frequency : evaluationFrequencies)
+			frequency = 50e6 + 200e6 * uniform(rng);
+		results.push_back(measure("MeasuredSED::FluxAtFrequencyFromIndex", callCount(2000000), [&](size_t i)
+		{
+			sink = seds[i % seds.size()].FluxAtFrequencyFromIndex(evaluationFrequencies[i % evaluationFrequencies.size()], 0);
+		}));
+	}
+
+	// Power laws with 1 to 3 spectral terms, integrated over 0.2 to 10 MHz
+	{
+		std::vector<PowerLawSED> seds(1000);
+		std::normal_distribution<double> term(0.0, 0.2);
+		for(PowerLawSED& sed : seds)
+		{
+			const double brightness[4] = { std::pow(10.0, 3.0*uniform(rng) - 1.0), 0.0, 0.0, 0.0 };
+			std::vector<double> terms(1 + rng() % 3);
+			terms[0] = -0.7 + term(rng);
+			for(size_t t=1; t!=terms.size(); ++t)
+				terms[t] = term(rng);
+			sed.SetData(150e6, brightness, terms);
+		}
+		std::vector<std::pair<double, double>> ranges(997);
+		for(std::pair<double, double>& range : ranges)
+		{
+			range.first = 100e6 + 80e6 * uniform(rng);
+			range.second = range.first + 0.2e6 + 9.8e6 * uniform(rng);
+		}
+		results.push_back(measure("PowerLawSED::IntegratedFlux", callCount(200000), [&](size_t i)
+		{
+			const std::pair<double, double>& range = ranges[i % ranges.size()];
+			sink = seds[i % seds.size()].IntegratedFlux(range.first, range.second, aocommon::Polarization::StokesI);
+		}));
+	}
+
+	// Spectra with 8 to 32 points. Fitting changes the state of the fitter,
+	// so every call uses its own, prepared fitter.
+	{
+		const size_t calls = callCount(5000);
+		std::vector<double> frequencies, fluxes;
+		std::vector<std::unique_ptr<NonLinearPowerLawFitter>> fitters(calls), stableFitters(calls);
+		PolynomialFitter polynomialFitters[16];
+		std::vector<size_t> termCounts(calls);
+		for(size_t i=0; i!=calls; ++i)
+		{
+			randomSpectrum(rng, 8 + rng() % 25, frequencies, fluxes);
+			fitters[i].reset(new NonLinearPowerLawFitter());
+			stableFitters[i].reset(new NonLinearPowerLawFitter());
+			for(size_t p=0; p!=frequencies.size(); ++p)
+			{
+				fitters[i]->AddDataPoint(frequencies[p] / 150e6, fluxes[p]);
+				stableFitters[i]->AddDataPoint(frequencies[p] / 150e6, fluxes[p]);
+			}
+			termCounts[i] = 2 + rng() % 3;
+		}
+		for(PolynomialFitter& fitter : polynomialFitters)
+		{
+			randomSpectrum(rng, 8 + rng() % 25, frequencies, fluxes);
+			for(size_t p=0; p!=frequencies.size(); ++p)
+				fitter.AddDataPoint(std::log10(frequencies[p] / 150e6), std::log10(std::fabs(fluxes[p])), 1.0);
+		}
+		aocommon::UVector<double> terms;
+		results.push_back(measure("NonLinearPowerLawFitter::Fit", calls, [&](size_t i)
+		{
+			fitters[i]->Fit(terms, termCounts[i]);
+			sink = terms[0];
+		}, 0));
+		results.push_back(measure("NonLinearPowerLawFitter::FitStable", calls, [&](size_t i)
+		{
+			stableFitters[i]->FitStable(terms, termCounts[i]);
+			sink = terms[0];
+		}, 0));
+		results.push_back(measure("PolynomialFitter::Fit", callCount(100000), [&](size_t i)
+		{
+			polynomialFitters[i % 16].Fit(terms, 3);
+			sink = terms[0];
+		}));
+	}
+
+	// A model of 1000 single-component sources, parsed from a file
+	{
+		const std::string modelFilename = "sourceresponse-microbenchmark-model.txt";
+		SyntheticModelOptions modelOptions;
+		modelOptions.sourceCount = 1000;
+		CreateSyntheticModel(modelFilename, modelOptions);
+		results.push_back(measure("ModelParser::Parse", callCount(20), [&](size_t)
+		{
+			Model model;
+			ModelParser parser;
+			parser.Parse(model, modelFilename);
+			sink = model.SourceCount();
+		}));
+		std::remove(modelFilename.c_str());
+	}
+
+	// Coordinates in both of the supported notations
+	{
+		std::vector<std::string> ras(1000), decs(1000);
+		for(size_t i=0; i!=ras.size(); ++i)
+		{
+			const double hours = 24.0 * uniform(rng), degrees = 180.0 * uniform(rng) - 90.0;
+			ras[i] = i%2 == 0 ? formatSexagesimal(hours, 'h', 'm', 's', false) : formatSexagesimal(hours, ':', ':', 0, false);
+			decs[i] = i%2 == 0 ? formatSexagesimal(degrees, 'd', 'm', 's', true) : formatSexagesimal(degrees, '.', '.', 0, true);
+		}
+		results.push_back(measure("RaDecCoord::ParseRA", callCount(1000000), [&](size_t i)
+		{
+			sink = RaDecCoord::ParseRA(ras[i % ras.size()]);
+		}));
+		results.push_back(measure("RaDecCoord::ParseDec", callCount(1000000), [&](size_t i)
+		{
+			sink = RaDecCoord::ParseDec(decs[i % decs.size()]);
+		}));
+	}
+
+	std::ostringstream json;
+	json.precision(6);
+	json << "{\n"
+		"  \"benchmark\": \"micro\",\n"
+		"  \"label\": \"";
+	for(char c : label)
+		json << (c == '"' || c == '\\' ? "\\" : "") << c;
+	json << "\",\n"
+		"  \"results\": [\n";
+	for(size_t i=0; i!=results.size(); ++i)
+	{
+		json << "    { \"name\": \"" << results[i].name << "\", \"calls\": " << results[i].calls
+			<< ", \"ns_per_call\": " << results[i].nsPerCall
+			<< ", \"allocations_per_call\": " << results[i].allocationsPerCall << " }"
+			<< (i+1 == results.size() ? "\n" : ",\n");
+	}
+	json << "  ]\n}\n";
+	if(outputFilename.empty())
+		std::cout << json.str();
+	else {
+		std::ofstream file(outputFilename);
+		file << json.str();
+	}
+}
@@ -0,0 +1,263 @@
+#include "syntheticdata.h"
+
+#include "../model/model.h"
+#include "../model/powerlawsed.h"
+
+#include <casacore/casa/Arrays/Cube.h>
+#include <casacore/casa/Arrays/Matrix.h>
+#include <casacore/casa/Arrays/Vector.h>
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+#include <casacore/ms/MeasurementSets/MSAntennaColumns.h>
+#include <casacore/ms/MeasurementSets/MSDataDescColumns.h>
+#include <casacore/ms/MeasurementSets/MSFieldColumns.h>
+#include <casacore/ms/MeasurementSets/MSMainColumns.h>
+#include <casacore/ms/MeasurementSets/MSSpWindowColumns.h>
+#include <casacore/tables/Tables/ArrColDesc.h>
+#include <casacore/tables/Tables/ArrayColumn.h>
+#include <casacore/tables/Tables/ScaColDesc.h>
+#include <casacore/tables/Tables/ScalarColumn.h>
+#include <casacore/tables/Tables/SetupNewTab.h>
+#include <casacore/tables/Tables/TableDesc.h>
+
+#include <cmath>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+	/** ITRF position of the centre of the LOFAR core. */
+	const double corePosition[3] = { 3826577.022720000, 461022.995082000, 5064892.814 };
+
+	struct LocalFrame
+	{
+		double east[3], north[3], up[3];
+	};
+
+	LocalFrame localFrame(const double* position)
+	{
+		LocalFrame frame;
+		const double norm = std::sqrt(position[0]*position[0] + position[1]*position[1] + position[2]*position[2]);
+		for(size_t i=0; i!=3; ++i)
+			frame.up[i] = position[i] / norm;
+		const double horizontal = std::sqrt(frame.up[0]*frame.up[0] + frame.up[1]*frame.up[1]);
+		frame.east[0] = -frame.up[1] / horizontal;
+		frame.east[1] = frame.up[0] / horizontal;
+		frame.east[2] = 0.0;
+		frame.north[0] = frame.up[1]*frame.east[2] - frame.up[2]*frame.east[1];
+		frame.north[1] = frame.up[2]*frame.east[0] - frame.up[0]*frame.east[2];
+		frame.north[2] = frame.up[0]*frame.east[1] - frame.up[1]*frame.east[0];
+		return frame;
+	}
+
+	/** Uniformly distributed position on a disc, as east and north offsets. */
+	void randomOnDisc(std::mt19937& rng, double radius, double& east, double& north)
+	{
+		std::uniform_real_distribution<double> uniform(0.0, 1.0);
+		const double r = radius * std::sqrt(uniform(rng));
+		const double angle = 2.0 * M_PI * uniform(rng);
+		east = r * std::cos(angle);
+		north = r * std::sin(angle);
+	}
+
+	void addAntennaFieldTable(casacore::MeasurementSet& ms, const std::vector<std::vector<double>>& stationPositions, size_t elementsPerStation, bool hba, std::mt19937& rng)
+	{
+		casacore::TableDesc description("LOFAR_ANTENNA_FIELD", casacore::TableDesc::Scratch);
+		description.addColumn(casacore::ScalarColumnDesc<int>("ANTENNA_ID"));
+		description.addColumn(casacore::ScalarColumnDesc<casacore::String>("NAME"));
+		description.addColumn(casacore::ArrayColumnDesc<double>("POSITION", casacore::IPosition(1, 3), casacore::ColumnDesc::Direct));
+		description.addColumn(casacore::ArrayColumnDesc<double>("COORDINATE_AXES", casacore::IPosition(2, 3, 3), casacore::ColumnDesc::Direct));
+		description.addColumn(casacore::ArrayColumnDesc<double>("TILE_ELEMENT_OFFSET", 2));
+		description.addColumn(casacore::ArrayColumnDesc<double>("ELEMENT_OFFSET", 2));
+		description.addColumn(casacore::ArrayColumnDesc<bool>("ELEMENT_FLAG", 2));
+		casacore::SetupNewTable setup(ms.tableName() + "/LOFAR_ANTENNA_FIELD", description, casacore::Table::New);
+		casacore::Table table(setup, stationPositions.size());
+
+		casacore::ScalarColumn<int> antennaIdColumn(table, "ANTENNA_ID");
+		casacore::ScalarColumn<casacore::String> nameColumn(table, "NAME");
+		casacore::ArrayColumn<double>
+			positionColumn(table, "POSITION"),
+			axesColumn(table, "COORDINATE_AXES"),
+			tileOffsetColumn(table, "TILE_ELEMENT_OFFSET"),
+			offsetColumn(table, "ELEMENT_OFFSET");
+		casacore::ArrayColumn<bool> flagColumn(table, "ELEMENT_FLAG");
+		for(size_t station=0; station!=stationPositions.size(); ++station)
+		{
+			const double* position = stationPositions[station].data();
+			const LocalFrame frame = localFrame(position);
+			antennaIdColumn.put(station, int(station));
+			nameColumn.put(station, hba ? "HBA" : "LBA");
+			positionColumn.put(station, casacore::Vector<double>(stationPositions[station]));
+			casacore::Matrix<double> axes(3, 3);
+			for(size_t i=0; i!=3; ++i)
+			{
+				axes(i, 0) = frame.east[i];
+				axes(i, 1) = frame.north[i];
+				axes(i, 2) = frame.up[i];
+			}
+			axesColumn.put(station, axes);
+			// A tile of 4x4 elements that are 1.25 m apart, in ITRF offsets
+			casacore::Matrix<double> tileOffsets(3, 16, 0.0);
+			if(hba)
+			{
+				for(size_t element=0; element!=16; ++element)
+				{
+					const double east = (element%4 - 1.5) * 1.25, north = (element/4 - 1.5) * 1.25;
+					for(size_t i=0; i!=3; ++i)
+						tileOffsets(i, element) = east * frame.east[i] + north * frame.north[i];
+				}
+			}
+			tileOffsetColumn.put(station, tileOffsets);
+			casacore::Matrix<double> offsets(3, elementsPerStation);
+			casacore::Matrix<bool> flags(2, elementsPerStation, false);
+			for(size_t element=0; element!=elementsPerStation; ++element)
+			{
+				double east, north;
+				randomOnDisc(rng, 40.0, east, north);
+				for(size_t i=0; i!=3; ++i)
+					offsets(i, element) = east * frame.east[i] + north * frame.north[i];
+			}
+			offsetColumn.put(station, offsets);
+			flagColumn.put(station, flags);
+		}
+		ms.rwKeywordSet().defineTable("LOFAR_ANTENNA_FIELD", table);
+	}
+}
+
+void CreateSyntheticMS(const std::string& filename, const SyntheticMSOptions& options)
+{
+	std::mt19937 rng(options.seed);
+	const size_t stationCount = options.stationCount;
+	const size_t baselineCount = stationCount * (stationCount + 1) / 2;
+	const size_t rowsPerTimestep = options.rowsPerTimestep == 0 ? baselineCount : options.rowsPerTimestep;
+	const size_t rowCount = rowsPerTimestep * options.timestepCount;
+
+	casacore::SetupNewTable setup(filename, casacore::MeasurementSet::requiredTableDesc(), casacore::Table::New);
+	casacore::MeasurementSet ms(setup, rowCount);
+	ms.createDefaultSubtables(casacore::Table::New);
+
+	std::vector<std::vector<double>> stationPositions(stationCount, std::vector<double>(3));
+	const LocalFrame coreFrame = localFrame(corePosition);
+	ms.antenna().addRow(stationCount);
+	casacore::MSAntennaColumns antennaColumns(ms.antenna());
+	for(size_t station=0; station!=stationCount; ++station)
+	{
+		double east, north;
+		randomOnDisc(rng, options.stationRadius, east, north);
+		for(size_t i=0; i!=3; ++i)
+			stationPositions[station][i] = corePosition[i] + east * coreFrame.east[i] + north * coreFrame.north[i];
+		std::ostringstream name;
+		name << "ST" << station << "LBA";
+		antennaColumns.name().put(station, name.str());
+		antennaColumns.station().put(station, "LOFAR");
+		antennaColumns.type().put(station, "GROUND-BASED");
+		antennaColumns.mount().put(station, "X-Y");
+		antennaColumns.dishDiameter().put(station, 87.0);
+		antennaColumns.position().put(station, casacore::Vector<double>(stationPositions[station]));
+		antennaColumns.offset().put(station, casacore::Vector<double>(3, 0.0));
+	}
+	addAntennaFieldTable(ms, stationPositions, options.elementsPerStation, options.hba, rng);
+
+	ms.field().addRow();
+	casacore::MSFieldColumns fieldColumns(ms.field());
+	casacore::Matrix<double> direction(2, 1);
+	direction(0, 0) = options.ra;
+	direction(1, 0) = options.dec;
+	fieldColumns.name().put(0, "synthetic");
+	fieldColumns.numPoly().put(0, 0);
+	fieldColumns.time().put(0, options.startTime);
+	fieldColumns.delayDir().put(0, direction);
+	fieldColumns.phaseDir().put(0, direction);
+	fieldColumns.referenceDir().put(0, direction);
+
+	ms.spectralWindow().addRow();
+	casacore::MSSpWindowColumns spectralWindowColumns(ms.spectralWindow());
+	const double channelWidth = options.bandwidth / options.channelCount;
+	casacore::Vector<double> frequencies(options.channelCount), widths(options.channelCount, channelWidth);
+	for(size_t channel=0; channel!=options.channelCount; ++channel)
+		frequencies[channel] = options.centreFrequency + (channel + 0.5 - 0.5 * options.channelCount) * channelWidth;
+	spectralWindowColumns.name().put(0, "synthetic");
+	spectralWindowColumns.numChan().put(0, int(options.channelCount));
+	spectralWindowColumns.refFrequency().put(0, options.centreFrequency);
+	spectralWindowColumns.chanFreq().put(0, frequencies);
+	spectralWindowColumns.chanWidth().put(0, widths);
+	spectralWindowColumns.effectiveBW().put(0, widths);
+	spectralWindowColumns.resolution().put(0, widths);
+	spectralWindowColumns.totalBandwidth().put(0, options.bandwidth);
+
+	ms.dataDescription().addRow();
+	casacore::MSDataDescColumns dataDescColumns(ms.dataDescription());
+	dataDescColumns.spectralWindowId().put(0, 0);
+	dataDescColumns.polarizationId().put(0, 0);
+
+	casacore::Vector<double> times(rowCount);
+	casacore::Vector<int> antenna1(rowCount), antenna2(rowCount), zeros(rowCount, 0);
+	size_t row = 0;
+	for(size_t timestep=0; timestep!=options.timestepCount; ++timestep)
+	{
+		size_t a1 = 0, a2 = 0;
+		for(size_t i=0; i!=rowsPerTimestep; ++i)
+		{
+			times[row] = options.startTime + (timestep + 0.5) * options.interval;
+			antenna1[row] = a1;
+			antenna2[row] = a2;
+			++row;
+			// Cycle through the baselines
+			++a2;
+			if(a2 == stationCount)
+			{
+				++a1;
+				if(a1 == stationCount)
+					a1 = 0;
+				a2 = a1;
+			}
+		}
+	}
+	casacore::MSMainColumns mainColumns(ms);
+	mainColumns.time().putColumn(times);
+	mainColumns.timeCentroid().putColumn(times);
+	mainColumns.antenna1().putColumn(antenna1);
+	mainColumns.antenna2().putColumn(antenna2);
+	mainColumns.fieldId().putColumn(zeros);
+	mainColumns.dataDescId().putColumn(zeros);
+	mainColumns.interval().putColumn(casacore::Vector<double>(rowCount, options.interval));
+	mainColumns.exposure().putColumn(casacore::Vector<double>(rowCount, options.interval));
+}
+
+void CreateSyntheticModel(const std::string& filename, const SyntheticModelOptions& options)
+{
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	std::normal_distribution<double> spectralIndex(-0.7, 0.2), componentOffset(0.0, 1e-4);
+	Model model;
+	for(size_t s=0; s!=options.sourceCount; ++s)
+	{
+		ModelSource source;
+		std::ostringstream name;
+		name << "src" << s;
+		source.SetName(name.str());
+		source.SetClusterName(name.str());
+		// Small-angle placement on a disc around the centre
+		double dx, dy;
+		randomOnDisc(rng, options.radius, dx, dy);
+		const double dec = options.dec + dy;
+		const double ra = options.ra + dx / std::cos(dec);
+		// Between 0.1 and 100 Jy, with the number of sources brighter than S
+		// proportional to S^-1.5
+		const double flux = 0.1 * std::pow(1.0 - uniform(rng) * (1.0 - std::pow(1000.0, -1.5)), -1.0/1.5);
+		for(size_t c=0; c!=options.componentsPerSource; ++c)
+		{
+			ModelComponent component;
+			component.SetPosRA(c == 0 ? ra : ra + componentOffset(rng));
+			component.SetPosDec(c == 0 ? dec : dec + componentOffset(rng));
+			const double brightness[4] = { flux / options.componentsPerSource, 0.0, 0.0, 0.0 };
+			const std::vector<double> terms(1, spectralIndex(rng));
+			PowerLawSED sed;
+			sed.SetData(150e6, brightness, terms);
+			component.SetSED(sed);
+			source.AddComponent(component);
+		}
+		model.AddSource(source);
+		model.FindOrAddCluster(source.ClusterName());
+	}
+	model.Save(filename);
+}
@@ -0,0 +1,90 @@
+#ifndef SYNTHETIC_DATA_H
+#define SYNTHETIC_DATA_H
+
+#include <cstdint>
+#include <string>
+
+/**
+ * Parameters of a synthetic LOFAR-like measurement set. The stations are
+ * randomly placed around the LOFAR core and have a single LBA field with
+ * randomly placed elements, so that the set can be used with all beam
+ * backends. With hba set, the field is an HBA field instead, with randomly
+ * placed tiles of 4x4 elements. Only the columns that sourceresponse reads are filled; the
+ * set has no visibilities.
+ */
+struct SyntheticMSOptions
+{
+	SyntheticMSOptions() :
+		stationCount(24),
+		elementsPerStation(48),
+		timestepCount(100),
+		interval(10.0),
+		startTime(58849.0 * 86400.0),
+		rowsPerTimestep(0),
+		channelCount(64),
+		centreFrequency(60e6),
+		bandwidth(195312.5 * 64.0),
+		ra(2.1537),
+		dec(0.8413),
+		stationRadius(2000.0),
+		hba(false),
+		seed(1)
+	{ }
+
+	size_t stationCount;
+	size_t elementsPerStation;
+	size_t timestepCount;
+	/** Time between timesteps, in seconds. */
+	double interval;
+	/** Time of the first timestep, in MJD seconds. */
+	double startTime;
+	/** Rows in the main table per timestep; zero for all baselines, including autocorrelations. */
+	size_t rowsPerTimestep;
+	size_t channelCount;
+	/** Frequencies in Hz. */
+	double centreFrequency, bandwidth;
+	/** Phase centre (J2000, radians). */
+	double ra, dec;
+	/** Maximum distance of the stations to the core, in meters. */
+	double stationRadius;
+	bool hba;
+	uint32_t seed;
+};
+
+/**
+ * Creates a measurement set with the given layout. An existing set with the
+ * same name is overwritten.
+ */
+void CreateSyntheticMS(const std::string& filename, const SyntheticMSOptions& options);
+
+/**
+ * Parameters of a synthetic sky model. The sources are uniformly
+ * distributed over a disc, with a flux density distribution that
+ * approximates the source counts at low frequencies and power-law spectra.
+ */
+struct SyntheticModelOptions
+{
+	SyntheticModelOptions() :
+		sourceCount(1000),
+		componentsPerSource(1),
+		ra(2.1537),
+		dec(0.8413),
+		radius(0.1),
+		seed(1)
+	{ }
+
+	size_t sourceCount;
+	size_t componentsPerSource;
+	/** Centre of the disc (J2000, radians). */
+	double ra, dec;
+	/** Radius of the disc, in radians. */
+	double radius;
+	uint32_t seed;
+};
+
+/**
+ * Writes a model in the skymodel 1.1 format.
+ */
+void CreateSyntheticModel(const std::string& filename, const SyntheticModelOptions& options);
+
+#endif
@@ -0,0 +1,142 @@
+#include "checkpoint.h"
+
+#include "hasher.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include <unistd.h>
+
+namespace {
+	const std::string manifestHeader = "sourceresponse-manifest 1";
+
+	std::vector<std::string> split(const std::string& str, char separator)
+	{
+		std::vector<std::string> parts;
+		size_t start = 0, pos;
+		while((pos = str.find(separator, start)) != std::string::npos)
+		{
+			parts.push_back(str.substr(start, pos-start));
+			start = pos + 1;
+		}
+		parts.push_back(str.substr(start));
+		return parts;
+	}
+
+	std::string toHex(uint64_t value)
+	{
+		char str[17];
+		snprintf(str, sizeof str, "%016llx", static_cast<unsigned long long>(value));
+		return str;
+	}
+
+	bool fromHex(const std::string& str, uint64_t& value)
+	{
+		if(str.size() != 16)
+			return false;
+		char* end;
+		value = strtoull(str.c_str(), &end, 16);
+		return *end == 0;
+	}
+}
+
+Checkpoint::Checkpoint(const std::string& filename, uint64_t observationKey) :
+	_filename(filename)
+{
+	if(readManifest(observationKey))
+	{
+		_file.open(_filename, std::ios::app);
+	}
+	else {
+		_progress.clear();
+		_file.open(_filename, std::ios::trunc);
+		writeLine(manifestHeader + '\t' + toHex(observationKey));
+	}
+	if(!_file.good())
+		throw std::runtime_error("Could not write manifest " + _filename);
+}
+
+uint64_t Checkpoint::checksum(const std::string& content)
+{
+	Hasher hasher;
+	hasher.Add(content);
+	return hasher.Value();
+}
+
+bool Checkpoint::readManifest(uint64_t observationKey)
+{
+	std::ifstream file(_filename);
+	if(!file.good())
+		return false;
+	std::string line;
+	// Byte position up to which the manifest is valid
+	uint64_t validSize = 0;
+	bool hasHeader = false;
+	while(std::getline(file, line) && !file.eof())
+	{
+		size_t tab = line.rfind('\t');
+		uint64_t lineChecksum;
+		if(tab == std::string::npos || !fromHex(line.substr(tab+1), lineChecksum))
+			break;
+		std::string content = line.substr(0, tab);
+		if(checksum(content) != lineChecksum)
+			break;
+		std::vector<std::string> fields = split(content, '\t');
+		if(!hasHeader)
+		{
+			uint64_t key;
+			if(fields.size() != 2 || fields[0] != manifestHeader ||
+				!fromHex(fields[1], key) || key != observationKey)
+				return false;
+			hasHeader = true;
+		}
+		else {
+			Progress progress;
+			if(fields.size() != 6 || fields[0] != "C" || !fromHex(fields[2], progress.componentKey))
+				break;
+			progress.timesteps = std::strtoull(fields[3].c_str(), nullptr, 10);
+			progress.outputSize = std::strtoull(fields[4].c_str(), nullptr, 10);
+			progress.finished = fields[5] == "1";
+			_progress[fields[1]] = progress;
+		}
+		validSize += line.size() + 1;
+	}
+	if(!hasHeader)
+		return false;
+	file.close();
+	// Remove a partially written record, so that new records are appended
+	// after the last valid one.
+	if(truncate(_filename.c_str(), validSize) != 0)
+		throw std::runtime_error("Could not truncate manifest " + _filename);
+	return true;
+}
+
+Checkpoint::Progress Checkpoint::Find(const std::string& componentName, uint64_t componentKey) const
+{
+	std::map<std::string, Progress>::const_iterator iter = _progress.find(componentName);
+	if(iter == _progress.end() || iter->second.componentKey != componentKey)
+		return Progress();
+	else {
+		return iter->second;
+	}
+}
+
+void Checkpoint::Record(const std::string& componentName, const Progress& progress)
+{
+	_progress[componentName] = progress;
+	std::ostringstream content;
+	content << "C\t" << componentName << '\t' << toHex(progress.componentKey) << '\t'
+		<< progress.timesteps << '\t' << progress.outputSize << '\t' << (progress.finished ? '1' : '0');
+	writeLine(content.str());
+}
+
+void Checkpoint::writeLine(const std::string& content)
+{
+	_file << content << '\t' << toHex(checksum(content)) << '\n';
+	_file.flush();
+	if(!_file.good())
+		throw std::runtime_error("Could not write manifest " + _filename);
+}
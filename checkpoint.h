@@ -0,0 +1,60 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+
+/**
+ * Keeps track of the progress of a run in a manifest file, so that an
+ * interrupted run can be resumed. The manifest is an append-only journal:
+ * every time a block of timesteps of a component has been written to its
+ * output file, a record is appended with the number of finished timesteps
+ * and the size of the output file at that point. Every record and the
+ * header carry a checksum, so that a partially written record (e.g. because
+ * the process was killed) is detected and ignored.
+ *
+ * The manifest header holds a key of the observation. A manifest that was
+ * written for a different observation is discarded.
+ */
+class Checkpoint
+{
+public:
+	struct Progress
+	{
+		Progress() : componentKey(0), timesteps(0), outputSize(0), finished(false) { }
+		/** Identifies direction and flux of the component. */
+		uint64_t componentKey;
+		size_t timesteps;
+		uint64_t outputSize;
+		bool finished;
+	};
+
+	/**
+	 * Open the manifest and read the progress that was recorded in it. When
+	 * the manifest does not exist, was written for another observation or
+	 * has a corrupt header, a new manifest is started.
+	 */
+	Checkpoint(const std::string& filename, uint64_t observationKey);
+
+	/**
+	 * Returns the recorded progress of the component, or the progress of an
+	 * unstarted component when nothing was recorded or when the recorded
+	 * component key differs.
+	 */
+	Progress Find(const std::string& componentName, uint64_t componentKey) const;
+
+	void Record(const std::string& componentName, const Progress& progress);
+
+private:
+	bool readManifest(uint64_t observationKey);
+	void writeLine(const std::string& content);
+	static uint64_t checksum(const std::string& content);
+
+	std::string _filename;
+	std::map<std::string, Progress> _progress;
+	std::ofstream _file;
+};
+
+#endif
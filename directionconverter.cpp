@@ -0,0 +1,37 @@
+#include "directionconverter.h"
+
+#include "profiler.h"
+
+#include <casacore/measures/Measures/MEpoch.h>
+#include <casacore/measures/Measures/MPosition.h>
+
+namespace {
+	BeamBackend::Vector3 toVector(const casacore::MDirection& itrfDirection)
+	{
+		const casacore::Vector<double> value = itrfDirection.getValue().getValue();
+		const BeamBackend::Vector3 result = {{ value[0], value[1], value[2] }};
+		return result;
+	}
+}
+
+DirectionConverter::DirectionConverter(double time) :
+	_frame(
+		casacore::MEpoch(casacore::Quantity(time, "s"), casacore::MEpoch::UTC),
+		casacore::MPosition(casacore::MVPosition(3826577.022720000, 461022.995082000, 5064892.814), casacore::MPosition::ITRF)),
+	_j2000Converter(casacore::MDirection::J2000, casacore::MDirection::Ref(casacore::MDirection::ITRF, _frame))
+{ }
+
+BeamBackend::Vector3 DirectionConverter::ToITRF(const casacore::MDirection& direction)
+{
+	Profiler::Count(Profiler::DirectionConversions);
+	if(direction.getRef().getType() == casacore::MDirection::J2000)
+		return toVector(_j2000Converter(direction));
+	else
+		return toVector(casacore::MDirection::Convert(direction, casacore::MDirection::Ref(casacore::MDirection::ITRF, _frame))());
+}
+
+BeamBackend::Vector3 DirectionConverter::J2000ToITRF(double ra, double dec)
+{
+	Profiler::Count(Profiler::DirectionConversions);
+	return toVector(_j2000Converter(casacore::MVDirection(ra, dec)));
+}
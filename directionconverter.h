@@ -0,0 +1,37 @@
+#ifndef DIRECTION_CONVERTER_H
+#define DIRECTION_CONVERTER_H
+
+#include "beambackend.h"
+
+#include <casacore/measures/Measures/MCDirection.h>
+#include <casacore/measures/Measures/MDirection.h>
+#include <casacore/measures/Measures/MeasConvert.h>
+#include <casacore/measures/Measures/MeasFrame.h>
+
+/**
+ * Converts directions to ITRF unit vectors at a given time, as required by
+ * the beam backends. The conversion uses a frame at the position of the
+ * LOFAR core, like the StationResponse library does. The conversion
+ * functions are not thread-safe: every thread needs its own converter.
+ */
+class DirectionConverter
+{
+public:
+	/**
+	 * @param time Time in MJD seconds (UTC).
+	 */
+	explicit DirectionConverter(double time);
+
+	BeamBackend::Vector3 ToITRF(const casacore::MDirection& direction);
+
+	/**
+	 * Converts a J2000 direction, given in radians.
+	 */
+	BeamBackend::Vector3 J2000ToITRF(double ra, double dec);
+
+private:
+	casacore::MeasFrame _frame;
+	casacore::MDirection::Convert _j2000Converter;
+};
+
+#endif
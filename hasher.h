@@ -0,0 +1,52 @@
+#ifndef HASHER_H
+#define HASHER_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+/**
+ * Incremental 64-bit FNV-1a hash. This is not a cryptographic hash; it is
+ * used to derive stable keys from observation meta data and source
+ * directions, such that the same input produces the same key across runs.
+ */
+class Hasher
+{
+public:
+	Hasher() : _value(14695981039346656037ULL)
+	{ }
+
+	void Add(const void* data, size_t size)
+	{
+		const unsigned char* bytes = static_cast<const unsigned char*>(data);
+		for(size_t i=0; i!=size; ++i)
+		{
+			_value ^= bytes[i];
+			_value *= 1099511628211ULL;
+		}
+	}
+
+	void Add(double value)
+	{
+		// Make sure that 0.0 and -0.0 hash to the same value
+		if(value == 0.0)
+			value = 0.0;
+		Add(&value, sizeof(value));
+	}
+
+	void Add(uint64_t value) { Add(&value, sizeof(value)); }
+
+	void Add(const std::string& str)
+	{
+		uint64_t size = str.size();
+		Add(&size, sizeof(size));
+		Add(str.data(), str.size());
+	}
+
+	uint64_t Value() const { return _value; }
+
+private:
+	uint64_t _value;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "lofarbeambackend.h"
+
+#include <StationResponse/AntennaFieldHBA.h>
+#include <StationResponse/AntennaFieldLBA.h>
+#include <StationResponse/TileAntenna.h>
+
+#include <stdexcept>
+
+namespace {
+	LOFAR::StationResponse::vector3r_t toLofar(const BeamBackend::Vector3& vector)
+	{
+		const LOFAR::StationResponse::vector3r_t result = {{ vector[0], vector[1], vector[2] }};
+		return result;
+	}
+}
+
+LofarBeamBackend::LofarBeamBackend(const std::vector<StationLayout>& stations)
+{
+	using namespace LOFAR::StationResponse;
+	_stations.reserve(stations.size());
+	for(const StationLayout& layout : stations)
+	{
+		if(layout.fields.empty())
+			throw std::runtime_error("Station " + layout.name + " has no antenna fields: only LOFAR stations are supported by the lofar beam");
+		const vector3r_t position = {{ layout.position[0], layout.position[1], layout.position[2] }};
+		Station::Ptr station(new Station(layout.name, position));
+		const vector3r_t phaseReference = {{ layout.phaseReference[0], layout.phaseReference[1], layout.phaseReference[2] }};
+		station->setPhaseReference(phaseReference);
+		for(const AntennaFieldLayout& fieldLayout : layout.fields)
+		{
+			AntennaField::CoordinateSystem system;
+			for(size_t i=0; i!=3; ++i)
+			{
+				system.origin[i] = fieldLayout.origin[i];
+				system.axes.p[i] = fieldLayout.axes[0][i];
+				system.axes.q[i] = fieldLayout.axes[1][i];
+				system.axes.r[i] = fieldLayout.axes[2][i];
+			}
+			AntennaField::Ptr field;
+			if(fieldLayout.hasTileConfig)
+			{
+				// The layout holds ITRF offsets, but the tile antenna expects them in
+				// the P, Q, R coordinates of the field, as readAntennaField() of the
+				// library converts them
+				TileAntenna::TileConfig config;
+				for(size_t element=0; element!=config.size(); ++element)
+				{
+					for(size_t axis=0; axis!=3; ++axis)
+					{
+						const double* offset = fieldLayout.tileConfig[element];
+						const double* direction = fieldLayout.axes[axis];
+						config[element][axis] = offset[0]*direction[0] + offset[1]*direction[1] + offset[2]*direction[2];
+					}
+				}
+				field = AntennaField::Ptr(new AntennaFieldHBA(fieldLayout.name, system,
+					AntennaModelHBA::ConstPtr(new TileAntenna(config))));
+			}
+			else {
+				field = AntennaField::Ptr(new AntennaFieldLBA(fieldLayout.name, system));
+			}
+			for(const ElementLayout& element : fieldLayout.elements)
+			{
+				AntennaField::Antenna antenna;
+				for(size_t i=0; i!=3; ++i)
+					antenna.position[i] = element.offset[i];
+				antenna.enabled[0] = element.enabled[0];
+				antenna.enabled[1] = element.enabled[1];
+				field->addAntenna(antenna);
+			}
+			station->addField(field);
+		}
+		_stations.push_back(station);
+		_names.push_back(layout.name);
+	}
+}
+
+void LofarBeamBackend::Response(size_t station, double time, double frequency, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const
+{
+	const LOFAR::StationResponse::matrix22c_t gainMatrix = _stations[station]->response(time, frequency,
+		toLofar(direction), frequency, toLofar(delayDirection), toLofar(tileBeamDirection));
+	jones[0] = gainMatrix[0][0];
+	jones[1] = gainMatrix[0][1];
+	jones[2] = gainMatrix[1][0];
+	jones[3] = gainMatrix[1][1];
+}
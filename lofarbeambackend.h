@@ -0,0 +1,34 @@
+#ifndef LOFAR_BEAM_BACKEND_H
+#define LOFAR_BEAM_BACKEND_H
+
+#include "beambackend.h"
+
+#include <StationResponse/Station.h>
+
+/**
+ * Beam backend that uses the LOFAR station response library. Only
+ * available when sourceresponse is built with that library.
+ */
+class LofarBeamBackend : public BeamBackend
+{
+public:
+	/**
+	 * Constructs the station objects from the layouts, in the same way as
+	 * the StationResponse library does this when reading a measurement set.
+	 */
+	explicit LofarBeamBackend(const std::vector<StationLayout>& stations);
+
+	const char* Name() const override { return "lofar"; }
+
+	size_t StationCount() const override { return _stations.size(); }
+
+	const std::string& StationName(size_t station) const override { return _names[station]; }
+
+	void Response(size_t station, double time, double frequency, const Vector3& direction, const Vector3& delayDirection, const Vector3& tileBeamDirection, std::complex<double>* jones) const override;
+
+private:
+	std::vector<LOFAR::StationResponse::Station::Ptr> _stations;
+	std::vector<std::string> _names;
+};
+
+#endif
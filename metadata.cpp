@@ -0,0 +1,540 @@
+#include "metadata.h"
+
+#include "hasher.h"
+
+#include <casacore/measures/TableMeasures/ArrayMeasColumn.h>
+#include <casacore/measures/TableMeasures/ScalarMeasColumn.h>
+#include <casacore/tables/Tables/ArrayColumn.h>
+#include <casacore/tables/Tables/ScalarColumn.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	/*
+	 * Layout of a sidecar file: a header, followed by the station, antenna
+	 * field, element, field, spectral window and channel records and finally
+	 * the names of the stations, antenna fields and fields. All records have a
+	 * size that is a multiple of 8 bytes, so that they are aligned when the
+	 * file is mapped. The last two characters of the magic are the version.
+	 */
+	const char sidecarMagic[8] = { 'S', 'R', 'M', 'E', 'T', 'A', '0', '2' };
+
+	struct DirectionRecord
+	{
+		double longitude, latitude;
+		uint32_t reference, padding;
+	};
+
+	struct SidecarHeader
+	{
+		char magic[8];
+		/** Size of the file after the magic, size and checksum fields. */
+		uint64_t payloadSize;
+		uint64_t checksum;
+		uint32_t stationCount, antennaFieldCount, elementCount, fieldCount;
+		uint32_t spectralWindowCount, channelCount, stringTableSize, padding;
+	};
+	const size_t checksumOffset = sizeof(SidecarHeader::magic) + sizeof(uint64_t)*2;
+
+	struct StationRecord
+	{
+		uint32_t nameOffset, nameLength, firstAntennaField, antennaFieldCount;
+		double position[3];
+		double phaseReference[3];
+	};
+
+	struct AntennaFieldRecord
+	{
+		uint32_t nameOffset, nameLength, firstElement, elementCount;
+		uint32_t hasTileConfig, padding;
+		double origin[3];
+		double axes[3][3];
+		double tileConfig[16][3];
+	};
+
+	struct ElementRecord
+	{
+		double offset[3];
+		uint8_t enabled[2];
+		uint8_t padding[6];
+	};
+
+	struct FieldRecord
+	{
+		uint32_t nameOffset, nameLength;
+		DirectionRecord delayDirection, tileBeamDirection;
+	};
+
+	struct SpectralWindowRecord
+	{
+		uint32_t firstChannel, channelCount;
+	};
+
+	struct ChannelRecord
+	{
+		double frequency, width;
+	};
+
+	void copyVector(const double* source, double* destination)
+	{
+		destination[0] = source[0];
+		destination[1] = source[1];
+		destination[2] = source[2];
+	}
+}
+
+MetaData::Direction::Direction(const casacore::MDirection& direction)
+{
+	casacore::Vector<double> angles = direction.getValue().get();
+	longitude = angles[0];
+	latitude = angles[1];
+	reference = direction.getRef().getType();
+}
+
+casacore::MDirection MetaData::Direction::ToMDirection() const
+{
+	return casacore::MDirection(casacore::MVDirection(longitude, latitude), casacore::MDirection::Types(reference));
+}
+
+MetaData MetaData::FromMS(casacore::MeasurementSet& ms)
+{
+	MetaData metaData;
+
+	casacore::MSField& fieldTable = ms.field();
+	casacore::ROScalarColumn<casacore::String> fieldNameColumn(fieldTable, casacore::MSField::columnName(casacore::MSFieldEnums::NAME));
+	casacore::ScalarMeasColumn<casacore::MDirection> delayDirColumn(fieldTable, casacore::MSField::columnName(casacore::MSFieldEnums::DELAY_DIR));
+	const bool hasTileBeamDir = fieldTable.tableDesc().isColumn("LOFAR_TILE_BEAM_DIR");
+	casacore::ROArrayMeasColumn<casacore::MDirection> tileBeamDirColumn;
+	if(hasTileBeamDir)
+		tileBeamDirColumn.attach(fieldTable, "LOFAR_TILE_BEAM_DIR");
+	metaData._fields.resize(fieldTable.nrow());
+	for(size_t i=0; i!=fieldTable.nrow(); ++i)
+	{
+		Field& field = metaData._fields[i];
+		field.name = fieldNameColumn(i);
+		field.delayDirection = Direction(delayDirColumn(i));
+		if(hasTileBeamDir)
+			field.tileBeamDirection = Direction(*(tileBeamDirColumn(i).data()));
+		else
+			field.tileBeamDirection = field.delayDirection;
+	}
+
+	casacore::MSSpectralWindow& spectralWindowTable = ms.spectralWindow();
+	metaData._spectralWindows.resize(spectralWindowTable.nrow());
+	for(size_t i=0; i!=spectralWindowTable.nrow(); ++i)
+	{
+		aocommon::BandData band(spectralWindowTable, i);
+		const double channelWidth = band.FrequencyStep();
+		for(const double channelFrequency : band)
+			metaData._spectralWindows[i].emplace_back(channelFrequency, channelWidth);
+	}
+
+	casacore::MSAntenna& antennaTable = ms.antenna();
+	casacore::ROScalarColumn<casacore::String> antennaNameColumn(antennaTable, casacore::MSAntenna::columnName(casacore::MSAntennaEnums::NAME));
+	casacore::ROArrayColumn<double> antennaPositionColumn(antennaTable, casacore::MSAntenna::columnName(casacore::MSAntennaEnums::POSITION));
+	const bool hasPhaseReference = antennaTable.tableDesc().isColumn("LOFAR_PHASE_REFERENCE");
+	casacore::ROArrayColumn<double> phaseReferenceColumn;
+	if(hasPhaseReference)
+		phaseReferenceColumn.attach(antennaTable, "LOFAR_PHASE_REFERENCE");
+	metaData._stations.resize(antennaTable.nrow());
+	for(size_t i=0; i!=antennaTable.nrow(); ++i)
+	{
+		StationLayout& station = metaData._stations[i];
+		station.name = antennaNameColumn(i);
+		casacore::Array<double> position = antennaPositionColumn(i);
+		copyVector(position.data(), station.position);
+		if(hasPhaseReference)
+		{
+			casacore::Array<double> phaseReference = phaseReferenceColumn(i);
+			copyVector(phaseReference.data(), station.phaseReference);
+		}
+		else {
+			copyVector(station.position, station.phaseReference);
+		}
+	}
+
+	if(ms.keywordSet().isDefined("LOFAR_ANTENNA_FIELD"))
+	{
+		casacore::Table antennaFieldTable(ms.keywordSet().asTable("LOFAR_ANTENNA_FIELD"));
+		casacore::ROScalarColumn<int> antennaIdColumn(antennaFieldTable, "ANTENNA_ID");
+		casacore::ROScalarColumn<casacore::String> nameColumn(antennaFieldTable, "NAME");
+		casacore::ROArrayColumn<double>
+			positionColumn(antennaFieldTable, "POSITION"),
+			axesColumn(antennaFieldTable, "COORDINATE_AXES"),
+			tileOffsetColumn(antennaFieldTable, "TILE_ELEMENT_OFFSET"),
+			offsetColumn(antennaFieldTable, "ELEMENT_OFFSET");
+		casacore::ROArrayColumn<bool> flagColumn(antennaFieldTable, "ELEMENT_FLAG");
+		for(size_t row=0; row!=antennaFieldTable.nrow(); ++row)
+		{
+			size_t antennaId = antennaIdColumn(row);
+			if(antennaId >= metaData._stations.size())
+				throw std::runtime_error("LOFAR_ANTENNA_FIELD table refers to a non-existing antenna");
+			metaData._stations[antennaId].fields.emplace_back();
+			AntennaFieldLayout& field = metaData._stations[antennaId].fields.back();
+			field.name = nameColumn(row);
+			casacore::Array<double> origin = positionColumn(row);
+			copyVector(origin.data(), field.origin);
+			// Arrays are stored column-major: the p, q and r axes are consecutive
+			casacore::Array<double> axes = axesColumn(row);
+			for(size_t axis=0; axis!=3; ++axis)
+				copyVector(axes.data() + axis*3, field.axes[axis]);
+			field.hasTileConfig = (field.name != "LBA");
+			if(field.hasTileConfig)
+			{
+				casacore::Array<double> tileOffsets = tileOffsetColumn(row);
+				if(tileOffsets.nelements() != 16*3)
+					throw std::runtime_error("HBA field with a tile that does not have 16 elements");
+				for(size_t element=0; element!=16; ++element)
+					copyVector(tileOffsets.data() + element*3, field.tileConfig[element]);
+			}
+			casacore::Array<double> offsets = offsetColumn(row);
+			casacore::Array<bool> flags = flagColumn(row);
+			const size_t elementCount = offsets.nelements() / 3;
+			if(flags.nelements() != elementCount*2)
+				throw std::runtime_error("ELEMENT_FLAG and ELEMENT_OFFSET columns have inconsistent shapes");
+			field.elements.resize(elementCount);
+			for(size_t element=0; element!=elementCount; ++element)
+			{
+				copyVector(offsets.data() + element*3, field.elements[element].offset);
+				field.elements[element].enabled[0] = !flags.data()[element*2];
+				field.elements[element].enabled[1] = !flags.data()[element*2 + 1];
+			}
+		}
+	}
+	return metaData;
+}
+
+uint64_t MetaData::Key() const
+{
+	Hasher hasher;
+	hasher.Add(LayoutKey());
+	for(const std::vector<aocommon::ChannelInfo>& channels : _spectralWindows)
+	{
+		hasher.Add(uint64_t(channels.size()));
+		for(const aocommon::ChannelInfo& channel : channels)
+		{
+			hasher.Add(channel.Frequency());
+			hasher.Add(channel.Width());
+		}
+	}
+	return hasher.Value();
+}
+
+uint64_t MetaData::LayoutKey() const
+{
+	Hasher hasher;
+	// Everything that the beam backends use, so that e.g. observations with
+	// different flagged elements do not share responses or stations
+	for(const StationLayout& station : _stations)
+	{
+		hasher.Add(station.name);
+		for(size_t i=0; i!=3; ++i)
+		{
+			hasher.Add(station.position[i]);
+			hasher.Add(station.phaseReference[i]);
+		}
+		hasher.Add(uint64_t(station.fields.size()));
+		for(const AntennaFieldLayout& field : station.fields)
+		{
+			hasher.Add(field.name);
+			for(size_t i=0; i!=3; ++i)
+			{
+				hasher.Add(field.origin[i]);
+				for(size_t axis=0; axis!=3; ++axis)
+					hasher.Add(field.axes[axis][i]);
+			}
+			hasher.Add(uint64_t(field.hasTileConfig));
+			if(field.hasTileConfig)
+			{
+				for(size_t element=0; element!=16; ++element)
+				{
+					for(size_t i=0; i!=3; ++i)
+						hasher.Add(field.tileConfig[element][i]);
+				}
+			}
+			hasher.Add(uint64_t(field.elements.size()));
+			for(const ElementLayout& element : field.elements)
+			{
+				for(size_t i=0; i!=3; ++i)
+					hasher.Add(element.offset[i]);
+				hasher.Add(uint64_t(element.enabled[0]) | (uint64_t(element.enabled[1]) << 1));
+			}
+		}
+	}
+	for(const Field& field : _fields)
+	{
+		const Direction* directions[2] = { &field.delayDirection, &field.tileBeamDirection };
+		for(const Direction* direction : directions)
+		{
+			hasher.Add(direction->longitude);
+			hasher.Add(direction->latitude);
+			hasher.Add(uint64_t(direction->reference));
+		}
+	}
+	return hasher.Value();
+}
+
+void MetaData::WriteSidecar(const std::string& filename) const
+{
+	std::vector<StationRecord> stationRecords;
+	std::vector<AntennaFieldRecord> antennaFieldRecords;
+	std::vector<ElementRecord> elementRecords;
+	std::vector<FieldRecord> fieldRecords;
+	std::vector<SpectralWindowRecord> spectralWindowRecords;
+	std::vector<ChannelRecord> channelRecords;
+	std::string strings;
+	for(const StationLayout& station : _stations)
+	{
+		StationRecord stationRecord = StationRecord();
+		stationRecord.nameOffset = strings.size();
+		stationRecord.nameLength = station.name.size();
+		strings += station.name;
+		stationRecord.firstAntennaField = antennaFieldRecords.size();
+		stationRecord.antennaFieldCount = station.fields.size();
+		copyVector(station.position, stationRecord.position);
+		copyVector(station.phaseReference, stationRecord.phaseReference);
+		stationRecords.push_back(stationRecord);
+		for(const AntennaFieldLayout& field : station.fields)
+		{
+			AntennaFieldRecord fieldRecord = AntennaFieldRecord();
+			fieldRecord.nameOffset = strings.size();
+			fieldRecord.nameLength = field.name.size();
+			strings += field.name;
+			fieldRecord.firstElement = elementRecords.size();
+			fieldRecord.elementCount = field.elements.size();
+			fieldRecord.hasTileConfig = field.hasTileConfig;
+			copyVector(field.origin, fieldRecord.origin);
+			for(size_t axis=0; axis!=3; ++axis)
+				copyVector(field.axes[axis], fieldRecord.axes[axis]);
+			if(field.hasTileConfig)
+			{
+				for(size_t element=0; element!=16; ++element)
+					copyVector(field.tileConfig[element], fieldRecord.tileConfig[element]);
+			}
+			antennaFieldRecords.push_back(fieldRecord);
+			for(const ElementLayout& element : field.elements)
+			{
+				ElementRecord elementRecord = ElementRecord();
+				copyVector(element.offset, elementRecord.offset);
+				elementRecord.enabled[0] = element.enabled[0];
+				elementRecord.enabled[1] = element.enabled[1];
+				elementRecords.push_back(elementRecord);
+			}
+		}
+	}
+	for(const Field& field : _fields)
+	{
+		FieldRecord fieldRecord = FieldRecord();
+		fieldRecord.nameOffset = strings.size();
+		fieldRecord.nameLength = field.name.size();
+		strings += field.name;
+		const Direction* directions[2] = { &field.delayDirection, &field.tileBeamDirection };
+		DirectionRecord* directionRecords[2] = { &fieldRecord.delayDirection, &fieldRecord.tileBeamDirection };
+		for(size_t i=0; i!=2; ++i)
+		{
+			directionRecords[i]->longitude = directions[i]->longitude;
+			directionRecords[i]->latitude = directions[i]->latitude;
+			directionRecords[i]->reference = directions[i]->reference;
+		}
+		fieldRecords.push_back(fieldRecord);
+	}
+	for(const std::vector<aocommon::ChannelInfo>& channels : _spectralWindows)
+	{
+		SpectralWindowRecord spectralWindowRecord;
+		spectralWindowRecord.firstChannel = channelRecords.size();
+		spectralWindowRecord.channelCount = channels.size();
+		spectralWindowRecords.push_back(spectralWindowRecord);
+		for(const aocommon::ChannelInfo& channel : channels)
+		{
+			ChannelRecord channelRecord;
+			channelRecord.frequency = channel.Frequency();
+			channelRecord.width = channel.Width();
+			channelRecords.push_back(channelRecord);
+		}
+	}
+
+	SidecarHeader header = SidecarHeader();
+	std::copy(sidecarMagic, sidecarMagic+8, header.magic);
+	header.stationCount = stationRecords.size();
+	header.antennaFieldCount = antennaFieldRecords.size();
+	header.elementCount = elementRecords.size();
+	header.fieldCount = fieldRecords.size();
+	header.spectralWindowCount = spectralWindowRecords.size();
+	header.channelCount = channelRecords.size();
+	header.stringTableSize = strings.size();
+
+	std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+	data.append(reinterpret_cast<const char*>(stationRecords.data()), stationRecords.size()*sizeof(StationRecord));
+	data.append(reinterpret_cast<const char*>(antennaFieldRecords.data()), antennaFieldRecords.size()*sizeof(AntennaFieldRecord));
+	data.append(reinterpret_cast<const char*>(elementRecords.data()), elementRecords.size()*sizeof(ElementRecord));
+	data.append(reinterpret_cast<const char*>(fieldRecords.data()), fieldRecords.size()*sizeof(FieldRecord));
+	data.append(reinterpret_cast<const char*>(spectralWindowRecords.data()), spectralWindowRecords.size()*sizeof(SpectralWindowRecord));
+	data.append(reinterpret_cast<const char*>(channelRecords.data()), channelRecords.size()*sizeof(ChannelRecord));
+	data += strings;
+
+	SidecarHeader& dataHeader = *reinterpret_cast<SidecarHeader*>(&data[0]);
+	dataHeader.payloadSize = data.size() - checksumOffset;
+	Hasher hasher;
+	hasher.Add(data.data() + checksumOffset, data.size() - checksumOffset);
+	dataHeader.checksum = hasher.Value();
+
+	// The temporary name is unique, because several runs may write the
+	// sidecar of the same observation at the same time
+	std::string tempFilename = filename + ".XXXXXX";
+	const int fd = mkstemp(&tempFilename[0]);
+	if(fd < 0)
+		throw std::runtime_error("Could not create sidecar " + tempFilename + ": " + strerror(errno));
+	// mkstemp() makes the file private, while a sidecar is not
+	fchmod(fd, 0644);
+	close(fd);
+	std::ofstream file(tempFilename, std::ios::binary);
+	file.write(data.data(), data.size());
+	file.close();
+	if(!file.good())
+	{
+		std::remove(tempFilename.c_str());
+		throw std::runtime_error("Could not write sidecar " + tempFilename);
+	}
+	if(std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tempFilename.c_str());
+		throw std::runtime_error("Could not rename sidecar " + tempFilename + ": " + strerror(errno));
+	}
+}
+
+MetaData MetaData::FromSidecar(const std::string& filename)
+{
+	int fd = open(filename.c_str(), O_RDONLY);
+	if(fd < 0)
+		throw std::runtime_error("Could not open sidecar " + filename + ": " + strerror(errno));
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) != 0)
+	{
+		close(fd);
+		throw std::runtime_error("Could not stat sidecar " + filename);
+	}
+	const size_t size = fileStat.st_size;
+	if(size < sizeof(SidecarHeader))
+	{
+		close(fd);
+		throw std::runtime_error("Sidecar " + filename + " is too small");
+	}
+	void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(mapping == MAP_FAILED)
+		throw std::runtime_error("Could not map sidecar " + filename + ": " + strerror(errno));
+
+	MetaData metaData;
+	try {
+		const char* data = static_cast<const char*>(mapping);
+		const SidecarHeader& header = *reinterpret_cast<const SidecarHeader*>(data);
+		if(!std::equal(sidecarMagic, sidecarMagic+6, header.magic))
+			throw std::runtime_error("File " + filename + " is not a sidecar file");
+		if(!std::equal(sidecarMagic+6, sidecarMagic+8, header.magic+6))
+			throw std::runtime_error("Sidecar " + filename + " was written by an incompatible version: remove it to recreate it");
+		const size_t expectedSize = sizeof(SidecarHeader) +
+			size_t(header.stationCount)*sizeof(StationRecord) +
+			size_t(header.antennaFieldCount)*sizeof(AntennaFieldRecord) +
+			size_t(header.elementCount)*sizeof(ElementRecord) +
+			size_t(header.fieldCount)*sizeof(FieldRecord) +
+			size_t(header.spectralWindowCount)*sizeof(SpectralWindowRecord) +
+			size_t(header.channelCount)*sizeof(ChannelRecord) +
+			header.stringTableSize;
+		if(header.payloadSize != size - checksumOffset || expectedSize != size)
+			throw std::runtime_error("Sidecar " + filename + " has an invalid size");
+		Hasher hasher;
+		hasher.Add(data + checksumOffset, size - checksumOffset);
+		if(hasher.Value() != header.checksum)
+			throw std::runtime_error("Sidecar " + filename + " is corrupt (checksum mismatch)");
+
+		const StationRecord* stationRecords = reinterpret_cast<const StationRecord*>(data + sizeof(SidecarHeader));
+		const AntennaFieldRecord* antennaFieldRecords = reinterpret_cast<const AntennaFieldRecord*>(stationRecords + header.stationCount);
+		const ElementRecord* elementRecords = reinterpret_cast<const ElementRecord*>(antennaFieldRecords + header.antennaFieldCount);
+		const FieldRecord* fieldRecords = reinterpret_cast<const FieldRecord*>(elementRecords + header.elementCount);
+		const SpectralWindowRecord* spectralWindowRecords = reinterpret_cast<const SpectralWindowRecord*>(fieldRecords + header.fieldCount);
+		const ChannelRecord* channelRecords = reinterpret_cast<const ChannelRecord*>(spectralWindowRecords + header.spectralWindowCount);
+		const char* strings = reinterpret_cast<const char*>(channelRecords + header.channelCount);
+		auto getString = [&](uint32_t offset, uint32_t length) {
+			if(size_t(offset) + length > header.stringTableSize)
+				throw std::runtime_error("Sidecar " + filename + " has an invalid name");
+			return std::string(strings + offset, length);
+		};
+
+		metaData._stations.resize(header.stationCount);
+		for(size_t s=0; s!=header.stationCount; ++s)
+		{
+			const StationRecord& stationRecord = stationRecords[s];
+			StationLayout& station = metaData._stations[s];
+			station.name = getString(stationRecord.nameOffset, stationRecord.nameLength);
+			copyVector(stationRecord.position, station.position);
+			copyVector(stationRecord.phaseReference, station.phaseReference);
+			if(size_t(stationRecord.firstAntennaField) + stationRecord.antennaFieldCount > header.antennaFieldCount)
+				throw std::runtime_error("Sidecar " + filename + " has an invalid antenna field index");
+			station.fields.resize(stationRecord.antennaFieldCount);
+			for(size_t f=0; f!=stationRecord.antennaFieldCount; ++f)
+			{
+				const AntennaFieldRecord& fieldRecord = antennaFieldRecords[stationRecord.firstAntennaField + f];
+				AntennaFieldLayout& field = station.fields[f];
+				field.name = getString(fieldRecord.nameOffset, fieldRecord.nameLength);
+				copyVector(fieldRecord.origin, field.origin);
+				for(size_t axis=0; axis!=3; ++axis)
+					copyVector(fieldRecord.axes[axis], field.axes[axis]);
+				field.hasTileConfig = fieldRecord.hasTileConfig != 0;
+				for(size_t element=0; element!=16; ++element)
+					copyVector(fieldRecord.tileConfig[element], field.tileConfig[element]);
+				if(size_t(fieldRecord.firstElement) + fieldRecord.elementCount > header.elementCount)
+					throw std::runtime_error("Sidecar " + filename + " has an invalid element index");
+				field.elements.resize(fieldRecord.elementCount);
+				for(size_t e=0; e!=fieldRecord.elementCount; ++e)
+				{
+					const ElementRecord& elementRecord = elementRecords[fieldRecord.firstElement + e];
+					copyVector(elementRecord.offset, field.elements[e].offset);
+					field.elements[e].enabled[0] = elementRecord.enabled[0] != 0;
+					field.elements[e].enabled[1] = elementRecord.enabled[1] != 0;
+				}
+			}
+		}
+		metaData._fields.resize(header.fieldCount);
+		for(size_t f=0; f!=header.fieldCount; ++f)
+		{
+			const FieldRecord& fieldRecord = fieldRecords[f];
+			Field& field = metaData._fields[f];
+			field.name = getString(fieldRecord.nameOffset, fieldRecord.nameLength);
+			const DirectionRecord* directionRecords[2] = { &fieldRecord.delayDirection, &fieldRecord.tileBeamDirection };
+			Direction* directions[2] = { &field.delayDirection, &field.tileBeamDirection };
+			for(size_t i=0; i!=2; ++i)
+			{
+				directions[i]->longitude = directionRecords[i]->longitude;
+				directions[i]->latitude = directionRecords[i]->latitude;
+				directions[i]->reference = directionRecords[i]->reference;
+			}
+		}
+		metaData._spectralWindows.resize(header.spectralWindowCount);
+		for(size_t w=0; w!=header.spectralWindowCount; ++w)
+		{
+			const SpectralWindowRecord& spectralWindowRecord = spectralWindowRecords[w];
+			if(size_t(spectralWindowRecord.firstChannel) + spectralWindowRecord.channelCount > header.channelCount)
+				throw std::runtime_error("Sidecar " + filename + " has an invalid channel index");
+			for(size_t c=0; c!=spectralWindowRecord.channelCount; ++c)
+			{
+				const ChannelRecord& channelRecord = channelRecords[spectralWindowRecord.firstChannel + c];
+				metaData._spectralWindows[w].emplace_back(channelRecord.frequency, channelRecord.width);
+			}
+		}
+	} catch(...) {
+		munmap(mapping, size);
+		throw;
+	}
+	munmap(mapping, size);
+	return metaData;
+}
@@ -0,0 +1,92 @@
+#ifndef META_DATA_H
+#define META_DATA_H
+
+#include "stationlayout.h"
+
+#include <aocommon/banddata.h>
+
+#include <casacore/measures/Measures/MDirection.h>
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * The meta data of an observation that is required to calculate the beam
+ * response, apart from the times: the station layouts, the delay and tile
+ * beam directions of every field and the frequency setup of every spectral
+ * window.
+ *
+ * Reading this from a measurement set requires opening several of its
+ * subtables. To speed up the startup of later runs, the meta data can be
+ * written to a compact binary "sidecar" file, which is memory mapped when
+ * it is read back.
+ */
+class MetaData
+{
+public:
+	/**
+	 * Read the meta data from the subtables of a measurement set. The main
+	 * table is not read.
+	 */
+	static MetaData FromMS(casacore::MeasurementSet& ms);
+
+	static MetaData FromSidecar(const std::string& filename);
+
+	void WriteSidecar(const std::string& filename) const;
+
+	const std::vector<StationLayout>& Stations() const { return _stations; }
+
+	/** Number of rows in the FIELD table. */
+	size_t FieldCount() const { return _fields.size(); }
+
+	const std::string& FieldName(size_t field) const { return _fields[field].name; }
+
+	casacore::MDirection DelayDirection(size_t field) const { return _fields[field].delayDirection.ToMDirection(); }
+
+	casacore::MDirection TileBeamDirection(size_t field) const { return _fields[field].tileBeamDirection.ToMDirection(); }
+
+	/** Number of rows in the SPECTRAL_WINDOW table. */
+	size_t SpectralWindowCount() const { return _spectralWindows.size(); }
+
+	const std::vector<aocommon::ChannelInfo>& Channels(size_t spectralWindow) const { return _spectralWindows[spectralWindow]; }
+
+	aocommon::BandData Band(size_t spectralWindow) const { return aocommon::BandData(_spectralWindows[spectralWindow]); }
+
+	/**
+	 * A hash of the complete station layouts, including the element
+	 * offsets and flags, the directions and the channels. It is the same whether the meta data was read from a
+	 * measurement set or from a sidecar.
+	 */
+	uint64_t Key() const;
+
+	/**
+	 * Like @ref Key(), but without the channels. Observations with the same
+	 * layout key can share their station objects and direction conversions.
+	 */
+	uint64_t LayoutKey() const;
+
+private:
+	struct Direction
+	{
+		Direction() : longitude(0.0), latitude(0.0), reference(casacore::MDirection::J2000) { }
+		explicit Direction(const casacore::MDirection& direction);
+		casacore::MDirection ToMDirection() const;
+
+		double longitude, latitude;
+		uint32_t reference;
+	};
+
+	struct Field
+	{
+		std::string name;
+		Direction delayDirection, tileBeamDirection;
+	};
+
+	std::vector<StationLayout> _stations;
+	std::vector<Field> _fields;
+	std::vector<std::vector<aocommon::ChannelInfo>> _spectralWindows;
+};
+
+#endif
@@ -17,16 +17,24 @@
 
 #include "../units/radeccoord.h"
 
+/**
+ * Reads models in the BBS format. Read() reads a complete model; a
+ * BBSModel object reads the sources of a file one at a time, so that a
+ * large model can be processed without holding it in memory.
+ */
 class BBSModel
 {
 public:
-	static Model Read(const std::string& input, const std::string& sourceName = "")
+	/**
+	 * Opens the model and reads its format line. Every source is read with
+	 * ReadSource().
+	 */
+	explicit BBSModel(const std::string& input) : _inFile(input)
 	{
-		std::ifstream inFile(input);
-		if(!inFile)
+		if(!_inFile)
 			throw BBSParseException("Could not open model file");
 		std::string line;
-		std::getline(inFile, line);
+		std::getline(_inFile, line);
 		if(line.size()>=3 && line.substr(0, 3) == "# (")
 			line = line.substr(3);
 		else if(boost::to_lower_copy(line.substr(0, 8)) == "format =")
@@ -37,7 +45,7 @@ public:
 			line = line.substr(0, line.size()-8);
 		boost::char_separator<char> sep(" ,()");
 		boost::tokenizer<boost::char_separator<char>> tok(line, sep);
-		Headers h;
+		Headers& h = _headers;
 		int index = 0;
 		for(auto s : tok)
 		{
@@ -81,25 +89,30 @@ public:
 				throw BBSParseException("Unknown header: '" + key + "'");
 			++index;
 		}
-		
-		Model model;
-		std::getline(inFile, line);
-		ModelSource globalSource;
-		if(!sourceName.empty())
-			globalSource.SetName(sourceName);
-		while(inFile.good())
+		std::getline(_inFile, _line);
+	}
+	
+	/**
+	 * Reads the next source, which has a single component. Patch lines are
+	 * skipped. Returns false when the end of the file is reached.
+	 */
+	bool ReadSource(ModelSource& source)
+	{
+		const Headers& h = _headers;
+		while(_inFile.good())
 		{
-			ModelSource source;
+			source = ModelSource();
 			ModelComponent component;
 			bool isPatch = false;
 			double refFreq = 0;
 			aocommon::UVector<double> frequencyTerms;
 			PowerLawSED sed;
 			double stokesI = 0.0;
-			index = 0;
+			int index = 0;
 			
-			BBSLine bbsLine(line);
-			if(!line.empty() && line[0]!='#')
+			BBSLine bbsLine(_line);
+			const bool isSource = !_line.empty() && _line[0]!='#';
+			if(isSource)
 			{
 				while(bbsLine.MoveToNext())
 				{
@@ -157,19 +170,35 @@ public:
 				double brightness[] = { stokesI, 0.0, 0.0, 0.0 };
 				sed.SetData(refFreq, brightness, frequencyTerms);
 				component.SetSED(sed);
-				if(!isPatch)
-				{
-					if(sourceName.empty())
-					{
-						source.AddComponent(component);
-						model.AddSource(source);
-					}
-					else {
-						globalSource.AddComponent(component);
-					}
-				}
 			}
-			std::getline(inFile, line);
+			std::getline(_inFile, _line);
+			if(isSource && !isPatch)
+			{
+				source.AddComponent(std::move(component));
+				return true;
+			}
+		}
+		return false;
+	}
+	
+	/**
+	 * Reads a complete model. When a source name is given, all components
+	 * are combined into a single source with that name.
+	 */
+	static Model Read(const std::string& input, const std::string& sourceName = "")
+	{
+		BBSModel reader(input);
+		Model model;
+		ModelSource globalSource;
+		if(!sourceName.empty())
+			globalSource.SetName(sourceName);
+		ModelSource source;
+		while(reader.ReadSource(source))
+		{
+			if(sourceName.empty())
+				model.AddSource(std::move(source));
+			else
+				globalSource.AddComponent(source.Component(0));
 		}
 		if(!sourceName.empty())
 			model.AddSource(globalSource);
@@ -231,6 +260,11 @@ private:
 			referenceFrequency=-1,
 			majAxisInd=-1, minAxisInd=-1, orientationInd=-1, logSIInd=-1;
 	};
+	
+	std::ifstream _inFile;
+	Headers _headers;
+	/** The next line to be read by ReadSource(). */
+	std::string _line;
 };
 
 #endif
@@ -0,0 +1,358 @@
+#include "binarymodel.h"
+
+#include "mappedfile.h"
+#include "model.h"
+
+#include "../hasher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	/*
+	 * Layout of a binary model: a header, followed by the source, component,
+	 * measurement and power-law records, the power-law terms and the string
+	 * table. All records have a size that is a multiple of 8 bytes, so that
+	 * they are aligned when the file is mapped. The last two characters of
+	 * the magic are the version.
+	 */
+	const char binaryModelMagic[8] = { 'S', 'R', 'M', 'O', 'D', 'L', '0', '1' };
+
+	struct BinaryModelHeader
+	{
+		char magic[8];
+		/** Size of the file after the magic, size and checksum fields. */
+		uint64_t payloadSize;
+		uint64_t checksum;
+		/**
+		 * Size and modification time in ns of the text model that this is the
+		 * cache of, or zero for a binary model that was saved explicitly.
+		 */
+		uint64_t textSize;
+		int64_t textModificationTime;
+		uint32_t sourceCount, componentCount, measurementCount, powerLawCount;
+		uint32_t termCount, stringTableSize;
+	};
+	const size_t checksumOffset = sizeof(BinaryModelHeader::magic) + sizeof(uint64_t)*2;
+
+	enum SEDType { NoSED = 0, MeasuredSEDType = 1, PowerLawSEDType = 2 };
+
+	struct SourceRecord
+	{
+		uint32_t nameOffset, nameLength, clusterOffset, clusterLength;
+		uint32_t firstComponent, componentCount;
+	};
+
+	struct ComponentRecord
+	{
+		double ra, dec;
+		double majorAxis, minorAxis, positionAngle;
+		uint32_t type, sedType;
+		/** Index of the first measurement or of the power law, depending on the SED type. */
+		uint32_t firstSED, sedCount;
+	};
+
+	struct MeasurementRecord
+	{
+		double frequency, bandwidth;
+		double fluxDensities[4];
+		double fluxDensityStddevs[4];
+	};
+
+	struct PowerLawRecord
+	{
+		double referenceFrequency;
+		double brightness[4];
+		uint32_t firstTerm, termCount;
+		uint32_t isLogarithmic, padding;
+	};
+
+	template<typename T>
+	void append(std::string& data, const std::vector<T>& records)
+	{
+		data.append(reinterpret_cast<const char*>(records.data()), records.size()*sizeof(T));
+	}
+
+	const BinaryModelHeader& validatedHeader(const char* data, size_t size, const std::string& filename)
+	{
+		if(size < sizeof(BinaryModelHeader) || !std::equal(binaryModelMagic, binaryModelMagic+6, data))
+			throw std::runtime_error("File " + filename + " is not a binary model");
+		const BinaryModelHeader& header = *reinterpret_cast<const BinaryModelHeader*>(data);
+		if(!std::equal(binaryModelMagic+6, binaryModelMagic+8, header.magic+6))
+			throw std::runtime_error("Binary model " + filename + " was written by an incompatible version");
+		const size_t expectedSize = sizeof(BinaryModelHeader) +
+			size_t(header.sourceCount)*sizeof(SourceRecord) +
+			size_t(header.componentCount)*sizeof(ComponentRecord) +
+			size_t(header.measurementCount)*sizeof(MeasurementRecord) +
+			size_t(header.powerLawCount)*sizeof(PowerLawRecord) +
+			size_t(header.termCount)*sizeof(double) +
+			header.stringTableSize;
+		if(header.payloadSize != size - checksumOffset || expectedSize != size)
+			throw std::runtime_error("Binary model " + filename + " has an invalid size");
+		Hasher hasher;
+		hasher.Add(data + checksumOffset, size - checksumOffset);
+		if(hasher.Value() != header.checksum)
+			throw std::runtime_error("Binary model " + filename + " is corrupt (checksum mismatch)");
+		return header;
+	}
+}
+
+bool BinaryModel::IsBinaryModel(const char* data, size_t size)
+{
+	return size >= sizeof(binaryModelMagic) && std::equal(binaryModelMagic, binaryModelMagic+6, data);
+}
+
+void BinaryModel::Read(Model& model, const char* data, size_t size, const std::string& filename)
+{
+	const BinaryModelHeader& header = validatedHeader(data, size, filename);
+	const SourceRecord* sourceRecords = reinterpret_cast<const SourceRecord*>(data + sizeof(BinaryModelHeader));
+	const ComponentRecord* componentRecords = reinterpret_cast<const ComponentRecord*>(sourceRecords + header.sourceCount);
+	const MeasurementRecord* measurementRecords = reinterpret_cast<const MeasurementRecord*>(componentRecords + header.componentCount);
+	const PowerLawRecord* powerLawRecords = reinterpret_cast<const PowerLawRecord*>(measurementRecords + header.measurementCount);
+	const double* terms = reinterpret_cast<const double*>(powerLawRecords + header.powerLawCount);
+	const char* strings = reinterpret_cast<const char*>(terms + header.termCount);
+	auto getString = [&](uint32_t offset, uint32_t length) {
+		if(size_t(offset) + length > header.stringTableSize)
+			throw std::runtime_error("Binary model " + filename + " has an invalid name");
+		return std::string(strings + offset, length);
+	};
+	auto checkRange = [&](uint32_t first, uint32_t count, uint32_t total) {
+		if(size_t(first) + count > total)
+			throw std::runtime_error("Binary model " + filename + " has an invalid index");
+	};
+
+	model.ReserveSources(model.SourceCount() + header.sourceCount);
+	for(size_t s=0; s!=header.sourceCount; ++s)
+	{
+		const SourceRecord& sourceRecord = sourceRecords[s];
+		ModelSource source;
+		source.SetName(getString(sourceRecord.nameOffset, sourceRecord.nameLength));
+		source.SetClusterName(getString(sourceRecord.clusterOffset, sourceRecord.clusterLength));
+		checkRange(sourceRecord.firstComponent, sourceRecord.componentCount, header.componentCount);
+		for(size_t c=0; c!=sourceRecord.componentCount; ++c)
+		{
+			const ComponentRecord& componentRecord = componentRecords[sourceRecord.firstComponent + c];
+			ModelComponent component;
+			component.SetType(componentRecord.type == ModelComponent::GaussianSource ? ModelComponent::GaussianSource : ModelComponent::PointSource);
+			component.SetPosRA(componentRecord.ra);
+			component.SetPosDec(componentRecord.dec);
+			component.SetMajorAxis(componentRecord.majorAxis);
+			component.SetMinorAxis(componentRecord.minorAxis);
+			component.SetPositionAngle(componentRecord.positionAngle);
+			if(componentRecord.sedType == MeasuredSEDType)
+			{
+				checkRange(componentRecord.firstSED, componentRecord.sedCount, header.measurementCount);
+				std::unique_ptr<MeasuredSED> sed(new MeasuredSED());
+				for(size_t m=0; m!=componentRecord.sedCount; ++m)
+				{
+					const MeasurementRecord& measurementRecord = measurementRecords[componentRecord.firstSED + m];
+					Measurement measurement;
+					measurement.SetFrequencyHz(measurementRecord.frequency);
+					measurement.SetBandWidthHz(measurementRecord.bandwidth);
+					for(size_t p=0; p!=4; ++p)
+					{
+						measurement.SetFluxDensityFromIndex(p, measurementRecord.fluxDensities[p]);
+						measurement.SetFluxDensityStddevFromIndex(p, measurementRecord.fluxDensityStddevs[p]);
+					}
+					sed->AddMeasurement(measurement);
+				}
+				component.SetSED(std::move(sed));
+			}
+			else if(componentRecord.sedType == PowerLawSEDType)
+			{
+				checkRange(componentRecord.firstSED, 1, header.powerLawCount);
+				const PowerLawRecord& powerLawRecord = powerLawRecords[componentRecord.firstSED];
+				checkRange(powerLawRecord.firstTerm, powerLawRecord.termCount, header.termCount);
+				std::unique_ptr<PowerLawSED> sed(new PowerLawSED());
+				const std::vector<double> siTerms(terms + powerLawRecord.firstTerm, terms + powerLawRecord.firstTerm + powerLawRecord.termCount);
+				sed->SetData(powerLawRecord.referenceFrequency, powerLawRecord.brightness, siTerms);
+				sed->SetIsLogarithmic(powerLawRecord.isLogarithmic != 0);
+				component.SetSED(std::move(sed));
+			}
+			source.AddComponent(std::move(component));
+		}
+		model.AddSource(std::move(source));
+		model.FindOrAddCluster(model.Source(model.SourceCount()-1).ClusterName());
+	}
+}
+
+void BinaryModel::write(const Model& model, const std::string& filename, uint64_t textSize, int64_t textModificationTime)
+{
+	std::vector<SourceRecord> sourceRecords;
+	std::vector<ComponentRecord> componentRecords;
+	std::vector<MeasurementRecord> measurementRecords;
+	std::vector<PowerLawRecord> powerLawRecords;
+	std::vector<double> terms;
+	std::string strings;
+	// Clusters are shared by many sources, so their names are stored once
+	std::map<std::string, uint32_t> clusterOffsets;
+	sourceRecords.reserve(model.SourceCount());
+	componentRecords.reserve(model.ComponentCount());
+
+	for(const ModelSource& source : model)
+	{
+		SourceRecord sourceRecord = SourceRecord();
+		sourceRecord.nameOffset = strings.size();
+		sourceRecord.nameLength = source.Name().size();
+		strings += source.Name();
+		std::map<std::string, uint32_t>::const_iterator cluster = clusterOffsets.find(source.ClusterName());
+		if(cluster == clusterOffsets.end())
+		{
+			cluster = clusterOffsets.emplace(source.ClusterName(), strings.size()).first;
+			strings += source.ClusterName();
+		}
+		sourceRecord.clusterOffset = cluster->second;
+		sourceRecord.clusterLength = source.ClusterName().size();
+		sourceRecord.firstComponent = componentRecords.size();
+		sourceRecord.componentCount = source.ComponentCount();
+		sourceRecords.push_back(sourceRecord);
+
+		for(const ModelComponent& component : source)
+		{
+			ComponentRecord componentRecord = ComponentRecord();
+			componentRecord.ra = component.PosRA();
+			componentRecord.dec = component.PosDec();
+			componentRecord.majorAxis = component.MajorAxis();
+			componentRecord.minorAxis = component.MinorAxis();
+			componentRecord.positionAngle = component.PositionAngle();
+			componentRecord.type = component.Type();
+			if(component.HasMeasuredSED())
+			{
+				componentRecord.sedType = MeasuredSEDType;
+				componentRecord.firstSED = measurementRecords.size();
+				componentRecord.sedCount = component.MSED().MeasurementCount();
+				for(const MeasuredSED::value_type& value : component.MSED())
+				{
+					const Measurement& measurement = value.second;
+					MeasurementRecord measurementRecord = MeasurementRecord();
+					measurementRecord.frequency = measurement.FrequencyHz();
+					measurementRecord.bandwidth = measurement.BandWidthHz();
+					for(size_t p=0; p!=4; ++p)
+					{
+						measurementRecord.fluxDensities[p] = measurement.FluxDensityFromIndex(p);
+						measurementRecord.fluxDensityStddevs[p] = measurement.FluxDensityStddevFromIndex(p);
+					}
+					measurementRecords.push_back(measurementRecord);
+				}
+			}
+			else if(component.HasPowerLawSED())
+			{
+				const PowerLawSED& sed = static_cast<const PowerLawSED&>(component.SED());
+				PowerLawRecord powerLawRecord = PowerLawRecord();
+				std::vector<double> siTerms;
+				sed.GetData(powerLawRecord.referenceFrequency, powerLawRecord.brightness, siTerms);
+				powerLawRecord.firstTerm = terms.size();
+				powerLawRecord.termCount = siTerms.size();
+				powerLawRecord.isLogarithmic = sed.IsLogarithmic();
+				terms.insert(terms.end(), siTerms.begin(), siTerms.end());
+				componentRecord.sedType = PowerLawSEDType;
+				componentRecord.firstSED = powerLawRecords.size();
+				componentRecord.sedCount = 1;
+				powerLawRecords.push_back(powerLawRecord);
+			}
+			componentRecords.push_back(componentRecord);
+		}
+	}
+	// All counts and offsets are stored as 32-bit values
+	if(strings.size() > UINT32_MAX || sourceRecords.size() > UINT32_MAX || componentRecords.size() > UINT32_MAX ||
+		measurementRecords.size() > UINT32_MAX || powerLawRecords.size() > UINT32_MAX || terms.size() > UINT32_MAX)
+		throw std::runtime_error("Model is too large to be written as a binary model");
+
+	BinaryModelHeader header = BinaryModelHeader();
+	std::copy(binaryModelMagic, binaryModelMagic+8, header.magic);
+	header.textSize = textSize;
+	header.textModificationTime = textModificationTime;
+	header.sourceCount = sourceRecords.size();
+	header.componentCount = componentRecords.size();
+	header.measurementCount = measurementRecords.size();
+	header.powerLawCount = powerLawRecords.size();
+	header.termCount = terms.size();
+	header.stringTableSize = strings.size();
+
+	std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+	append(data, sourceRecords);
+	append(data, componentRecords);
+	append(data, measurementRecords);
+	append(data, powerLawRecords);
+	append(data, terms);
+	data += strings;
+
+	BinaryModelHeader& dataHeader = *reinterpret_cast<BinaryModelHeader*>(&data[0]);
+	dataHeader.payloadSize = data.size() - checksumOffset;
+	Hasher hasher;
+	hasher.Add(data.data() + checksumOffset, data.size() - checksumOffset);
+	dataHeader.checksum = hasher.Value();
+
+	// Written under a temporary name, so that concurrent readers never see a
+	// partially written model. The name is unique, because several processes
+	// may write the cache of the same model at the same time.
+	std::string tempFilename = filename + ".XXXXXX";
+	const int fd = mkstemp(&tempFilename[0]);
+	if(fd < 0)
+		throw std::runtime_error("Could not create binary model " + tempFilename + ": " + strerror(errno));
+	// mkstemp() makes the file private, while a model is not
+	fchmod(fd, 0644);
+	close(fd);
+	std::ofstream file(tempFilename, std::ios::binary);
+	file.write(data.data(), data.size());
+	file.close();
+	if(!file.good())
+	{
+		std::remove(tempFilename.c_str());
+		throw std::runtime_error("Could not write binary model " + tempFilename);
+	}
+	if(std::rename(tempFilename.c_str(), filename.c_str()) != 0)
+	{
+		std::remove(tempFilename.c_str());
+		throw std::runtime_error("Could not rename binary model " + tempFilename + ": " + strerror(errno));
+	}
+}
+
+bool BinaryModel::ReadTextStamp(const std::string& textFilename, TextStamp& stamp)
+{
+	struct stat fileStat;
+	if(stat(textFilename.c_str(), &fileStat) != 0)
+		return false;
+	stamp.size = fileStat.st_size;
+	stamp.modificationTime = int64_t(fileStat.st_mtim.tv_sec) * 1000000000 + fileStat.st_mtim.tv_nsec;
+	return true;
+}
+
+bool BinaryModel::ReadCache(Model& model, const std::string& textFilename, const TextStamp& stamp)
+{
+	const std::string cacheFilename = CacheFilename(textFilename);
+	if(access(cacheFilename.c_str(), R_OK) != 0)
+		return false;
+	try {
+		const MappedFile file(cacheFilename);
+		const BinaryModelHeader& header = validatedHeader(file.Data(), file.Size(), cacheFilename);
+		if(header.textSize != stamp.size || header.textModificationTime != stamp.modificationTime)
+			return false;
+		Model cached;
+		Read(cached, file.Data(), file.Size(), cacheFilename);
+		if(model.Empty())
+			model = std::move(cached);
+		else
+			model += cached;
+		return true;
+	} catch(std::exception&) {
+		// An invalid cache is replaced by a new one
+		return false;
+	}
+}
+
+void BinaryModel::WriteCache(const Model& model, const std::string& textFilename, const TextStamp& stamp)
+{
+	write(model, CacheFilename(textFilename), stamp.size, stamp.modificationTime);
+}
@@ -0,0 +1,73 @@
+#ifndef BINARY_MODEL_H
+#define BINARY_MODEL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class Model;
+
+/**
+ * A binary representation of a model that can be loaded without any text
+ * parsing. It consists of flat arrays of source, component, measurement and
+ * power-law records, followed by the terms of the power laws and a string
+ * table with the source and cluster names. The file is memory mapped when
+ * it is read, and carries a version and a checksum.
+ *
+ * A binary model is used in two ways: it can be saved explicitly with
+ * Model::Save(filename, true) and given wherever a model file is accepted,
+ * and it is used as a cache next to a text model: see ReadCache() and
+ * WriteCache().
+ */
+class BinaryModel
+{
+	public:
+		/**
+		 * The size and modification time of a text model, which identify the
+		 * version of the text that a cache was written for.
+		 */
+		struct TextStamp
+		{
+			uint64_t size;
+			int64_t modificationTime;
+		};
+
+		/** Whether the data starts with the magic of a binary model. */
+		static bool IsBinaryModel(const char* data, size_t size);
+
+		/**
+		 * Adds the sources of a binary model to the model. The filename is only
+		 * used in error messages.
+		 */
+		static void Read(Model& model, const char* data, size_t size, const std::string& filename);
+
+		static void Write(const Model& model, const std::string& filename) { write(model, filename, 0, 0); }
+
+		/** The filename of the cache of a text model, which is next to it. */
+		static std::string CacheFilename(const std::string& textFilename) { return textFilename + ".bin"; }
+
+		/**
+		 * Reads the stamp of a text model. Returns false when the file does not
+		 * exist.
+		 */
+		static bool ReadTextStamp(const std::string& textFilename, TextStamp& stamp);
+
+		/**
+		 * Reads the cache of a text model into the model. Returns false when the
+		 * cache does not exist, was written for a text model with a different
+		 * stamp, or is invalid; in that case, the model is unchanged.
+		 */
+		static bool ReadCache(Model& model, const std::string& textFilename, const TextStamp& stamp);
+
+		/**
+		 * Writes the cache of a text model. The stamp must be read before the
+		 * text is parsed, so that a text that changes while it is parsed gets a
+		 * cache with the old stamp, which the next read replaces.
+		 */
+		static void WriteCache(const Model& model, const std::string& textFilename, const TextStamp& stamp);
+
+	private:
+		static void write(const Model& model, const std::string& filename, uint64_t textSize, int64_t textModificationTime);
+};
+
+#endif
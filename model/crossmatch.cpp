@@ -0,0 +1,128 @@
+#include "crossmatch.h"
+
+#include "model.h"
+#include "skyindex.h"
+
+#include <aocommon/parallelfor.h>
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+namespace {
+	/**
+	 * Combines the components of a source into the components of another
+	 * source at the same direction, see CrossMatch::Merge().
+	 */
+	void mergeSource(ModelSource& destination, const ModelSource& source, double tolerance, double weight)
+	{
+		const size_t componentCount = destination.ComponentCount();
+		for(const ModelComponent& component : source)
+		{
+			size_t nearest = componentCount;
+			double nearestDistance = tolerance;
+			for(size_t i=0; i!=componentCount; ++i)
+			{
+				const ModelComponent& candidate = destination.Component(i);
+				const double distance = SkyIndex::Distance(candidate.PosRA(), candidate.PosDec(), component.PosRA(), component.PosDec());
+				if(distance <= nearestDistance)
+				{
+					nearest = i;
+					nearestDistance = distance;
+				}
+			}
+			if(nearest == componentCount)
+				destination.AddComponent(component);
+			else {
+				ModelComponent& match = *(destination.begin() + nearest);
+				if(match.HasMeasuredSED() && component.HasMeasuredSED())
+					match.MSED().CombineMeasurementsWithAveraging(component.MSED(), weight);
+			}
+		}
+	}
+}
+
+CrossMatch::CrossMatch(const Model& first, const Model& second, double tolerance, size_t threadCount) :
+	_first(first),
+	_second(second),
+	_tolerance(tolerance),
+	_threadCount(threadCount == 0 ? std::max(1u, std::thread::hardware_concurrency()) : threadCount)
+{
+	// Building the indices is not thread safe, so it is done before the searches
+	_first.Index();
+	_second.Index();
+	const std::vector<size_t> nearestInSecond = findNearest(_first, _second);
+	const std::vector<size_t> nearestInFirst = findNearest(_second, _first);
+
+	for(size_t i=0; i!=nearestInSecond.size(); ++i)
+	{
+		const size_t j = nearestInSecond[i];
+		if(j != Model::npos && nearestInFirst[j] == i)
+		{
+			const ModelComponent& a = _first.Source(i).Peak();
+			const ModelComponent& b = _second.Source(j).Peak();
+			_matches.push_back(Match{i, j, SkyIndex::Distance(a.PosRA(), a.PosDec(), b.PosRA(), b.PosDec())});
+		}
+		else
+			_unmatchedFirst.push_back(i);
+	}
+	for(size_t j=0; j!=nearestInFirst.size(); ++j)
+	{
+		const size_t i = nearestInFirst[j];
+		if(i == Model::npos || nearestInSecond[i] != j)
+			_unmatchedSecond.push_back(j);
+	}
+}
+
+std::vector<size_t> CrossMatch::findNearest(const Model& from, const Model& to) const
+{
+	std::vector<size_t> nearest(from.SourceCount(), Model::npos);
+	const SkyIndex& index = to.Index();
+	aocommon::ParallelFor<size_t> loop(_threadCount);
+	loop.Run(0, from.SourceCount(), [&](size_t i, size_t)
+	{
+		const ModelSource& source = from.Source(i);
+		if(source.ComponentCount() != 0)
+		{
+			const size_t match = index.FindNearest(source.Peak().PosRA(), source.Peak().PosDec(), _tolerance);
+			if(match != SkyIndex::npos)
+				nearest[i] = match;
+		}
+	});
+	return nearest;
+}
+
+Model CrossMatch::Merge(double weight) const
+{
+	std::vector<ModelSource> sources(_first.begin(), _first.end());
+	std::vector<std::exception_ptr> errors(_matches.size());
+	aocommon::ParallelFor<size_t> loop(_threadCount);
+	loop.Run(0, _matches.size(), [&](size_t i, size_t)
+	{
+		// Every source is matched at most once, so the iterations change different sources
+		try {
+			mergeSource(sources[_matches[i].first], _second.Source(_matches[i].second), _tolerance, weight);
+		} catch(...) {
+			errors[i] = std::current_exception();
+		}
+	});
+	for(const std::exception_ptr& error : errors)
+	{
+		if(error)
+			std::rethrow_exception(error);
+	}
+
+	Model merged;
+	merged.ReserveSources(sources.size() + _unmatchedSecond.size());
+	for(ModelSource& source : sources)
+	{
+		merged.FindOrAddCluster(source.ClusterName());
+		merged.AddSource(std::move(source));
+	}
+	for(size_t j : _unmatchedSecond)
+	{
+		merged.FindOrAddCluster(_second.Source(j).ClusterName());
+		merged.AddSource(_second.Source(j));
+	}
+	return merged;
+}
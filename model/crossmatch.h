@@ -0,0 +1,78 @@
+#ifndef CROSS_MATCH_H
+#define CROSS_MATCH_H
+
+#include <cstddef>
+#include <vector>
+
+class Model;
+
+/**
+ * Matches the sources of two models by direction, e.g. to merge a new
+ * survey into a master model. The direction of a source is that of its
+ * peak component, as in Model::Index(). Two sources match when each is the
+ * nearest source of the other in the other model and they are at most the
+ * tolerance apart, so that every source is matched at most once. The
+ * nearest sources are found with the spatial indices of the models, on
+ * several threads.
+ *
+ * The models must outlive the cross match and must not be changed while
+ * it is used.
+ */
+class CrossMatch
+{
+	public:
+		struct Match
+		{
+			/** Index of the source in the first model. */
+			size_t first;
+			/** Index of the source in the second model. */
+			size_t second;
+			/** Angular distance between the sources, in radians. */
+			double distance;
+		};
+
+		/**
+		 * Matches the sources, with the tolerance in radians. When threadCount
+		 * is zero, all cores are used.
+		 */
+		CrossMatch(const Model& first, const Model& second, double tolerance, size_t threadCount = 0);
+
+		/** The matched sources, in the order of the first model. */
+		const std::vector<Match>& Matches() const { return _matches; }
+
+		/** Indices of the sources of the first model that have no match. */
+		const std::vector<size_t>& UnmatchedFirst() const { return _unmatchedFirst; }
+
+		/** Indices of the sources of the second model that have no match. */
+		const std::vector<size_t>& UnmatchedSecond() const { return _unmatchedSecond; }
+
+		/**
+		 * Returns the merged model: the sources of the first model, followed by
+		 * the unmatched sources of the second. The measurements of a matched
+		 * source of the second model are combined into the component of the
+		 * first source that is nearest to them with
+		 * MeasuredSED::CombineMeasurementsWithAveraging(), where weight is the
+		 * weight of the second model at frequencies that both have. Components
+		 * that are further than the tolerance from every component of the
+		 * first source are added to it. Components without a measured SED keep
+		 * the SED of the first model.
+		 */
+		Model Merge(double weight = 0.5) const;
+
+	private:
+		/**
+		 * For every source of from, the index of the nearest source of to within
+		 * the tolerance, or Model::npos.
+		 */
+		std::vector<size_t> findNearest(const Model& from, const Model& to) const;
+
+		const Model& _first;
+		const Model& _second;
+		double _tolerance;
+		size_t _threadCount;
+		std::vector<Match> _matches;
+		std::vector<size_t> _unmatchedFirst;
+		std::vector<size_t> _unmatchedSecond;
+};
+
+#endif
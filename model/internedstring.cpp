@@ -0,0 +1,87 @@
+#include "internedstring.h"
+
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * The table is split into shards by the hash of the strings, each with its
+ * own lock, so that threads that parse a model concurrently rarely wait for
+ * each other.
+ */
+class InternedString::Table
+{
+	public:
+		static constexpr size_t shardCount = 16;
+
+		struct Shard
+		{
+			std::mutex mutex;
+			/** The keys view the texts of the entries. */
+			std::unordered_map<std::string_view, std::unique_ptr<Entry>> entries;
+		};
+
+		static Table& Instance()
+		{
+			// Never destroyed, because handles in static objects may outlive it
+			static Table* table = new Table();
+			return *table;
+		}
+
+		Shard shards[shardCount];
+};
+
+InternedString::InternedString(std::string_view text) : _entry(nullptr)
+{
+	if(text.empty())
+		return;
+	const size_t shardIndex = std::hash<std::string_view>()(text) % Table::shardCount;
+	Table::Shard& shard = Table::Instance().shards[shardIndex];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	std::unordered_map<std::string_view, std::unique_ptr<Entry>>::iterator entry = shard.entries.find(text);
+	if(entry == shard.entries.end())
+	{
+		std::unique_ptr<Entry> newEntry(new Entry());
+		newEntry->references.store(0, std::memory_order_relaxed);
+		newEntry->shard = shardIndex;
+		newEntry->text = std::string(text);
+		const std::string_view key = newEntry->text;
+		entry = shard.entries.emplace(key, std::move(newEntry)).first;
+	}
+	entry->second->references.fetch_add(1, std::memory_order_relaxed);
+	_entry = entry->second.get();
+}
+
+bool InternedString::Find(std::string_view text, InternedString& string)
+{
+	if(text.empty())
+	{
+		string = InternedString();
+		return true;
+	}
+	Table::Shard& shard = Table::Instance().shards[std::hash<std::string_view>()(text) % Table::shardCount];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	std::unordered_map<std::string_view, std::unique_ptr<Entry>>::const_iterator entry = shard.entries.find(text);
+	if(entry == shard.entries.end())
+		return false;
+	InternedString found;
+	entry->second->references.fetch_add(1, std::memory_order_relaxed);
+	found._entry = entry->second.get();
+	string = std::move(found);
+	return true;
+}
+
+const std::string& InternedString::emptyString()
+{
+	static const std::string empty;
+	return empty;
+}
+
+void InternedString::releaseLast(Entry* entry)
+{
+	Table::Shard& shard = Table::Instance().shards[entry->shard];
+	std::lock_guard<std::mutex> lock(shard.mutex);
+	// The string may have been interned again since the reference count was read
+	if(entry->references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		shard.entries.erase(std::string_view(entry->text));
+}
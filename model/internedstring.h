@@ -0,0 +1,120 @@
+#ifndef INTERNED_STRING_H
+#define INTERNED_STRING_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+
+/**
+ * A handle to an immutable string in a process-wide string table, in which
+ * equal strings are stored once. Source and cluster names are interned, so
+ * that the name of a cluster with many sources, or of a source that is
+ * copied, is not stored repeatedly. Since equal strings have the same
+ * handle, handles are compared and hashed by address.
+ *
+ * A string is removed from the table when its last handle is destroyed.
+ * Handles can be created, copied and destroyed concurrently. The empty
+ * string is not stored in the table.
+ */
+class InternedString
+{
+	public:
+		struct Hash
+		{
+			size_t operator()(const InternedString& string) const { return std::hash<const void*>()(string._entry); }
+		};
+
+		InternedString() : _entry(nullptr)
+		{ }
+
+		explicit InternedString(std::string_view text);
+
+		InternedString(const InternedString& source) : _entry(source._entry)
+		{
+			if(_entry)
+				_entry->references.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		InternedString(InternedString&& source) noexcept : _entry(source._entry)
+		{
+			source._entry = nullptr;
+		}
+
+		~InternedString() { release(); }
+
+		InternedString& operator=(const InternedString& source)
+		{
+			if(source._entry)
+				source._entry->references.fetch_add(1, std::memory_order_relaxed);
+			release();
+			_entry = source._entry;
+			return *this;
+		}
+
+		InternedString& operator=(InternedString&& source) noexcept
+		{
+			if(this != &source)
+			{
+				release();
+				_entry = source._entry;
+				source._entry = nullptr;
+			}
+			return *this;
+		}
+
+		const std::string& Str() const { return _entry ? _entry->text : emptyString(); }
+
+		bool Empty() const { return _entry == nullptr; }
+
+		bool operator==(const InternedString& rhs) const { return _entry == rhs._entry; }
+		bool operator!=(const InternedString& rhs) const { return _entry != rhs._entry; }
+
+		/**
+		 * Looks up a string without adding it to the table. Returns false when
+		 * it is not in the table, i.e. when no handle to it exists.
+		 */
+		static bool Find(std::string_view text, InternedString& string);
+
+	private:
+		struct Entry
+		{
+			std::atomic<size_t> references;
+			size_t shard;
+			std::string text;
+		};
+		class Table;
+
+		static const std::string& emptyString();
+
+		void release()
+		{
+			if(_entry)
+			{
+				// Only the last reference is released under the lock of the table,
+				// so that the string can not be found while it is removed
+				size_t references = _entry->references.load(std::memory_order_relaxed);
+				while(references > 1)
+				{
+					if(_entry->references.compare_exchange_weak(references, references - 1, std::memory_order_acq_rel))
+					{
+						_entry = nullptr;
+						return;
+					}
+				}
+				releaseLast(_entry);
+				_entry = nullptr;
+			}
+		}
+
+		/**
+		 * Releases a reference under the lock of the table, and removes the
+		 * entry when it was the last one.
+		 */
+		static void releaseLast(Entry* entry);
+
+		Entry* _entry;
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include "lazysed.h"
+
+#include "modelparser.h"
+
+const SpectralEnergyDistribution& LazySED::Get() const
+{
+	std::call_once(_parsed, [this]() {
+		_sed = ModelParser::ParseSED(_begin, _end, _fileVersion1_0);
+	});
+	return *_sed;
+}
@@ -0,0 +1,43 @@
+#ifndef LAZY_SED_H
+#define LAZY_SED_H
+
+#include "spectralenergydistribution.h"
+
+#include <memory>
+#include <mutex>
+
+class MappedFile;
+
+/**
+ * The unparsed text of the SED of a component, i.e. its 'measurement' and
+ * 'sed' blocks, in a memory-mapped model file. The SED is parsed the first
+ * time it is requested; this is thread safe. The mapping is kept alive for
+ * as long as the SED may still be parsed.
+ */
+class LazySED
+{
+	public:
+		LazySED(std::shared_ptr<const MappedFile> file, const char* begin, const char* end, bool fileVersion1_0) :
+			_file(std::move(file)), _begin(begin), _end(end), _fileVersion1_0(fileVersion1_0)
+		{ }
+
+		LazySED(const LazySED&) = delete;
+		LazySED& operator=(const LazySED&) = delete;
+
+		/**
+		 * Parses the SED when this is the first call, and returns it. Syntax
+		 * errors in the SED are reported here instead of while reading the
+		 * model.
+		 */
+		const SpectralEnergyDistribution& Get() const;
+
+	private:
+		std::shared_ptr<const MappedFile> _file;
+		const char* _begin;
+		const char* _end;
+		bool _fileVersion1_0;
+		mutable std::once_flag _parsed;
+		mutable std::unique_ptr<SpectralEnergyDistribution> _sed;
+};
+
+#endif
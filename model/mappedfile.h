@@ -0,0 +1,67 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * Read-only memory mapping of a complete file. The pages are only read
+ * from disk when they are accessed, and the kernel is advised that the
+ * file will be read sequentially. An empty file has no mapping and a null
+ * Data().
+ */
+class MappedFile
+{
+	public:
+		explicit MappedFile(const std::string& filename) : _data(nullptr), _size(0)
+		{
+			const int fd = open(filename.c_str(), O_RDONLY);
+			if(fd < 0)
+				throw std::runtime_error("Could not open " + filename + ": " + strerror(errno));
+			struct stat fileStat;
+			if(fstat(fd, &fileStat) != 0)
+			{
+				close(fd);
+				throw std::runtime_error("Could not read size of " + filename + ": " + strerror(errno));
+			}
+			_size = fileStat.st_size;
+			if(_size != 0)
+			{
+				void* mapping = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+				if(mapping == MAP_FAILED)
+				{
+					const int error = errno;
+					close(fd);
+					throw std::runtime_error("Could not map " + filename + ": " + strerror(error));
+				}
+				madvise(mapping, _size, MADV_SEQUENTIAL);
+				_data = static_cast<const char*>(mapping);
+			}
+			close(fd);
+		}
+
+		~MappedFile()
+		{
+			if(_data)
+				munmap(const_cast<char*>(_data), _size);
+		}
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		const char* Data() const { return _data; }
+		size_t Size() const { return _size; }
+
+	private:
+		const char* _data;
+		size_t _size;
+};
+
+#endif
@@ -113,6 +113,13 @@ class Measurement
 		
 		void SetBandWidthHz(double bandwidthHz) { _bandWidthHz = bandwidthHz; }
 		
+		double BandWidthHz() const { return _bandWidthHz; }
+		
+		long double FluxDensityStddevFromIndex(size_t polarizationIndex) const
+		{
+			return _fluxDensityStddevs[polarizationIndex];
+		}
+		
 		void ToStream(std::ostream &s) const
 		{
 			s <<
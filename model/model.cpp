@@ -1,6 +1,9 @@
 #include "model.h"
 
+#include "binarymodel.h"
+#include "mappedfile.h"
 #include "modelparser.h"
+#include "modelview.h"
 
 #include "../units/radeccoord.h"
 
@@ -9,16 +12,51 @@
 #include <string>
 #include <fstream>
 #include <stdexcept>
+#include <thread>
 
 size_t Model::npos = std::numeric_limits<size_t>::max();
 
-void Model::read(const char* filename)
+void Model::read(const char* filename, bool useBinaryCache)
 {
-	ModelParser parser;
-	std::ifstream stream(filename);
-	if(!stream.good())
-		throw std::runtime_error(std::string("Could not open model ") + filename);
-	parser.Parse(*this, stream);
+	// The stamp is read before the text, so that a cache is never newer than its text
+	BinaryModel::TextStamp stamp;
+	useBinaryCache = useBinaryCache && BinaryModel::ReadTextStamp(filename, stamp);
+	const MappedFile file(filename);
+	if(BinaryModel::IsBinaryModel(file.Data(), file.Size()))
+	{
+		BinaryModel::Read(*this, file.Data(), file.Size(), filename);
+		return;
+	}
+	if(useBinaryCache && BinaryModel::ReadCache(*this, filename, stamp))
+		return;
+	ModelParser parser(std::thread::hardware_concurrency());
+	parser.Parse(*this, file.Data(), file.Size());
+	if(useBinaryCache)
+	{
+		// The cache only speeds up later runs, so e.g. a read-only directory is not an error
+		try {
+			BinaryModel::WriteCache(*this, filename, stamp);
+		} catch(std::exception& e) {
+			std::cerr << "Warning: " << e.what() << '\n';
+		}
+	}
+}
+
+Model Model::ReadIndex(const std::string& filename)
+{
+	Model model;
+	{
+		const MappedFile file(filename);
+		if(BinaryModel::IsBinaryModel(file.Data(), file.Size()))
+		{
+			BinaryModel::Read(model, file.Data(), file.Size(), filename);
+			return model;
+		}
+	}
+	ModelParser parser(std::thread::hardware_concurrency());
+	parser.SetLazySEDs(true);
+	parser.Parse(model, filename);
+	return model;
 }
 
 void Model::operator+=(const Model& rhs)
@@ -35,10 +73,36 @@ void Model::operator+=(const Model& rhs)
 
 void Model::Optimize()
 {
-	Model copy(*this);
+	// The sources are moved out and back, instead of copying the model
+	std::vector<ModelSource> sources(std::move(_sources));
 	_sources.clear();
-	for(const_iterator i = copy.begin(); i!=copy.end(); ++i)
-		addOptimized(*i);
+	_sources.reserve(sources.size());
+	invalidateIndex();
+	// The index is extended while adding, so that duplicates are found in constant time
+	_isIndexed = true;
+	for(ModelSource& source : sources)
+		addOptimized(std::move(source));
+}
+
+ModelView Model::GetSourcesInCluster(const std::string& clusterName) const
+{
+	return ModelView(*this).Cluster(clusterName);
+}
+
+const SkyIndex& Model::exactIndex() const
+{
+	if(!_isIndexed)
+	{
+		_index.Clear();
+		_index.Reserve(_sources.size());
+		for(size_t i=0; i!=_sources.size(); ++i)
+		{
+			if(_sources[i].ComponentCount()!=0)
+				_index.Add(_sources[i].Peak().PosRA(), _sources[i].Peak().PosDec(), i);
+		}
+		_isIndexed = true;
+	}
+	return _index;
 }
 
 void Model::add(const ModelSource& source)
@@ -55,42 +119,41 @@ void Model::add(const ModelSource& source)
 			}
 		}
 	}*/
-	_sources.push_back(source);
+	AddSource(source);
 }
 
-void Model::addOptimized(const ModelSource& source)
+void Model::addOptimized(ModelSource&& source)
 {
-	if(source.ComponentCount()!=0)
+	if(source.ComponentCount()!=0 && FindSourceAt(source.Peak().PosRA(), source.Peak().PosDec()) != npos)
 	{
-		for(iterator i = begin(); i!=end(); ++i)
-		{
-			if(i->ComponentCount()!=0 && source.Peak().PosDec() == i->Peak().PosDec() && source.Peak().PosRA() == i->Peak().PosRA())
-			{
-				/* merge */
-				return;
-			}
-		}
+		/* merge */
+		return;
 	}
-	_sources.push_back(source);
+	AddSource(std::move(source));
 }
 
 void Model::combineMeasurements(const ModelSource& source)
 {
-	for(iterator i = begin(); i!=end(); ++i)
+	// Combining measurements does not move components, so the index stays valid
+	const size_t index = FindSourceAt(source.Peak().PosRA(), source.Peak().PosDec());
+	if(index != npos)
 	{
-		if(source.Peak().PosDec() == i->Peak().PosDec() && source.Peak().PosRA() == i->Peak().PosRA())
-		{
-			i->CombineMeasurements(source);
-			return;
-		}
+		_sources[index].CombineMeasurements(source);
+		return;
 	}
 	throw std::runtime_error("Combining measurements while not same sources were measured!");
 }
 
-void Model::Save(const char* filename) const
+void Model::Save(const char* filename, bool binary) const
 {
-	std::ofstream stream(filename);
-	Save(stream);
+	if(binary)
+	{
+		BinaryModel::Write(*this, filename);
+	}
+	else {
+		std::ofstream stream(filename);
+		Save(stream);
+	}
 }
 
 void Model::Save(std::ostream& stream) const
@@ -2,9 +2,14 @@
 #define MODEL_H
 
 #include <algorithm>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 #include "modelsource.h"
+#include "skyindex.h"
+
+class ModelView;
 
 class Model
 {
@@ -12,14 +17,30 @@ class Model
 		typedef std::vector<ModelSource>::iterator iterator;
 		typedef std::vector<ModelSource>::const_iterator const_iterator;
 		
-		Model()
+		Model() : _isIndexed(false), _areNamesIndexed(false)
 		{ }
 
 		Model(const Model&) = default;
 		Model(Model&&) = default;
 		
-		explicit Model(const char *filename) { read(filename); }
-		explicit Model(const std::string& filename) { read(filename.c_str()); }
+		/**
+		 * Reads a text or binary model. For a text model, a binary cache is
+		 * kept next to it when useBinaryCache is true: it is read instead of the
+		 * text model when it is up to date, and (re)written otherwise. See
+		 * BinaryModel.
+		 */
+		explicit Model(const char *filename, bool useBinaryCache = true) : _isIndexed(false), _areNamesIndexed(false) { read(filename, useBinaryCache); }
+		explicit Model(const std::string& filename, bool useBinaryCache = true) : _isIndexed(false), _areNamesIndexed(false) { read(filename.c_str(), useBinaryCache); }
+		
+		/**
+		 * Reads the sources, clusters, positions and shapes of a text model,
+		 * but leaves the SEDs of the components unparsed until they are
+		 * accessed (see LazySED). This makes loading a large model fast when
+		 * only a few of its sources are used. Errors in an SED are only reported
+		 * when it is accessed. The model file is kept mapped while the model
+		 * refers to it. A binary model is read completely.
+		 */
+		static Model ReadIndex(const std::string& filename);
 		
 		Model& operator=(const Model&) = default;
 		Model& operator=(Model&&) = default;
@@ -32,32 +53,111 @@ class Model
 		
 		bool Empty() const { return _sources.size() == 0; }
 		
-		ModelSource &Source(size_t index) { return _sources[index]; }
+		ModelSource &Source(size_t index) { invalidateIndex(); return _sources[index]; }
 		const ModelSource &Source(size_t index) const { return _sources[index]; }
 		
 		const_iterator begin() const { return _sources.begin(); }
 		const_iterator end() const { return _sources.end(); }
 		
-		iterator begin() { return _sources.begin(); }
-		iterator end() { return _sources.end(); }
+		iterator begin() { invalidateIndex(); return _sources.begin(); }
+		iterator end() { invalidateIndex(); return _sources.end(); }
 		
 		static size_t npos;
 		
 		void Optimize();
 		
-		void AddSource(const ModelSource& source) { _sources.push_back(source); }
+		void AddSource(const ModelSource& source) { _sources.push_back(source); addToIndex(_sources.size() - 1); }
+		
+		void AddSource(ModelSource&& source) { _sources.push_back(std::move(source)); addToIndex(_sources.size() - 1); }
+		
+		void ReserveSources(size_t count) { _sources.reserve(count); }
 		
 		/**
-		 * Returns the index of the source with the given name, or npos if not found.
+		 * Returns the index of the first source with the given name, or npos if
+		 * not found. Takes constant time, see BuildIndices().
 		 */
-		size_t FindSourceIndex(const std::string& sourceName) const
+		size_t FindSourceIndex(std::string_view sourceName) const
 		{
-			for(const_iterator i=begin(); i!=end(); ++i)
-			{
-				if(i->Name() == sourceName)
-					return i - begin();
-			}
-			return npos;
+			InternedString name;
+			if(!InternedString::Find(sourceName, name))
+				return npos;
+			const std::unordered_map<InternedString, size_t, InternedString::Hash>& indices = nameIndices();
+			std::unordered_map<InternedString, size_t, InternedString::Hash>::const_iterator index = indices.find(name);
+			return index == indices.end() ? npos : index->second;
+		}
+		
+		/**
+		 * Returns the indices of the sources in the given cluster, in model
+		 * order. Takes constant time, see BuildIndices().
+		 */
+		const std::vector<size_t>& ClusterMembers(std::string_view clusterName) const
+		{
+			static const std::vector<size_t> noMembers;
+			InternedString name;
+			if(!InternedString::Find(clusterName, name))
+				return noMembers;
+			nameIndices();
+			std::unordered_map<InternedString, std::vector<size_t>, InternedString::Hash>::const_iterator members = _clusterMembers.find(name);
+			return members == _clusterMembers.end() ? noMembers : members->second;
+		}
+		
+		/**
+		 * The spatial index and the name and cluster indices are built when they
+		 * are first used after the sources were modified through a non-const
+		 * accessor. Calling this function builds them, after which the lookups
+		 * can be used from several threads.
+		 */
+		void BuildIndices() const
+		{
+			Index();
+			nameIndices();
+		}
+		
+		/**
+		 * The spatial index of the sources, with the index of the source as
+		 * value. The direction of a source is that of its peak (first)
+		 * component, and sources without components are not indexed. The index
+		 * is built when it is first used after the sources were modified
+		 * through a non-const accessor; this first use is not thread safe, the
+		 * use of the returned index is.
+		 */
+		const SkyIndex& Index() const
+		{
+			const SkyIndex& index = exactIndex();
+			if(!index.IsBuilt())
+				_index.Build();
+			return index;
+		}
+		
+		/**
+		 * Returns the index of the source at the given position, or npos if
+		 * there is none. With a zero tolerance, the position must be equal; the
+		 * first such source is returned. Otherwise, the nearest source within
+		 * the tolerance (in radians) is returned.
+		 */
+		size_t FindSourceAt(long double ra, long double dec, double tolerance = 0.0) const
+		{
+			const size_t index = (tolerance == 0.0) ?
+				exactIndex().FindExact(ra, dec) : Index().FindNearest(ra, dec, tolerance);
+			return index == SkyIndex::npos ? npos : index;
+		}
+		
+		/**
+		 * Returns the indices of the sources at most radius (in radians) from
+		 * the given direction, nearest first.
+		 */
+		std::vector<size_t> ConeSearch(long double ra, long double dec, double radius) const
+		{
+			return Index().ConeSearch(ra, dec, radius);
+		}
+		
+		/**
+		 * Returns the indices of the count sources nearest to the given
+		 * direction, nearest first.
+		 */
+		std::vector<size_t> FindNearestSources(long double ra, long double dec, size_t count) const
+		{
+			return Index().NearestNeighbours(ra, dec, count);
 		}
 		
 		void AddCluster(const ModelCluster& cluster) {
@@ -94,33 +194,38 @@ class Model
 			return c->second;
 		}
 		
+		/**
+		 * Adds the sources in the cluster to the group, which refers to them:
+		 * the group is invalid after sources are added to, removed from or
+		 * sorted in the model. Use the ModelView overload below for a subset
+		 * that survives adding sources.
+		 */
 		void GetSourcesInCluster(const std::string& clusterName, SourceGroup &destGroup) const
 		{
-			for(const_iterator s=begin(); s!=end(); ++s)
-			{
-				if(s->ClusterName() == clusterName)
-					destGroup.AddSource(*s);
-			}
+			for(size_t index : ClusterMembers(clusterName))
+				destGroup.AddSource(_sources[index]);
 		}
 		
-		void GetClusterNames(std::vector<std::string>& clusterNames) {
+		/** Returns a view of the sources in the cluster, see modelview.h. */
+		ModelView GetSourcesInCluster(const std::string& clusterName) const;
+		
+		/** The names of the clusters of the sources, in order of first appearance. */
+		void GetClusterNames(std::vector<std::string>& clusterNames) const {
+			nameIndices();
 			clusterNames.clear();
-			clusterNames.reserve(_clusters.size());
-			std::set<std::string> clusterWasAdded;
-			for(const_iterator s=begin(); s!=end(); ++s)
-			{
-				if(clusterWasAdded.count(s->ClusterName()) == 0)
-				{
-					clusterNames.push_back(s->ClusterName());
-					clusterWasAdded.insert(s->ClusterName());
-				}
-			}
+			clusterNames.reserve(_clusterOrder.size());
+			for(const InternedString& name : _clusterOrder)
+				clusterNames.push_back(name.Str());
 		}
 		
-		void RemoveSource(size_t index) { _sources.erase(_sources.begin() + index); }
+		void RemoveSource(size_t index) { invalidateIndex(); _sources.erase(_sources.begin() + index); }
 		
-		void Save(const std::string& filename) const { Save(filename.c_str()); }
-		void Save(const char* filename) const;
+		/**
+		 * Writes the model in the text format, or in the binary format of
+		 * BinaryModel when binary is true.
+		 */
+		void Save(const std::string& filename, bool binary = false) const { Save(filename.c_str(), binary); }
+		void Save(const char* filename, bool binary = false) const;
 		void Save(std::ostream& stream) const;
 		
 		double TotalFlux(double frequencyStartHz, double frequencyEndHz, aocommon::PolarizationEnum polarization) const
@@ -178,22 +283,85 @@ class Model
 		}
 		
 		void Sort() {
+			invalidateIndex();
 			std::sort(_sources.rbegin(), _sources.rend());
 		}
 		
 		template<class Compare>
 		void Sort(Compare comp) {
+			invalidateIndex();
 			std::sort(_sources.rbegin(), _sources.rend(), comp);
 		}
 	private:
-		void read(const char* filename);
+		void read(const char* filename, bool useBinaryCache);
 		std::vector<ModelSource> _sources;
 		std::map<std::string, ModelCluster> _clusters;
+		/** Holds the peaks of all sources when _isIndexed is set; see Index(). */
+		mutable SkyIndex _index;
+		mutable bool _isIndexed;
+		/** The indices of the names and clusters, valid when _areNamesIndexed is set. */
+		mutable std::unordered_map<InternedString, size_t, InternedString::Hash> _nameIndices;
+		mutable std::unordered_map<InternedString, std::vector<size_t>, InternedString::Hash> _clusterMembers;
+		mutable std::vector<InternedString> _clusterOrder;
+		mutable bool _areNamesIndexed;
+		
+		void invalidateIndex()
+		{
+			if(_isIndexed)
+			{
+				_index.Clear();
+				_isIndexed = false;
+			}
+			if(_areNamesIndexed)
+			{
+				_nameIndices.clear();
+				_clusterMembers.clear();
+				_clusterOrder.clear();
+				_areNamesIndexed = false;
+			}
+		}
+		
+		void addToIndex(size_t sourceIndex)
+		{
+			const ModelSource& source = _sources[sourceIndex];
+			if(_isIndexed && source.ComponentCount()!=0)
+				_index.Add(source.Peak().PosRA(), source.Peak().PosDec(), sourceIndex);
+			if(_areNamesIndexed)
+				addToNameIndices(sourceIndex);
+		}
+		
+		void addToNameIndices(size_t sourceIndex) const
+		{
+			const ModelSource& source = _sources[sourceIndex];
+			_nameIndices.emplace(source.InternedName(), sourceIndex);
+			std::vector<size_t>& members = _clusterMembers[source.InternedClusterName()];
+			if(members.empty())
+				_clusterOrder.push_back(source.InternedClusterName());
+			members.push_back(sourceIndex);
+		}
+		
+		const std::unordered_map<InternedString, size_t, InternedString::Hash>& nameIndices() const
+		{
+			if(!_areNamesIndexed)
+			{
+				_nameIndices.reserve(_sources.size());
+				for(size_t i=0; i!=_sources.size(); ++i)
+					addToNameIndices(i);
+				_areNamesIndexed = true;
+			}
+			return _nameIndices;
+		}
+		
+		/**
+		 * The index with all sources, of which only the exact lookups are
+		 * guaranteed to be fast, because the kd-tree may not be up to date.
+		 */
+		const SkyIndex& exactIndex() const;
 		
 		static bool isCommentSymbol(char c) { return c=='#'; }
 		static bool isDelimiter(char c) { return c==' ' || c=='\t' || c=='\r' || c=='\n';	}
 		void add(const ModelSource& source);
-		void addOptimized(const ModelSource& source);
+		void addOptimized(ModelSource&& source);
 		void combineMeasurements(const ModelSource& source);
 };
 
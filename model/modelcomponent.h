@@ -2,6 +2,7 @@
 #define MODEL_COMPONENT_H
 
 #include "spectralenergydistribution.h"
+#include "lazysed.h"
 #include "measuredsed.h"
 #include "powerlawsed.h"
 
@@ -22,12 +23,17 @@ class ModelComponent
 		 _type(source._type),
 		 _posRA(source._posRA), _posDec(source._posDec),
 		 _sed((source._sed == 0) ? 0 : source._sed->Clone()),
+		 _lazySED(source._lazySED),
 		 _l(source._l), _m(source._m),
 		 _positionAngle(source._positionAngle), _majorAxis(source._majorAxis), _minorAxis(source._minorAxis),
 			_userdata(source._userdata)
 		{
 		}
 		
+		ModelComponent(ModelComponent&& source) = default;
+		
+		ModelComponent& operator=(ModelComponent&& source) = default;
+		
 		ModelComponent& operator=(const ModelComponent& source)
 		{
 			_type=source._type;
@@ -36,6 +42,7 @@ class ModelComponent
 				_sed.reset();
 			else
 				_sed.reset(source._sed->Clone());
+			_lazySED = source._lazySED;
 			_l=source._l; _m=source._m;
 			_positionAngle=source._positionAngle; _majorAxis=source._majorAxis; _minorAxis=source._minorAxis;
 			_userdata=source._userdata;
@@ -45,13 +52,15 @@ class ModelComponent
 		enum Type Type() const { return _type; }
 		long double PosRA() const { return _posRA; }
 		long double PosDec() const { return _posDec; }
-		bool HasSED() const { return _sed != nullptr; }
-		SpectralEnergyDistribution &SED() { return *_sed; }
-		const SpectralEnergyDistribution &SED() const { return *_sed; }
-		bool HasMeasuredSED() const { return dynamic_cast<MeasuredSED*>(_sed.get())!=nullptr; }
-		bool HasPowerLawSED() const { return dynamic_cast<PowerLawSED*>(_sed.get())!=nullptr; }
-		MeasuredSED& MSED() { return static_cast<MeasuredSED&>(*_sed); }
-		const MeasuredSED& MSED() const { return static_cast<const MeasuredSED&>(*_sed); }
+		bool HasSED() const { return _sed != nullptr || _lazySED != nullptr; }
+		SpectralEnergyDistribution &SED() { resolveSED(); return *_sed; }
+		const SpectralEnergyDistribution &SED() const { return *sed(); }
+		bool HasMeasuredSED() const { return dynamic_cast<const MeasuredSED*>(sed())!=nullptr; }
+		bool HasPowerLawSED() const { return dynamic_cast<const PowerLawSED*>(sed())!=nullptr; }
+		MeasuredSED& MSED() { resolveSED(); return static_cast<MeasuredSED&>(*_sed); }
+		const MeasuredSED& MSED() const { return static_cast<const MeasuredSED&>(*sed()); }
+		/** Whether the SED is not parsed yet, see Model::ReadIndex(). */
+		bool HasUnparsedSED() const { return _lazySED != nullptr; }
 		long double L() const { return _l; }
 		long double M() const { return _m; }
 		/** PA in radians. */
@@ -68,6 +77,19 @@ class ModelComponent
 		void SetPosDec(long double posDec) { _posDec = posDec; }
 		void SetSED(const SpectralEnergyDistribution& sed) {
 			_sed.reset(sed.Clone());
+			_lazySED.reset();
+		}
+		void SetSED(std::unique_ptr<SpectralEnergyDistribution> sed) {
+			_sed = std::move(sed);
+			_lazySED.reset();
+		}
+		/**
+		 * Sets an SED that is parsed on first access. Copies of the component
+		 * share the parsed SED until they are modified.
+		 */
+		void SetSED(std::shared_ptr<const LazySED> sed) {
+			_sed.reset();
+			_lazySED = std::move(sed);
 		}
 		void SetL(long double l) { _l = l; }
 		void SetM(long double m) { _m = m; }
@@ -96,8 +118,8 @@ class ModelComponent
 				s << "\n    position "
 					<< RaDecCoord::RAToString(_posRA) << ' '
 					<< RaDecCoord::DecToString(_posDec) << '\n';
-			if(_sed)
-				s << _sed->ToString();
+			if(HasSED())
+				s << sed()->ToString();
 			s << "  }\n";
 			return s.str();
 		}
@@ -106,17 +128,38 @@ class ModelComponent
 		
 		bool operator<(const ModelComponent& rhs) const
 		{
-			return (*_sed) < (*rhs._sed);
+			return SED() < rhs.SED();
 		}
 		
 		void operator*=(double factor)
 		{
-			(*_sed) *= factor;
+			SED() *= factor;
 		}
 	private:
+		const SpectralEnergyDistribution* sed() const
+		{
+			if(_sed)
+				return _sed.get();
+			else if(_lazySED)
+				return &_lazySED->Get();
+			else
+				return nullptr;
+		}
+		
+		/** Replaces a lazy SED by a copy that this component owns, before it is modified. */
+		void resolveSED()
+		{
+			if(!_sed && _lazySED)
+			{
+				_sed.reset(_lazySED->Get().Clone());
+				_lazySED.reset();
+			}
+		}
+		
 		enum Type _type;
 		long double _posRA, _posDec;
 		std::unique_ptr<SpectralEnergyDistribution> _sed;
+		std::shared_ptr<const LazySED> _lazySED;
 		long double _l, _m;
 		long double _positionAngle, _majorAxis, _minorAxis;
 		void *_userdata;
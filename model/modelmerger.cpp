@@ -0,0 +1,240 @@
+#include "modelmerger.h"
+
+#include "model.h"
+#include "modelreader.h"
+#include "modelsource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+ModelMerger::ModelMerger(double tolerance, CollisionPolicy policy) :
+	_tolerance(tolerance),
+	_policy(policy)
+{
+	if(tolerance < 0.0)
+		throw std::runtime_error("The tolerance for merging models can not be negative");
+	const double chord = 2.0 * std::sin(0.5 * std::min(tolerance, M_PI));
+	_chordSquared = chord * chord;
+	// Cells may be larger than the tolerance, which only makes lookups slower
+	_cellSize = std::max(chord, minimumCellSize);
+}
+
+void ModelMerger::AddFile(const std::string& filename)
+{
+	ModelReader reader(filename);
+	std::vector<ModelSource> batch;
+	while(reader.Read(batch, 1000))
+	{
+		for(const ModelSource& source : batch)
+			AddSource(source);
+	}
+}
+
+void ModelMerger::Add(const ModelView& sources)
+{
+	for(const ModelSource& source : sources)
+		AddSource(source);
+}
+
+void ModelMerger::AddSource(const ModelSource& source)
+{
+	size_t sourceIndex = SkyIndex::npos;
+	std::vector<const ModelComponent*> newComponents;
+	for(const ModelComponent& component : source)
+	{
+		if(!component.HasMeasuredSED())
+			throw std::runtime_error("Can not merge source '" + source.Name() + "': its components need measured SEDs");
+		const size_t match = findComponent(component);
+		if(match == SkyIndex::npos)
+			newComponents.push_back(&component);
+		else {
+			const MeasuredSED& sed = component.MSED();
+			MergedComponent& merged = _components[match];
+			for(MeasuredSED::const_iterator m=sed.begin(); m!=sed.end(); ++m)
+				merged.measurements.push_back(m->second);
+			if(sourceIndex == SkyIndex::npos)
+				sourceIndex = merged.source;
+		}
+	}
+	if(!newComponents.empty())
+	{
+		if(sourceIndex == SkyIndex::npos)
+		{
+			sourceIndex = _sources.size();
+			_sources.emplace_back();
+			_sources.back().name = source.Name();
+			_sources.back().clusterName = source.ClusterName();
+		}
+		for(const ModelComponent* component : newComponents)
+			addComponent(*component, sourceIndex);
+	}
+}
+
+Model ModelMerger::Finish()
+{
+	// Collisions are rejected before any state is moved out, so that the merger is unchanged when Finish() throws
+	for(MergedComponent& component : _components)
+	{
+		sortMeasurements(component.measurements);
+		if(_policy == RejectCollisions)
+			rejectCollisions(component.measurements);
+	}
+	Model model;
+	model.ReserveSources(_sources.size());
+	for(const MergedSource& merged : _sources)
+	{
+		ModelSource source;
+		source.SetName(merged.name);
+		source.SetClusterName(merged.clusterName);
+		for(size_t index : merged.components)
+		{
+			MergedComponent& component = _components[index];
+			component.component.SetSED(combine(component.measurements));
+			source.AddComponent(std::move(component.component));
+		}
+		model.FindOrAddCluster(merged.clusterName);
+		model.AddSource(std::move(source));
+	}
+	_components.clear();
+	_sources.clear();
+	_cells.clear();
+	_exactPositions.Clear();
+	return model;
+}
+
+size_t ModelMerger::findComponent(const ModelComponent& component) const
+{
+	if(_tolerance == 0.0)
+		return _exactPositions.FindExact(component.PosRA(), component.PosDec());
+	
+	double xyz[3];
+	unitVector(component, xyz);
+	const Cell centre = cell(xyz);
+	size_t nearest = SkyIndex::npos;
+	double nearestDistance = _chordSquared;
+	// A match within the tolerance is at most one cell away in every axis
+	for(int64_t dx=-1; dx<=1; ++dx)
+	{
+		for(int64_t dy=-1; dy<=1; ++dy)
+		{
+			for(int64_t dz=-1; dz<=1; ++dz)
+			{
+				std::unordered_map<Cell, std::vector<size_t>, CellHash>::const_iterator c =
+					_cells.find(Cell{centre.x+dx, centre.y+dy, centre.z+dz});
+				if(c == _cells.end())
+					continue;
+				for(size_t index : c->second)
+				{
+					const double* candidate = _components[index].xyz;
+					const double
+						ex = candidate[0] - xyz[0],
+						ey = candidate[1] - xyz[1],
+						ez = candidate[2] - xyz[2],
+						distance = ex*ex + ey*ey + ez*ez;
+					// Of components at the same distance, the first that was added is used
+					if(distance < nearestDistance || (distance == nearestDistance && index < nearest))
+					{
+						nearest = index;
+						nearestDistance = distance;
+					}
+				}
+			}
+		}
+	}
+	return nearest;
+}
+
+void ModelMerger::addComponent(const ModelComponent& component, size_t sourceIndex)
+{
+	const size_t index = _components.size();
+	_components.emplace_back();
+	MergedComponent& merged = _components.back();
+	merged.component = component;
+	merged.component.SetSED(std::unique_ptr<SpectralEnergyDistribution>());
+	merged.source = sourceIndex;
+	unitVector(component, merged.xyz);
+	const MeasuredSED& sed = component.MSED();
+	merged.measurements.reserve(sed.MeasurementCount());
+	for(MeasuredSED::const_iterator m=sed.begin(); m!=sed.end(); ++m)
+		merged.measurements.push_back(m->second);
+	_sources[sourceIndex].components.push_back(index);
+	if(_tolerance == 0.0)
+		_exactPositions.Add(component.PosRA(), component.PosDec(), index);
+	else
+		_cells[cell(merged.xyz)].push_back(index);
+}
+
+void ModelMerger::unitVector(const ModelComponent& component, double* xyz)
+{
+	const double
+		ra = component.PosRA(),
+		dec = component.PosDec(),
+		cosDec = std::cos(dec);
+	xyz[0] = cosDec * std::cos(ra);
+	xyz[1] = cosDec * std::sin(ra);
+	xyz[2] = std::sin(dec);
+}
+
+ModelMerger::Cell ModelMerger::cell(const double* xyz) const
+{
+	return Cell{
+		int64_t(std::floor(xyz[0] / _cellSize)),
+		int64_t(std::floor(xyz[1] / _cellSize)),
+		int64_t(std::floor(xyz[2] / _cellSize))
+	};
+}
+
+void ModelMerger::sortMeasurements(std::vector<Measurement>& measurements)
+{
+	// A stable sort keeps the measurements of each frequency in the order in which the models were added
+	std::stable_sort(measurements.begin(), measurements.end(),
+		[](const Measurement& a, const Measurement& b) { return a.FrequencyHz() < b.FrequencyHz(); });
+}
+
+void ModelMerger::rejectCollisions(const std::vector<Measurement>& measurements)
+{
+	for(size_t i=1; i<measurements.size(); ++i)
+	{
+		if(measurements[i].FrequencyHz() == measurements[i-1].FrequencyHz())
+			throw std::runtime_error("Merging measurements at the same frequency, " + std::to_string(double(measurements[i].FrequencyHz())*1e-6) + " MHz, of the same component");
+	}
+}
+
+MeasuredSED ModelMerger::combine(std::vector<Measurement>& measurements) const
+{
+	MeasuredSED sed;
+	std::vector<Measurement>::const_iterator first = measurements.begin();
+	while(first != measurements.end())
+	{
+		std::vector<Measurement>::const_iterator last = first + 1;
+		while(last != measurements.end() && last->FrequencyHz() == first->FrequencyHz())
+			++last;
+		const size_t count = last - first;
+		// With RejectCollisions, rejectCollisions() makes sure that count is one
+		if(count == 1 || _policy == KeepFirstMeasurement)
+			sed.AddMeasurement(*first);
+		else if(_policy == KeepLastMeasurement)
+			sed.AddMeasurement(*(last - 1));
+		else
+		{
+			Measurement average(*first);
+			for(size_t p=0; p!=4; ++p)
+			{
+				long double sum = 0.0, varianceSum = 0.0;
+				for(std::vector<Measurement>::const_iterator m=first; m!=last; ++m)
+				{
+					sum += m->FluxDensityFromIndex(p);
+					varianceSum += m->FluxDensityStddevFromIndex(p) * m->FluxDensityStddevFromIndex(p);
+				}
+				average.SetFluxDensityFromIndex(p, sum / count);
+				average.SetFluxDensityStddevFromIndex(p, std::sqrt(varianceSum) / count);
+			}
+			sed.AddMeasurement(average);
+		}
+		first = last;
+	}
+	measurements.clear();
+	measurements.shrink_to_fit();
+	return sed;
+}
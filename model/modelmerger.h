@@ -0,0 +1,141 @@
+#ifndef MODEL_MERGER_H
+#define MODEL_MERGER_H
+
+#include "measurement.h"
+#include "modelcomponent.h"
+#include "modelview.h"
+#include "skyindex.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Merges the measured SEDs of many models, e.g. of the observing runs of a
+ * survey, in a single pass. Components of the models that are within the
+ * tolerance of each other are taken to be the same component, and their
+ * measurements are collected into one measured SED. Components are found
+ * by hashing their directions, quantised to cells the size of the
+ * tolerance, so time and memory grow linearly with the total number of
+ * measurements. The measurements are only sorted and combined when the
+ * merged model is requested, at which point measurements of the same
+ * component at the same frequency are resolved by the collision policy.
+ *
+ * A component that does not match an existing component is added to the
+ * merged source of the first matching component of its source, or to a new
+ * source with the name and cluster of its source. All components must have
+ * measured SEDs.
+ */
+class ModelMerger
+{
+	public:
+		/** What to do with measurements of a component at the same frequency. */
+		enum CollisionPolicy {
+			/** Throw an exception, as Model::CombineMeasurements() does. */
+			RejectCollisions,
+			/** Keep the measurement of the model that was added first. */
+			KeepFirstMeasurement,
+			/** Keep the measurement of the model that was added last. */
+			KeepLastMeasurement,
+			/**
+			 * Average the flux densities; the standard deviations are those of the
+			 * average.
+			 */
+			AverageMeasurements
+		};
+
+		/**
+		 * With a tolerance (in radians) of zero, components only match when
+		 * their positions are equal.
+		 */
+		ModelMerger(double tolerance, CollisionPolicy policy);
+
+		/** Adds the sources of a model file, which is read in batches. */
+		void AddFile(const std::string& filename);
+
+		/** Adds the sources of a model, or of a subset of it. */
+		void Add(const ModelView& sources);
+
+		void AddSource(const ModelSource& source);
+
+		/**
+		 * Returns the merged model, and clears the merger. With RejectCollisions,
+		 * it throws when a component has several measurements at the same
+		 * frequency; the merger is then left unchanged.
+		 */
+		Model Finish();
+
+	private:
+		struct MergedComponent
+		{
+			/** The first component that was added, without its SED. */
+			ModelComponent component;
+			/** Index of the merged source that the component belongs to. */
+			size_t source;
+			/** Unit vector of the direction of the component. */
+			double xyz[3];
+			std::vector<Measurement> measurements;
+		};
+
+		struct MergedSource
+		{
+			std::string name;
+			std::string clusterName;
+			std::vector<size_t> components;
+		};
+
+		struct Cell
+		{
+			int64_t x, y, z;
+			bool operator==(const Cell& rhs) const { return x == rhs.x && y == rhs.y && z == rhs.z; }
+		};
+
+		struct CellHash
+		{
+			size_t operator()(const Cell& cell) const
+			{
+				return size_t(cell.x) * 73856093u ^ size_t(cell.y) * 19349663u ^ size_t(cell.z) * 83492791u;
+			}
+		};
+
+		/** Returns the index of the merged component that matches, or SkyIndex::npos. */
+		size_t findComponent(const ModelComponent& component) const;
+
+		void addComponent(const ModelComponent& component, size_t sourceIndex);
+
+		static void unitVector(const ModelComponent& component, double* xyz);
+
+		Cell cell(const double* xyz) const;
+
+		/** Sorts the measurements by frequency, in the order in which they were added. */
+		static void sortMeasurements(std::vector<Measurement>& measurements);
+
+		/** Throws when sorted measurements have the same frequency. */
+		static void rejectCollisions(const std::vector<Measurement>& measurements);
+
+		/** Combines the sorted measurements and resolves collisions by the policy. */
+		MeasuredSED combine(std::vector<Measurement>& measurements) const;
+
+		/**
+		 * The smallest size of a cell. A cell is normally the size of the
+		 * tolerance, but the cell coordinates of a tiny tolerance would
+		 * overflow.
+		 */
+		static constexpr double minimumCellSize = 1e-12;
+
+		double _tolerance;
+		/** Squared chord length of the tolerance, which is the size of a cell. */
+		double _chordSquared;
+		double _cellSize;
+		CollisionPolicy _policy;
+		std::vector<MergedComponent> _components;
+		std::vector<MergedSource> _sources;
+		/** With a tolerance, the merged components in every cell. */
+		std::unordered_map<Cell, std::vector<size_t>, CellHash> _cells;
+		/** Without a tolerance, the merged components by position. */
+		SkyIndex _exactPositions;
+};
+
+#endif
@@ -4,52 +4,364 @@
 #include "model.h"
 #include "modelsource.h"
 
+#include "lazysed.h"
+#include "mappedfile.h"
 #include "tokenizer.h"
 #include "powerlawsed.h"
 
-#include <cstdlib>
-#include <fstream>
+#include <aocommon/parallelfor.h>
+
+#include <algorithm>
+#include <cstring>
+#include <exception>
+#include <istream>
+#include <iterator>
+#include <memory>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
 
+/**
+ * Parses models in the text format. With more than one thread, the text is
+ * split into chunks at the starts of top-level sources, which are parsed
+ * concurrently. The sources are added to the model in the order of the
+ * file, so the result does not depend on the number of threads.
+ *
+ * With lazy SEDs, the 'measurement' and 'sed' blocks of the components are
+ * only skipped over while reading a model file; each component refers to
+ * their text, which is parsed when its SED is first accessed.
+ *
+ * A model can also be read one source at a time with Start() and
+ * ParseSource(), see ModelReader.
+ */
 class ModelParser : private Tokenizer
 {
 	public:
-		ModelParser() : _fileVersion1_0(false)
+		explicit ModelParser(size_t threadCount = 1) : _fileVersion1_0(false), _threadCount(std::max<size_t>(threadCount, 1)), _lazySEDs(false)
 		{
 		}
 		
-		void Parse(Model &model, std::ifstream &stream)
+		/** Only applies to model files, see Parse(Model&, const std::string&). */
+		void SetLazySEDs(bool lazySEDs) { _lazySEDs = lazySEDs; }
+		
+		/**
+		 * Parses a model file. The file is memory mapped, so that the tokens
+		 * can refer to it without being copied. With lazy SEDs, the mapping is
+		 * kept until the model no longer refers to it.
+		 */
+		void Parse(Model &model, const std::string& filename)
 		{
-			SetStream(stream);
-			
-			std::string line;
-			std::getline(stream, line);
-			parseVersionLine(line);
+			std::shared_ptr<const MappedFile> file = std::make_shared<const MappedFile>(filename);
+			parse(model, file->Data(), file->Size(), file);
+		}
+		
+		void Parse(Model &model, std::istream &stream)
+		{
+			const std::string text((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
 			if(stream.bad())
-					throw std::runtime_error("Error parsing model");
+				throw std::runtime_error("Error parsing model");
+			Parse(model, text.data(), text.size());
+		}
+		
+		void Parse(Model &model, const char* text, size_t size)
+		{
+			parse(model, text, size, nullptr);
+		}
+		
+		/**
+		 * Reads the header of a text, after which its sources are read with
+		 * ParseSource(). The text must outlive the parser.
+		 */
+		void Start(const char* text, size_t size)
+		{
+			SetText(text, text + size);
+			parseVersionLine(getLine());
+		}
+		
+		/**
+		 * Parses the next source of the text given to Start(). Returns false at
+		 * the end of the text.
+		 */
+		bool ParseSource(ModelSource& source)
+		{
+			std::string_view token;
+			if(!getToken(token))
+				return false;
+			if(token != "source")
+				throw std::runtime_error("Expecting source");
+			parseSource(source);
+			return true;
+		}
+		
+		/**
+		 * Splits the remaining sources of the text given to Start() into chunks
+		 * of about chunkSize bytes that start at top-level sources, using the
+		 * threads of the parser. Returns the boundaries of the chunks, from the
+		 * current position up to and including the end of the text. The chunks
+		 * can be parsed concurrently with ParseChunk().
+		 */
+		std::vector<const char*> SplitIntoChunks(size_t chunkSize)
+		{
+			const size_t size = textEnd() - position();
+			return splitIntoChunks(position(), textEnd(), std::max<size_t>(1, size / chunkSize));
+		}
+		
+		/**
+		 * Parses the sources of a chunk that was returned by SplitIntoChunks()
+		 * and appends them to the vector. Several chunks may be parsed at the
+		 * same time.
+		 */
+		void ParseChunk(const char* begin, const char* end, std::vector<ModelSource>& sources) const
+		{
+			ModelParser parser;
+			parser._fileVersion1_0 = _fileVersion1_0;
+			parser._file = _file;
+			parser.SetText(begin, end);
+			parser.parseSources(sources);
+		}
+		
+		/**
+		 * Parses the text of the SED of a component, as referred to by a
+		 * LazySED.
+		 */
+		static std::unique_ptr<SpectralEnergyDistribution> ParseSED(const char* begin, const char* end, bool fileVersion1_0)
+		{
+			ModelParser parser;
+			parser._fileVersion1_0 = fileVersion1_0;
+			parser.SetText(begin, end);
+			ModelComponent component;
+			parser.parseComponentKeys(component);
+			if(!component.HasSED())
+				throw std::runtime_error("Expecting SED");
+			return std::unique_ptr<SpectralEnergyDistribution>(component.SED().Clone());
+		}
+		
+	private:
+		/** Texts smaller than this are parsed on a single thread. */
+		static constexpr size_t minimumParallelSize = 1024*1024;
+		
+		bool _fileVersion1_0;
+		size_t _threadCount;
+		bool _lazySEDs;
+		/** The mapping of the model file that lazy SEDs refer to. */
+		std::shared_ptr<const MappedFile> _file;
+		
+		/**
+		 * Parses the text. Lazy SEDs are only used when the file that holds the
+		 * text is given.
+		 */
+		void parse(Model &model, const char* text, size_t size, std::shared_ptr<const MappedFile> file)
+		{
+			_file = _lazySEDs ? std::move(file) : nullptr;
+			const char* end = text + size;
+			SetText(text, end);
+			parseVersionLine(getLine());
+			
+			// Several chunks per thread balance the load when sources differ in size
+			const size_t partCount = (_threadCount > 1 && size >= minimumParallelSize) ? _threadCount * 4 : 1;
+			const std::vector<const char*> chunkStarts = splitIntoChunks(position(), end, partCount);
+			const size_t chunkCount = chunkStarts.size() - 1;
+			std::vector<std::vector<ModelSource>> chunkSources(chunkCount);
+			if(chunkCount == 1)
+			{
+				parseSources(chunkSources.front());
+			}
+			else {
+				std::vector<std::exception_ptr> errors(chunkCount);
+				aocommon::ParallelFor<size_t> loop(std::min(_threadCount, chunkCount));
+				loop.Run(0, chunkCount, [&](size_t chunk, size_t)
+				{
+					try {
+						ParseChunk(chunkStarts[chunk], chunkStarts[chunk+1], chunkSources[chunk]);
+					} catch(...) {
+						errors[chunk] = std::current_exception();
+					}
+				});
+				// The error that comes first in the file is reported
+				for(const std::exception_ptr& error : errors)
+				{
+					if(error)
+						std::rethrow_exception(error);
+				}
+			}
 			
-			std::string token;
+			const size_t firstNewSource = model.SourceCount();
+			size_t sourceCount = firstNewSource;
+			for(const std::vector<ModelSource>& sources : chunkSources)
+				sourceCount += sources.size();
+			model.ReserveSources(sourceCount);
+			for(std::vector<ModelSource>& sources : chunkSources)
+			{
+				for(ModelSource& source : sources)
+					model.AddSource(std::move(source));
+			}
+			for(size_t i=firstNewSource; i!=sourceCount; ++i)
+				model.FindOrAddCluster(model.Source(i).ClusterName());
+		}
+		
+		/**
+		 * The braces and strings of a part of the text, see scanChunk().
+		 */
+		struct ChunkScan
+		{
+			ChunkScan() : depthChange(0), endsInString(false), isValid(true) { }
+			/** Number of opening minus closing braces. */
+			long depthChange;
+			/** Whether the part ends inside a string that continues after it. */
+			bool endsInString;
+			/** False when the part could not be tokenized. */
+			bool isValid;
+		};
+		
+		/**
+		 * Tokenizes the text between begin and end, which starts on a new line,
+		 * to find how it changes the brace depth. When the text starts inside a
+		 * string, tokenizing starts after the closing quote. Comments end at a
+		 * newline, so a text that starts on a new line never starts in one.
+		 */
+		static ChunkScan scanChunk(const char* begin, const char* end, bool startsInString)
+		{
+			ChunkScan scan;
+			if(startsInString)
+			{
+				const char* close = static_cast<const char*>(std::memchr(begin, '\"', end - begin));
+				if(!close)
+				{
+					scan.endsInString = true;
+					return scan;
+				}
+				begin = close + 1;
+			}
+			Tokenizer tokenizer;
+			tokenizer.SetText(begin, end);
+			std::string_view token;
+			try {
+				while(tokenizer.getToken(token))
+				{
+					if(token == "{")
+						++scan.depthChange;
+					else if(token == "}")
+						--scan.depthChange;
+					else if(token.front() == '\"' && (token.size() == 1 || token.back() != '\"'))
+						scan.endsInString = true;
+				}
+			} catch(std::exception&) {
+				scan.isValid = false;
+			}
+			return scan;
+		}
+		
+		/**
+		 * Returns the start of the first source at brace depth zero in the text
+		 * between begin and end, or nullptr when there is none. The depth and
+		 * whether a string is open at begin are those found by scanChunk().
+		 */
+		static const char* findTopLevelSource(const char* begin, const char* end, bool startsInString, long depth)
+		{
+			if(startsInString)
+			{
+				const char* close = static_cast<const char*>(std::memchr(begin, '\"', end - begin));
+				if(!close)
+					return nullptr;
+				begin = close + 1;
+			}
+			Tokenizer tokenizer;
+			tokenizer.SetText(begin, end);
+			std::string_view token;
+			while(tokenizer.getToken(token))
+			{
+				if(token == "{")
+					++depth;
+				else if(token == "}")
+					--depth;
+				else if(depth == 0 && token == "source")
+					return token.data();
+			}
+			return nullptr;
+		}
+		
+		/**
+		 * Returns the boundaries of the chunks that the text between begin and
+		 * end is parsed in: the first chunk starts at begin, the others at the
+		 * start of a top-level source, and the last boundary is end. There are
+		 * at most partCount chunks.
+		 *
+		 * The text is cut into partCount equally sized parts at line starts, which are
+		 * scanned concurrently for braces and strings with scanChunk(). The
+		 * scans assume that no string is open at the start of a part; the rare
+		 * part that does start inside a string is scanned again. From the brace
+		 * depth at the start of each part, the parser then moves each boundary
+		 * forward to the next top-level source, skipping braces and the word
+		 * "source" inside strings or comments.
+		 */
+		std::vector<const char*> splitIntoChunks(const char* begin, const char* end, size_t partCount)
+		{
+			std::vector<const char*> boundaries(1, begin);
+			if(partCount > 1)
+			{
+				std::vector<const char*> partStarts(1, begin);
+				for(size_t part=1; part!=partCount; ++part)
+				{
+					const char* position = begin + part * size_t(end - begin) / partCount;
+					const char* newline = static_cast<const char*>(std::memchr(position, '\n', end - position));
+					if(newline && newline + 1 != end && newline + 1 > partStarts.back())
+						partStarts.push_back(newline + 1);
+				}
+				partStarts.push_back(end);
+				
+				std::vector<ChunkScan> scans(partStarts.size() - 1);
+				aocommon::ParallelFor<size_t> loop(std::min(_threadCount, scans.size()));
+				loop.Run(0, scans.size(), [&](size_t part, size_t)
+				{
+					scans[part] = scanChunk(partStarts[part], partStarts[part+1], false);
+				});
+				
+				std::vector<long> depths(scans.size(), 0);
+				std::vector<bool> startsInString(scans.size(), false);
+				bool isValid = scans.front().isValid;
+				for(size_t part=1; part!=scans.size() && isValid; ++part)
+				{
+					depths[part] = depths[part-1] + scans[part-1].depthChange;
+					startsInString[part] = scans[part-1].endsInString;
+					if(startsInString[part])
+						scans[part] = scanChunk(partStarts[part], partStarts[part+1], true);
+					isValid = scans[part].isValid;
+				}
+				// An invalid text is parsed in one chunk, which reports the error
+				if(isValid)
+				{
+					for(size_t part=1; part!=scans.size(); ++part)
+					{
+						const char* sourceStart = findTopLevelSource(partStarts[part], end, startsInString[part], depths[part]);
+						if(sourceStart && sourceStart > boundaries.back())
+							boundaries.push_back(sourceStart);
+					}
+				}
+			}
+			boundaries.push_back(end);
+			return boundaries;
+		}
+		
+		void parseSources(std::vector<ModelSource>& sources)
+		{
+			std::string_view token;
 			while(getToken(token))
 			{
 				if(token != "source")
 					throw std::runtime_error("Expecting source");
 				
-				ModelSource source;
-				parseSource(source);
-				model.AddSource(source);
-				model.FindOrAddCluster(source.ClusterName());
+				sources.emplace_back();
+				parseSource(sources.back());
 			}
 		}
 		
-	private:
-		bool _fileVersion1_0;
-		
-		void parseVersionLine(const std::string &line)
+		void parseVersionLine(std::string_view line)
 		{
-			const std::string headerStart = "skymodel fileformat ";
+			const std::string_view headerStart = "skymodel fileformat ";
 			if(line.substr(0, headerStart.size()) != headerStart)
 				throw std::runtime_error("The model file didn't start with a skymodel header");
-			std::string version = line.substr(headerStart.size());
+			const std::string_view version = line.substr(headerStart.size());
 			if(version == "1.0")
 			{
 				_fileVersion1_0 = true;
@@ -59,14 +371,14 @@ class ModelParser : private Tokenizer
 			}
 			else if(version != "1.1")
 			{
-				throw std::runtime_error("This model specified file version \"" + version + "\": don't know how to read.\n");
+				throw std::runtime_error("This model specified file version \"" + std::string(version) + "\": don't know how to read.\n");
 			}
 			else _fileVersion1_0 = false;
 		}
 		
 		void parseSource(ModelSource& source)
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
 			if(token != "{")
 				throw std::runtime_error("Expecting {");
@@ -77,21 +389,40 @@ class ModelParser : private Tokenizer
 				else if(token == "component") {
 					ModelComponent component;
 					parseComponent(component);
-					source.AddComponent(component);
+					source.AddComponent(std::move(component));
 				}
-				else throw std::runtime_error(std::string("Unknown token ") + token);
+				else throw std::runtime_error("Unknown token " + std::string(token));
 			}
 		}
 		
 		void parseComponent(ModelComponent &component)
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
 			if(token != "{")
 				throw std::runtime_error("Expecting {");
+			parseComponentKeys(component);
+		}
+		
+		/**
+		 * Parses the keys of a component up to the closing brace or the end of
+		 * the text.
+		 */
+		void parseComponentKeys(ModelComponent &component)
+		{
+			std::string_view token;
+			// The text from the first to the end of the last SED block, when the SEDs are lazy
+			const char* sedBegin = nullptr;
+			const char* sedEnd = nullptr;
 			while(getToken(token) && token != "}")
 			{
-				if(token == "type") {
+				if(_file && (token == "measurement" || token == "sed")) {
+					if(!sedBegin)
+						sedBegin = token.data();
+					skipBlock();
+					sedEnd = position();
+				}
+				else if(token == "type") {
 					getToken(token);
 					if(token == "point")
 						component.SetType(ModelComponent::PointSource);
@@ -128,31 +459,47 @@ class ModelParser : private Tokenizer
 						component.SetSED(plSED);
 				}
 				else if(token == "shape") {
-					getToken(token);
-					component.SetMajorAxis(atof(token.c_str()) * M_PI / 60.0/60.0/180.0);
-					getToken(token);
-					component.SetMinorAxis(atof(token.c_str()) * M_PI / 60.0/60.0/180.0);
-					getToken(token);
-					component.SetPositionAngle(atof(token.c_str()) * M_PI / 180.0);
+					component.SetMajorAxis(getTokenAsDouble() * M_PI / 60.0/60.0/180.0);
+					component.SetMinorAxis(getTokenAsDouble() * M_PI / 60.0/60.0/180.0);
+					component.SetPositionAngle(getTokenAsDouble() * M_PI / 180.0);
 				}
 				else if(token == "major-axis") {
-					getToken(token);
-					component.SetMajorAxis(atof(token.c_str()) * M_PI / 60.0/60.0/180.0);
+					component.SetMajorAxis(getTokenAsDouble() * M_PI / 60.0/60.0/180.0);
 				}
 				else if(token == "minor-axis") {
-					getToken(token);
-					component.SetMinorAxis(atof(token.c_str()) * M_PI / 60.0/60.0/180.0);
+					component.SetMinorAxis(getTokenAsDouble() * M_PI / 60.0/60.0/180.0);
 				}
 				else if(token == "position-angle") {
-					getToken(token);
-					component.SetPositionAngle(atof(token.c_str()) * M_PI/180.0);
+					component.SetPositionAngle(getTokenAsDouble() * M_PI/180.0);
 				}
 				else throw std::runtime_error("Unknown keyname in component");
 			}
+			if(sedBegin)
+				component.SetSED(std::make_shared<const LazySED>(_file, sedBegin, sedEnd, _fileVersion1_0));
+		}
+		
+		/** Skips a block in braces, including nested blocks. */
+		void skipBlock()
+		{
+			std::string_view token;
+			getToken(token);
+			if(token != "{")
+				throw std::runtime_error("Expecting {");
+			size_t depth = 1;
+			while(depth != 0)
+			{
+				if(!getToken(token))
+					throw std::runtime_error("Unterminated block");
+				if(token == "{")
+					++depth;
+				else if(token == "}")
+					--depth;
+			}
 		}
+		
 		void parseMeasurement(Measurement &measurement)
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
 			if(token != "{")
 				throw std::runtime_error("Expecting {");
@@ -198,13 +545,13 @@ class ModelParser : private Tokenizer
 				else if(token == "beam-value") {
 					// ignore
 				}
-				else throw std::runtime_error(std::string("Unknown token ") + token);
+				else throw std::runtime_error("Unknown token " + std::string(token));
 			}
 		}
 		
 		void parsePowerLawSED(PowerLawSED& sed)
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
 			if(token != "{")
 				throw std::runtime_error("Expecting {");
@@ -239,10 +586,10 @@ class ModelParser : private Tokenizer
 							throw std::runtime_error("Expecting {");
 					while(getToken(token) && token != "}")
 					{
-						terms.push_back(atof(token.c_str()));
+						terms.push_back(toDouble(token));
 					}
 				}
-				else throw std::runtime_error(std::string("Unknown token ") + token);
+				else throw std::runtime_error("Unknown token " + std::string(token));
 			}
 			if(!hasFrequency || !hasBrightness || terms.empty())
 				throw std::runtime_error("Incomplete SED specification");
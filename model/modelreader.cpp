@@ -0,0 +1,145 @@
+#include "modelreader.h"
+
+#include "bbsmodel.h"
+#include "binarymodel.h"
+#include "mappedfile.h"
+#include "model.h"
+#include "modelparser.h"
+
+#include <aocommon/parallelfor.h>
+
+#include <boost/algorithm/string/predicate.hpp>
+
+#include <algorithm>
+#include <exception>
+#include <iterator>
+#include <string_view>
+#include <thread>
+
+namespace {
+	/** Whether the text starts with the format line of a BBS model. */
+	bool isBBSModel(const char* data, size_t size)
+	{
+		const std::string_view text(data, size);
+		return text.substr(0, 3) == "# (" || boost::algorithm::istarts_with(text.substr(0, 8), "format =");
+	}
+}
+
+ModelReader::ModelReader(const std::string& filename) :
+	_file(new MappedFile(filename)),
+	_binaryModelIndex(0),
+	_nextChunk(0),
+	_parsedIndex(0)
+{
+	BinaryModel::TextStamp stamp;
+	if(BinaryModel::IsBinaryModel(_file->Data(), _file->Size()))
+	{
+		_binaryModel.reset(new Model());
+		BinaryModel::Read(*_binaryModel, _file->Data(), _file->Size(), filename);
+		_file.reset();
+	}
+	else if(isBBSModel(_file->Data(), _file->Size()))
+	{
+		_file.reset();
+		_bbsModel.reset(new BBSModel(filename));
+	}
+	else if(BinaryModel::ReadTextStamp(filename, stamp) && readCache(filename, stamp))
+	{
+		_file.reset();
+	}
+	else {
+		const size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+		_parser.reset(new ModelParser(threadCount));
+		_parser->Start(_file->Data(), _file->Size());
+		if(threadCount > 1)
+		{
+			_chunkBoundaries = _parser->SplitIntoChunks(chunkSize);
+			if(_chunkBoundaries.size() > 2)
+				_loop.reset(new aocommon::ParallelFor<size_t>(threadCount));
+			else
+				_chunkBoundaries.clear();
+		}
+	}
+}
+
+ModelReader::~ModelReader()
+{ }
+
+bool ModelReader::Read(std::vector<ModelSource>& batch, size_t maxSourceCount)
+{
+	batch.resize(maxSourceCount);
+	size_t count = 0;
+	while(count != maxSourceCount && readSource(batch[count]))
+		++count;
+	batch.resize(count);
+	return count != 0;
+}
+
+bool ModelReader::readCache(const std::string& filename, const BinaryModel::TextStamp& stamp)
+{
+	std::unique_ptr<Model> model(new Model());
+	if(!BinaryModel::ReadCache(*model, filename, stamp))
+		return false;
+	_binaryModel = std::move(model);
+	return true;
+}
+
+bool ModelReader::parseChunks()
+{
+	const size_t chunkCount = std::min(_loop->NThreads(), _chunkBoundaries.size() - 1 - _nextChunk);
+	if(chunkCount == 0)
+		return false;
+	std::vector<std::vector<ModelSource>> chunkSources(chunkCount);
+	std::vector<std::exception_ptr> errors(chunkCount);
+	_loop->Run(0, chunkCount, [&](size_t chunk, size_t)
+	{
+		try {
+			const size_t index = _nextChunk + chunk;
+			_parser->ParseChunk(_chunkBoundaries[index], _chunkBoundaries[index+1], chunkSources[chunk]);
+		} catch(...) {
+			errors[chunk] = std::current_exception();
+		}
+	});
+	_nextChunk += chunkCount;
+	// The error that comes first in the file is reported
+	for(const std::exception_ptr& error : errors)
+	{
+		if(error)
+			std::rethrow_exception(error);
+	}
+	_parsedSources.clear();
+	_parsedIndex = 0;
+	for(std::vector<ModelSource>& sources : chunkSources)
+		std::move(sources.begin(), sources.end(), std::back_inserter(_parsedSources));
+	return true;
+}
+
+bool ModelReader::readSource(ModelSource& source)
+{
+	if(!_chunkBoundaries.empty())
+	{
+		while(_parsedIndex == _parsedSources.size())
+		{
+			if(!parseChunks())
+				return false;
+		}
+		source = std::move(_parsedSources[_parsedIndex]);
+		++_parsedIndex;
+		return true;
+	}
+	else if(_parser)
+	{
+		source = ModelSource();
+		return _parser->ParseSource(source);
+	}
+	else if(_bbsModel)
+		return _bbsModel->ReadSource(source);
+	else if(_binaryModelIndex != _binaryModel->SourceCount())
+	{
+		source = std::move(_binaryModel->Source(_binaryModelIndex));
+		++_binaryModelIndex;
+		return true;
+	}
+	else
+		return false;
+}
@@ -0,0 +1,75 @@
+#ifndef MODEL_READER_H
+#define MODEL_READER_H
+
+#include "binarymodel.h"
+#include "modelsource.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+class BBSModel;
+class MappedFile;
+class Model;
+class ModelParser;
+
+namespace aocommon {
+	template<typename Iter> class ParallelFor;
+}
+
+/**
+ * Reads the sources of a model file in batches, so that a large model can
+ * be processed while it is read, without holding all its sources in
+ * memory. Text models in the ao format are parsed from a memory mapping:
+ * the text is split into chunks at top-level sources, and a chunk per
+ * thread is parsed concurrently whenever the parsed sources run out. BBS
+ * models are read line by line. A binary model needs no parsing and is
+ * read completely when it is opened; its sources are then returned in
+ * batches as well. This is also done for a text model that has an
+ * up-to-date binary cache, see BinaryModel::ReadCache(), but the reader
+ * does not write the cache, because it never holds the complete model.
+ */
+class ModelReader
+{
+	public:
+		explicit ModelReader(const std::string& filename);
+		
+		~ModelReader();
+		
+		ModelReader(const ModelReader&) = delete;
+		ModelReader& operator=(const ModelReader&) = delete;
+		
+		/**
+		 * Replaces the contents of the batch by the next sources of the model,
+		 * at most maxSourceCount. Returns false when no sources are left.
+		 */
+		bool Read(std::vector<ModelSource>& batch, size_t maxSourceCount);
+		
+	private:
+		bool readSource(ModelSource& source);
+		
+		/** Reads the binary cache of a text model, when it is up to date. */
+		bool readCache(const std::string& filename, const BinaryModel::TextStamp& stamp);
+		
+		/** Parses the next chunks, one per thread. Returns false when none are left. */
+		bool parseChunks();
+		
+		/** Size in bytes of the chunks of a text model that are parsed concurrently. */
+		static constexpr size_t chunkSize = 1024*1024;
+		
+		std::unique_ptr<MappedFile> _file;
+		std::unique_ptr<ModelParser> _parser;
+		std::unique_ptr<BBSModel> _bbsModel;
+		std::unique_ptr<Model> _binaryModel;
+		size_t _binaryModelIndex;
+		/** The chunks of a text model, which is parsed source by source when there is only one. */
+		std::vector<const char*> _chunkBoundaries;
+		size_t _nextChunk;
+		std::unique_ptr<aocommon::ParallelFor<size_t>> _loop;
+		/** Sources of the chunks that were parsed, which are returned from _parsedIndex on. */
+		std::vector<ModelSource> _parsedSources;
+		size_t _parsedIndex;
+};
+
+#endif
@@ -2,10 +2,14 @@
 #define MODELSOURCE_H
 
 #include <algorithm>
+#include <iterator>
+#include <memory>
 #include <string>
 #include <sstream>
 
+#include "internedstring.h"
 #include "modelcomponent.h"
+#include "skyindex.h"
 
 class ModelSource
 {
@@ -21,6 +25,10 @@ class ModelSource
 		{
 		}
 		
+		ModelSource(ModelSource&& source) = default;
+		
+		ModelSource& operator=(ModelSource&& source) = default;
+		
 		~ModelSource()
 		{
 		}
@@ -31,19 +39,24 @@ class ModelSource
 			_components = source._components;
 			_userdata = source._userdata;
 			_clusterName = source._clusterName;
+			invalidateComponentIndex();
 			return *this;
 		}
 		
-		const std::string &Name() const { return _name; }
+		const std::string &Name() const { return _name.Str(); }
 		
-		void SetName(const std::string &name) { _name = name; }
+		void SetName(std::string_view name) { _name = InternedString(name); }
 		
 		/**
-		 * Returns nullptr in case the source is not part of a cluster.
+		 * Returns an empty string in case the source is not part of a cluster.
 		 */
-		const std::string& ClusterName() const { return _clusterName; }
+		const std::string& ClusterName() const { return _clusterName.Str(); }
+		
+		void SetClusterName(std::string_view clusterName) { _clusterName = InternedString(clusterName); }
 		
-		void SetClusterName(const std::string& clusterName) { _clusterName = clusterName; }
+		/** The names in the string table, which Model uses for its indices. */
+		const InternedString& InternedName() const { return _name; }
+		const InternedString& InternedClusterName() const { return _clusterName; }
 		
 		std::string ToString() const;
 		
@@ -53,17 +66,17 @@ class ModelSource
 				< rhs.TotalFlux(aocommon::Polarization::StokesI);
 		}
 		
+		/**
+		 * Adds the SED of the component to that of the component at the same
+		 * position, or adds the component when there is none.
+		 */
 		void operator+=(const ModelComponent& rhs)
 		{
-			for(iterator i = begin(); i!=end(); ++i)
-			{
-				if(rhs.PosDec() == i->PosDec() && rhs.PosRA() == i->PosRA())
-				{
-					i->SED() += rhs.SED();
-					return;
-				}
-			}
-			_components.push_back(rhs);
+			const size_t i = findComponent(rhs);
+			if(i == SkyIndex::npos)
+				AddComponent(rhs);
+			else
+				_components[i].SED() += rhs.SED();
 		}
 	
 		void operator+=(const ModelSource& rhs)
@@ -86,23 +99,19 @@ class ModelSource
 
 		void CombineMeasurements(const ModelComponent& component)
 		{
-			for(iterator i = begin(); i!=end(); ++i)
-			{
-				if(component.PosDec() == i->PosDec() && component.PosRA() == i->PosRA())
-				{
-					i->MSED().CombineMeasurements(component.MSED());
-					return;
-				}
-			}
-			throw std::runtime_error("Combining measurements while not same sources were measured!");
+			const size_t i = findComponent(component);
+			if(i == SkyIndex::npos)
+				throw std::runtime_error("Combining measurements while not same sources were measured!");
+			_components[i].MSED().CombineMeasurements(component.MSED());
 		}
 
-		iterator begin() { return _components.begin(); }
-		iterator end() { return _components.end(); }
+		// The non-const accessors allow moving the components, so they invalidate the component index
+		iterator begin() { invalidateComponentIndex(); return _components.begin(); }
+		iterator end() { invalidateComponentIndex(); return _components.end(); }
 		const_iterator begin() const { return _components.begin(); }
 		const_iterator end() const { return _components.end(); }
 		
-		ModelComponent& front() { return _components.front(); }
+		ModelComponent& front() { invalidateComponentIndex(); return _components.front(); }
 		const ModelComponent& front() const { return _components.front(); }
 		
 		const ModelComponent& Peak() const { return *begin(); }
@@ -110,9 +119,16 @@ class ModelSource
 		
 		void AddComponent(const ModelComponent& component) {
 			_components.push_back(component);
+			addToComponentIndex(_components.size() - 1);
+		}
+		
+		void AddComponent(ModelComponent&& component) {
+			_components.push_back(std::move(component));
+			addToComponentIndex(_components.size() - 1);
 		}
 		
 		void ClearComponents() {
+			invalidateComponentIndex();
 			_components.clear();
 		}
 		
@@ -238,6 +254,7 @@ class ModelSource
 		
 		void SortComponents()
 		{
+			invalidateComponentIndex();
 			std::sort(_components.rbegin(), _components.rend());
 		}
 		
@@ -275,10 +292,58 @@ class ModelSource
 		}
 		
 	private:
-		std::string _name;
+		/**
+		 * Components are looked up by position in a SkyIndex when the source has
+		 * at least this many components, and with a linear search otherwise.
+		 */
+		static constexpr size_t indexThreshold = 64;
+		
+		/**
+		 * Returns the index of the first component at the position of the given
+		 * component, or SkyIndex::npos. The component index is built when it is
+		 * first needed, and extended by AddComponent().
+		 */
+		size_t findComponent(const ModelComponent& component)
+		{
+			if(!_componentIndex && _components.size() < indexThreshold)
+			{
+				for(size_t i=0; i!=_components.size(); ++i)
+				{
+					if(component.PosDec() == _components[i].PosDec() && component.PosRA() == _components[i].PosRA())
+						return i;
+				}
+				return SkyIndex::npos;
+			}
+			if(!_componentIndex)
+			{
+				_componentIndex.reset(new SkyIndex());
+				_componentIndex->Reserve(_components.size());
+				for(size_t i=0; i!=_components.size(); ++i)
+					_componentIndex->Add(_components[i].PosRA(), _components[i].PosDec(), i);
+			}
+			return _componentIndex->FindExact(component.PosRA(), component.PosDec());
+		}
+		
+		void addToComponentIndex(size_t index)
+		{
+			if(_componentIndex)
+				_componentIndex->Add(_components[index].PosRA(), _components[index].PosDec(), index);
+		}
+		
+		void invalidateComponentIndex()
+		{
+			_componentIndex.reset();
+		}
+		
+		InternedString _name;
 		std::vector<ModelComponent> _components;
 		void *_userdata;
-		std::string _clusterName;
+		InternedString _clusterName;
+		/**
+		 * The positions of the components, with the component index as value,
+		 * or null when it has not been built. It is not copied with the source.
+		 */
+		std::unique_ptr<SkyIndex> _componentIndex;
 };
 
 class ModelCluster
@@ -292,24 +357,53 @@ private:
 	std::string _name;
 };
 
+/**
+ * A group of sources, e.g. of a cluster, that refers to the sources instead
+ * of copying them, so the sources must outlive the group and must not move.
+ * For sources of a Model, this means that adding, removing or sorting
+ * sources of the model, including Model::AddSource() and
+ * Model::ReserveSources(), makes the group invalid, because the model may
+ * then move its sources. A ModelView, which refers to sources of a model by
+ * their index, stays valid when sources are added.
+ */
 class SourceGroup
 {
 public:
-		typedef std::vector<ModelSource>::iterator iterator;
-		typedef std::vector<ModelSource>::const_iterator const_iterator;
-		iterator begin() { return _sources.begin(); }
-		iterator end() { return _sources.end(); }
-		const_iterator begin() const { return _sources.begin(); }
-		const_iterator end() const { return _sources.end(); }
+		class const_iterator
+		{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef ModelSource value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const ModelSource* pointer;
+				typedef const ModelSource& reference;
+
+				explicit const_iterator(std::vector<const ModelSource*>::const_iterator source) : _source(source)
+				{ }
+
+				reference operator*() const { return **_source; }
+				pointer operator->() const { return *_source; }
+
+				const_iterator& operator++() { ++_source; return *this; }
+				const_iterator operator++(int) { const_iterator previous(*this); ++_source; return previous; }
+
+				bool operator==(const const_iterator& rhs) const { return _source == rhs._source; }
+				bool operator!=(const const_iterator& rhs) const { return _source != rhs._source; }
+
+			private:
+				std::vector<const ModelSource*>::const_iterator _source;
+		};
+		const_iterator begin() const { return const_iterator(_sources.begin()); }
+		const_iterator end() const { return const_iterator(_sources.end()); }
 		
 		size_t SourceCount() const { return _sources.size(); }
 		
-		void AddSource(const ModelSource& source) { _sources.push_back(source); }
+		void AddSource(const ModelSource& source) { _sources.push_back(&source); }
 		
 		double TotalFlux(aocommon::PolarizationEnum polarization) const
 		{
 			double f = 0.0;
-			for(const_iterator s=_sources.begin(); s!=_sources.end(); ++s)
+			for(const_iterator s=begin(); s!=end(); ++s)
 				f += s->TotalFlux(polarization);
 			return f;
 		}
@@ -326,20 +420,20 @@ public:
 		double MeanDec() const
 		{
 			double sum = 0.0;
-			for(const_iterator s=_sources.begin(); s!=_sources.end(); ++s)
+			for(const_iterator s=begin(); s!=end(); ++s)
 				sum += s->MeanDec();
 			return sum / _sources.size();
 		}
 private:
-	std::vector<ModelSource> _sources;
+	std::vector<const ModelSource*> _sources;
 };
 
 inline std::string ModelSource::ToString() const
 {
 	std::stringstream s;
-	s << "source {\n  name \"" << _name << "\"\n";
-	if(!_clusterName.empty())
-		s << "  cluster \"" << _clusterName << "\"\n";
+	s << "source {\n  name \"" << Name() << "\"\n";
+	if(!_clusterName.Empty())
+		s << "  cluster \"" << ClusterName() << "\"\n";
 	for(const_iterator i=begin(); i!=end(); ++i)
 		s << i->ToString();
 	s << "}\n";
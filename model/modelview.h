@@ -0,0 +1,139 @@
+#ifndef MODEL_VIEW_H
+#define MODEL_VIEW_H
+
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+#include "model.h"
+
+/**
+ * A subset of the sources of a model, e.g. a cluster or the sources that
+ * pass a filter, stored as the indices of the sources in the model. Making
+ * a view costs an index per source in it, instead of copying the sources
+ * with all their components and SEDs. A view of a complete model stores no
+ * indices at all, so a Model can be passed wherever a view is accepted.
+ *
+ * The model must outlive the view. Sources can be added to the model while
+ * a view exists, but removing or sorting its sources makes the view invalid.
+ */
+class ModelView
+{
+	public:
+		class const_iterator
+		{
+			public:
+				typedef std::forward_iterator_tag iterator_category;
+				typedef ModelSource value_type;
+				typedef std::ptrdiff_t difference_type;
+				typedef const ModelSource* pointer;
+				typedef const ModelSource& reference;
+
+				const_iterator() : _view(nullptr), _position(0)
+				{ }
+
+				const_iterator(const ModelView* view, size_t position) : _view(view), _position(position)
+				{ }
+
+				reference operator*() const { return _view->Source(_position); }
+				pointer operator->() const { return &_view->Source(_position); }
+
+				const_iterator& operator++() { ++_position; return *this; }
+				const_iterator operator++(int) { const_iterator previous(*this); ++_position; return previous; }
+
+				bool operator==(const const_iterator& rhs) const { return _position == rhs._position; }
+				bool operator!=(const const_iterator& rhs) const { return _position != rhs._position; }
+
+				/** The index of the current source in the model. */
+				size_t ModelIndex() const { return _view->ModelIndex(_position); }
+
+			private:
+				const ModelView* _view;
+				size_t _position;
+		};
+
+		/** A view of all sources of the model. */
+		ModelView(const Model& model) : _model(&model), _isComplete(true)
+		{ }
+
+		/** A view of the sources with the given indices in the model, in that order. */
+		ModelView(const Model& model, std::vector<size_t> indices) : _model(&model), _indices(std::move(indices)), _isComplete(false)
+		{ }
+
+		const Model& GetModel() const { return *_model; }
+
+		size_t SourceCount() const { return _isComplete ? _model->SourceCount() : _indices.size(); }
+
+		bool Empty() const { return SourceCount() == 0; }
+
+		const ModelSource& Source(size_t index) const { return _model->Source(ModelIndex(index)); }
+
+		/** The index in the model of the index'th source of the view. */
+		size_t ModelIndex(size_t index) const { return _isComplete ? index : _indices[index]; }
+
+		const_iterator begin() const { return const_iterator(this, 0); }
+		const_iterator end() const { return const_iterator(this, SourceCount()); }
+
+		/**
+		 * Returns the view of the sources of this view for which the predicate,
+		 * called with a const ModelSource&, returns true.
+		 */
+		template<typename Predicate>
+		ModelView Filter(Predicate predicate) const
+		{
+			std::vector<size_t> indices;
+			for(size_t i=0; i!=SourceCount(); ++i)
+			{
+				if(predicate(Source(i)))
+					indices.push_back(ModelIndex(i));
+			}
+			return ModelView(*_model, std::move(indices));
+		}
+
+		/** Returns the view of the sources of this view in the given cluster. */
+		ModelView Cluster(const std::string& clusterName) const
+		{
+			if(_isComplete)
+				return ModelView(*_model, _model->ClusterMembers(clusterName));
+			InternedString name;
+			if(!InternedString::Find(clusterName, name))
+				return ModelView(*_model, std::vector<size_t>());
+			return Filter([&name](const ModelSource& source) { return source.InternedClusterName() == name; });
+		}
+
+		size_t ComponentCount() const {
+			size_t count = 0;
+			for(const ModelSource& source : *this)
+				count += source.ComponentCount();
+			return count;
+		}
+
+		double TotalFlux(double frequency, aocommon::PolarizationEnum polarization) const
+		{
+			double flux = 0.0;
+			for(const ModelSource& source : *this)
+				flux += source.TotalFlux(frequency, polarization);
+			return flux;
+		}
+
+		/** Copies the sources of the view and their clusters into a new model. */
+		Model ToModel() const
+		{
+			Model model;
+			model.ReserveSources(SourceCount());
+			for(const ModelSource& source : *this)
+			{
+				model.FindOrAddCluster(source.ClusterName());
+				model.AddSource(source);
+			}
+			return model;
+		}
+
+	private:
+		const Model* _model;
+		std::vector<size_t> _indices;
+		bool _isComplete;
+};
+
+#endif
@@ -0,0 +1,196 @@
+#include "skyindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <utility>
+
+namespace {
+	double distanceSquared(const double* a, const double* b)
+	{
+		const double dx = a[0] - b[0], dy = a[1] - b[1], dz = a[2] - b[2];
+		return dx*dx + dy*dy + dz*dz;
+	}
+
+	/** Orders by distance, and by value for equal distances. */
+	typedef std::pair<double, size_t> Match;
+}
+
+void SkyIndex::Clear()
+{
+	_points.clear();
+	_treeSize = 0;
+	_exactPositions.clear();
+}
+
+void SkyIndex::Reserve(size_t count)
+{
+	_points.reserve(count);
+	_exactPositions.reserve(count);
+}
+
+void SkyIndex::Add(long double ra, long double dec, size_t value)
+{
+	_points.push_back(toPoint(ra, dec, value));
+	_exactPositions.emplace(Position{ra, dec}, value);
+}
+
+void SkyIndex::Build()
+{
+	_treeSize = _points.size();
+	build(0, _treeSize, 0);
+}
+
+size_t SkyIndex::FindExact(long double ra, long double dec) const
+{
+	std::unordered_map<Position, size_t, PositionHash>::const_iterator position =
+		_exactPositions.find(Position{ra, dec});
+	return position == _exactPositions.end() ? npos : position->second;
+}
+
+size_t SkyIndex::FindNearest(long double ra, long double dec, double radius) const
+{
+	Match nearest(chordSquared(radius), npos);
+	auto visit = [&](const Point& point, double distance, double& maxDistanceSquared)
+	{
+		if(Match(distance, point.value) < nearest)
+		{
+			nearest = Match(distance, point.value);
+			maxDistanceSquared = distance;
+		}
+	};
+	double maxDistanceSquared = nearest.first;
+	search(toPoint(ra, dec, 0), maxDistanceSquared, visit);
+	return nearest.second;
+}
+
+std::vector<size_t> SkyIndex::ConeSearch(long double ra, long double dec, double radius) const
+{
+	std::vector<Match> matches;
+	auto visit = [&](const Point& point, double distance, double&)
+	{
+		matches.emplace_back(distance, point.value);
+	};
+	double maxDistanceSquared = chordSquared(radius);
+	search(toPoint(ra, dec, 0), maxDistanceSquared, visit);
+	std::sort(matches.begin(), matches.end());
+	std::vector<size_t> values(matches.size());
+	for(size_t i=0; i!=matches.size(); ++i)
+		values[i] = matches[i].second;
+	return values;
+}
+
+std::vector<size_t> SkyIndex::NearestNeighbours(long double ra, long double dec, size_t count) const
+{
+	// A max-heap of the nearest matches so far
+	std::priority_queue<Match> nearest;
+	auto visit = [&](const Point& point, double distance, double& maxDistanceSquared)
+	{
+		const Match match(distance, point.value);
+		if(nearest.size() < count)
+			nearest.push(match);
+		else if(match < nearest.top())
+		{
+			nearest.pop();
+			nearest.push(match);
+		}
+		if(nearest.size() == count)
+			maxDistanceSquared = nearest.top().first;
+	};
+	double maxDistanceSquared = count == 0 ? -1.0 : std::numeric_limits<double>::max();
+	search(toPoint(ra, dec, 0), maxDistanceSquared, visit);
+	std::vector<size_t> values(nearest.size());
+	for(size_t i=values.size(); i!=0; --i)
+	{
+		values[i-1] = nearest.top().second;
+		nearest.pop();
+	}
+	return values;
+}
+
+double SkyIndex::Distance(long double ra1, long double dec1, long double ra2, long double dec2)
+{
+	const Point a = toPoint(ra1, dec1, 0), b = toPoint(ra2, dec2, 0);
+	// The chord is accurate for small angles, unlike the cosine formula
+	return 2.0 * std::asin(std::min(1.0, 0.5 * std::sqrt(distanceSquared(a.xyz, b.xyz))));
+}
+
+SkyIndex::Point SkyIndex::toPoint(long double ra, long double dec, size_t value)
+{
+	const double cosDec = std::cos(double(dec));
+	Point point;
+	point.xyz[0] = cosDec * std::cos(double(ra));
+	point.xyz[1] = cosDec * std::sin(double(ra));
+	point.xyz[2] = std::sin(double(dec));
+	point.value = value;
+	return point;
+}
+
+double SkyIndex::chordSquared(double angle)
+{
+	if(angle < 0.0)
+		return -1.0;
+	const double chord = 2.0 * std::sin(0.5 * std::min(angle, M_PI));
+	return chord * chord;
+}
+
+void SkyIndex::build(size_t begin, size_t end, size_t depth)
+{
+	while(end - begin > leafSize)
+	{
+		const size_t axis = depth % 3;
+		const size_t middle = begin + (end - begin) / 2;
+		std::nth_element(_points.begin() + begin, _points.begin() + middle, _points.begin() + end,
+			[axis](const Point& a, const Point& b) { return a.xyz[axis] < b.xyz[axis]; });
+		build(begin, middle, depth + 1);
+		begin = middle + 1;
+		++depth;
+	}
+}
+
+template<typename Visitor>
+void SkyIndex::search(const Point& query, double& maxDistanceSquared, Visitor& visit) const
+{
+	searchTree(0, _treeSize, 0, query, maxDistanceSquared, visit);
+	for(size_t i=_treeSize; i!=_points.size(); ++i)
+	{
+		const double distance = distanceSquared(_points[i].xyz, query.xyz);
+		if(distance <= maxDistanceSquared)
+			visit(_points[i], distance, maxDistanceSquared);
+	}
+}
+
+template<typename Visitor>
+void SkyIndex::searchTree(size_t begin, size_t end, size_t depth, const Point& query, double& maxDistanceSquared, Visitor& visit) const
+{
+	if(end - begin <= leafSize)
+	{
+		for(size_t i=begin; i!=end; ++i)
+		{
+			const double distance = distanceSquared(_points[i].xyz, query.xyz);
+			if(distance <= maxDistanceSquared)
+				visit(_points[i], distance, maxDistanceSquared);
+		}
+	}
+	else {
+		const size_t axis = depth % 3;
+		const size_t middle = begin + (end - begin) / 2;
+		const Point& split = _points[middle];
+		const double distance = distanceSquared(split.xyz, query.xyz);
+		if(distance <= maxDistanceSquared)
+			visit(split, distance, maxDistanceSquared);
+		const double offset = query.xyz[axis] - split.xyz[axis];
+		// The side of the query is searched first, because it shrinks the radius of nearest-neighbour searches most
+		if(offset < 0.0)
+		{
+			searchTree(begin, middle, depth + 1, query, maxDistanceSquared, visit);
+			if(offset * offset <= maxDistanceSquared)
+				searchTree(middle + 1, end, depth + 1, query, maxDistanceSquared, visit);
+		}
+		else {
+			searchTree(middle + 1, end, depth + 1, query, maxDistanceSquared, visit);
+			if(offset * offset <= maxDistanceSquared)
+				searchTree(begin, middle, depth + 1, query, maxDistanceSquared, visit);
+		}
+	}
+}
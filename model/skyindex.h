@@ -0,0 +1,121 @@
+#ifndef SKY_INDEX_H
+#define SKY_INDEX_H
+
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Index of directions on the celestial sphere, each with a value such as
+ * the index of a source. Directions are stored as unit vectors in a 3D
+ * kd-tree, which answers cone searches, nearest-neighbour and
+ * tolerance-based queries in logarithmic time. Exact positions are kept in
+ * a hash table as well, so that exact lookups take constant time.
+ *
+ * Directions can be added at any time. Exact lookups see them immediately;
+ * the other queries scan the directions that were added after the last
+ * Build() linearly, so Build() should be called after adding many
+ * directions. The queries are const and can be called from several threads.
+ */
+class SkyIndex
+{
+	public:
+		static constexpr size_t npos = std::numeric_limits<size_t>::max();
+
+		SkyIndex() : _treeSize(0)
+		{ }
+
+		void Clear();
+
+		void Reserve(size_t count);
+
+		/** Adds a direction, in radians. */
+		void Add(long double ra, long double dec, size_t value);
+
+		/** Builds the kd-tree over all directions. */
+		void Build();
+
+		size_t Size() const { return _points.size(); }
+
+		bool IsBuilt() const { return _treeSize == _points.size(); }
+
+		/**
+		 * Returns the value of the first added direction with exactly this
+		 * position, or npos.
+		 */
+		size_t FindExact(long double ra, long double dec) const;
+
+		/**
+		 * Returns the value of the direction nearest to the given direction and
+		 * at most radius (in radians) from it, or npos. Of directions at the
+		 * same distance, the one with the lowest value is returned.
+		 */
+		size_t FindNearest(long double ra, long double dec, double radius) const;
+
+		/**
+		 * Returns the values of all directions at most radius (in radians) from
+		 * the given direction, nearest first.
+		 */
+		std::vector<size_t> ConeSearch(long double ra, long double dec, double radius) const;
+
+		/**
+		 * Returns the values of the count directions nearest to the given
+		 * direction, nearest first.
+		 */
+		std::vector<size_t> NearestNeighbours(long double ra, long double dec, size_t count) const;
+
+		/** Angular distance between two directions, in radians. */
+		static double Distance(long double ra1, long double dec1, long double ra2, long double dec2);
+
+	private:
+		struct Point
+		{
+			double xyz[3];
+			size_t value;
+		};
+
+		struct Position
+		{
+			long double ra, dec;
+			bool operator==(const Position& rhs) const { return ra == rhs.ra && dec == rhs.dec; }
+		};
+
+		struct PositionHash
+		{
+			size_t operator()(const Position& position) const
+			{
+				const size_t raHash = std::hash<long double>()(position.ra);
+				return raHash ^ (std::hash<long double>()(position.dec) + 0x9e3779b97f4a7c15ull + (raHash << 6) + (raHash >> 2));
+			}
+		};
+
+		/** Nodes with fewer points than this are not split. */
+		static constexpr size_t leafSize = 8;
+
+		static Point toPoint(long double ra, long double dec, size_t value);
+
+		/** The squared chord length on the unit sphere of an angle. */
+		static double chordSquared(double angle);
+
+		void build(size_t begin, size_t end, size_t depth);
+
+		/**
+		 * Calls visit(point, distanceSquared, maxDistanceSquared) for all points
+		 * within the squared chord maxDistanceSquared of the query. The visitor
+		 * may decrease maxDistanceSquared to narrow the search.
+		 */
+		template<typename Visitor>
+		void search(const Point& query, double& maxDistanceSquared, Visitor& visit) const;
+
+		template<typename Visitor>
+		void searchTree(size_t begin, size_t end, size_t depth, const Point& query, double& maxDistanceSquared, Visitor& visit) const;
+
+		/** The first _treeSize points are ordered as a kd-tree, the others follow in order of addition. */
+		std::vector<Point> _points;
+		size_t _treeSize;
+		std::unordered_map<Position, size_t, PositionHash> _exactPositions;
+};
+
+#endif
@@ -1,30 +1,47 @@
 #ifndef TOKENIZER_H
 #define TOKENIZER_H
 
-#include <fstream>
+#include <charconv>
+#include <cstring>
 #include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
 
+/**
+ * Splits a text in memory, normally a memory-mapped model file, into
+ * tokens. Tokens are separated by spaces, tabs, newlines or ';'. A quoted
+ * string is a single token, including its quotes, and "//" starts a comment
+ * that runs until the end of the line.
+ *
+ * Tokens are returned as views into the text, so the text must outlive them,
+ * and no memory is allocated while tokenizing.
+ */
 class Tokenizer
 {
 	public:
-		std::string getString()
+		Tokenizer() : _position(nullptr), _end(nullptr)
+		{ }
+
+		std::string_view getString()
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
-			if(token.size()<2 || token[0]!='\"' || token[token.size()-1]!='\"')
+			if(token.size()<2 || token.front()!='\"' || token.back()!='\"')
 				throw std::runtime_error("Expecting string");
 			return token.substr(1, token.size()-2);
 		}
+
 		double getTokenAsDouble()
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
-			return atof(token.c_str());
+			return toDouble(token);
 		}
-		
+
 		bool getTokenAsBool()
 		{
-			std::string token;
+			std::string_view token;
 			getToken(token);
 			if(token == "1" || token == "true" || token == "True")
 				return true;
@@ -32,76 +49,98 @@ class Tokenizer
 				return false;
 			else throw std::runtime_error("Expecting boolean");
 		}
-		
-		bool getToken(std::string &token)
+
+		bool getToken(std::string_view &token)
 		{
-			if(!_stream->good()) return false;
-			
-			std::stringstream s;
-			bool finished = false;
-			enum { StateStart, StateInToken, StateInString, StateEscaped, StateInLineComment } state = StateStart;
-			do {
-				char c;
-				_stream->get(c);
-				if(!_stream->fail())
+			while(true)
+			{
+				while(_position != _end && (*_position == ' ' || *_position == '\t' || *_position == '\n'))
+					++_position;
+				if(_position == _end)
 				{
-					switch(state)
-					{
-					case StateStart:
-						if(!(c == ' ' || c == '\t' || c == '\n'))
-						{
-							if(c == '/')
-								state = StateEscaped;
-							else
-							{
-								s << c;
-								if(c == '\"')
-									state = StateInString;
-								else
-									state = StateInToken;
-							}
-						}
-						break;
-					case StateInString:
-						s << c;
-						if(c == '\"')
-							finished = true;
-						break;
-					case StateInToken:
-						if(c == ' ' || c == '\t' || c == '\n' || c == ';')
-							finished = true;
-						else
-							s << c;
-						break;
-					case StateEscaped:
-						if(c == '/')
-							state = StateInLineComment;
-						else
-							throw std::runtime_error("Incorrect /");
-						break;
-					case StateInLineComment:
-						if(c == '\n')
-							state = StateStart;
-						break;
-					}
+					token = std::string_view();
+					return false;
 				}
-				else {
-					token = s.str();
-					return !token.empty();
+				if(*_position != '/')
+					break;
+				++_position;
+				if(_position == _end)
+				{
+					token = std::string_view();
+					return false;
 				}
-			} while(!finished);
-			token = s.str();
+				if(*_position != '/')
+					throw std::runtime_error("Incorrect /");
+				const char* lineEnd = static_cast<const char*>(std::memchr(_position, '\n', _end - _position));
+				_position = lineEnd ? lineEnd + 1 : _end;
+			}
+
+			const char* start = _position;
+			if(*start == '\"')
+			{
+				// A string ends at the closing quote; an unterminated string runs
+				// until the end of the text.
+				const char* close = static_cast<const char*>(std::memchr(start + 1, '\"', _end - start - 1));
+				_position = close ? close + 1 : _end;
+			}
+			else {
+				// The first character is part of the token, even when it is a ';'
+				++_position;
+				while(_position != _end && !(*_position == ' ' || *_position == '\t' || *_position == '\n' || *_position == ';'))
+					++_position;
+			}
+			token = std::string_view(start, _position - start);
+			// The separator after a token is consumed
+			if(*start != '\"' && _position != _end)
+				++_position;
 			return true;
 		}
-		
-		void SetStream(std::ifstream &stream)
+
+		/**
+		 * Returns the remainder of the current line, without the newline, and
+		 * moves to the start of the next line.
+		 */
+		std::string_view getLine()
+		{
+			if(_position == _end)
+				return std::string_view();
+			const char* lineEnd = static_cast<const char*>(std::memchr(_position, '\n', _end - _position));
+			const std::string_view line(_position, (lineEnd ? lineEnd : _end) - _position);
+			_position = lineEnd ? lineEnd + 1 : _end;
+			return line;
+		}
+
+		/**
+		 * Parses a number in fixed or scientific notation, with an optional
+		 * leading '+'. Characters after the number are ignored.
+		 */
+		static double toDouble(std::string_view token)
+		{
+			const char* first = token.data();
+			const char* last = first + token.size();
+			if(first != last && *first == '+')
+				++first;
+			double value = 0.0;
+			const std::from_chars_result result = std::from_chars(first, last, value);
+			if(result.ec != std::errc())
+				throw std::runtime_error("Expecting number, got '" + std::string(token) + "'");
+			return value;
+		}
+
+		void SetText(const char* begin, const char* end)
 		{
-			_stream = &stream;
+			_position = begin;
+			_end = end;
 		}
-		std::ifstream &Stream() { return *_stream; }
-		const std::ifstream &Stream() const { return *_stream; }
-		
-		std::ifstream *_stream;
+
+		/** The start of the remaining text. */
+		const char* position() const { return _position; }
+
+		const char* textEnd() const { return _end; }
+
+	private:
+		const char* _position;
+		const char* _end;
 };
 
 #endif
@@ -0,0 +1,268 @@
+#include "observation.h"
+
+#include "hasher.h"
+#include "profiler.h"
+
+#include <casacore/tables/TaQL/TableParse.h>
+#include <casacore/tables/Tables/ScalarColumn.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	bool isRegularFile(const std::string& path)
+	{
+		struct stat fileStat;
+		return stat(path.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode);
+	}
+}
+
+TimeIndex ReadTimeIndex(casacore::MeasurementSet& ms, const MetaData& metaData, const TimeSelection& timeSelection)
+{
+	ProfileScope scope("read_main_table");
+	const size_t fieldCount = metaData.FieldCount();
+	const size_t spectralWindowCount = metaData.SpectralWindowCount();
+	TimeIndex index;
+	index.fieldTimes.resize(fieldCount);
+	index.fieldHasData.assign(fieldCount, std::vector<bool>(spectralWindowCount, false));
+
+	casacore::Table mainTable = ms;
+	std::ostringstream where;
+	where << std::setprecision(17);
+	if(timeSelection.HasRange())
+		where << "TIME >= " << timeSelection.start << " AND TIME <= " << timeSelection.end;
+	if(!timeSelection.rowSelection.empty())
+	{
+		if(timeSelection.HasRange())
+			where << " AND ";
+		where << '(' << timeSelection.rowSelection << ')';
+	}
+	if(!where.str().empty())
+		mainTable = casacore::tableCommand("SELECT FROM $1 WHERE " + where.str(), ms);
+	casacore::ROScalarColumn<int> spectralWindowIdColumn(ms.dataDescription(), casacore::MSDataDescription::columnName(casacore::MSDataDescriptionEnums::SPECTRAL_WINDOW_ID));
+	std::vector<size_t> dataDescToSpectralWindow(ms.dataDescription().nrow());
+	for(size_t i=0; i!=dataDescToSpectralWindow.size(); ++i)
+	{
+		dataDescToSpectralWindow[i] = spectralWindowIdColumn(i);
+		if(dataDescToSpectralWindow[i] >= spectralWindowCount)
+			throw std::runtime_error("DATA_DESCRIPTION table refers to a non-existing spectral window");
+	}
+	// The TIME column holds the epoch in MJD seconds. The rows are sorted by
+	// time, but with several fields or spectral windows, the rows of a
+	// timestep are not necessarily consecutive.
+	casacore::ROScalarColumn<double> timeColumn(mainTable, ms.columnName(casacore::MSMainEnums::TIME));
+	casacore::ROScalarColumn<int>
+		fieldColumn(mainTable, ms.columnName(casacore::MSMainEnums::FIELD_ID)),
+		dataDescColumn(mainTable, ms.columnName(casacore::MSMainEnums::DATA_DESC_ID));
+	// The row count is that of the complete table, because follow mode
+	// continues reading the complete table after it
+	index.rowCount = ms.nrow();
+	const size_t selectedRowCount = mainTable.nrow();
+	for(size_t row=0; row!=selectedRowCount; ++row)
+	{
+		const size_t field = fieldColumn(row);
+		const size_t dataDescId = dataDescColumn(row);
+		if(field >= fieldCount || dataDescId >= dataDescToSpectralWindow.size())
+			throw std::runtime_error("Main table refers to a non-existing field or data description");
+		const double time = timeColumn(row);
+		std::vector<double>& times = index.fieldTimes[field];
+		if(times.empty() || time != times.back())
+			times.push_back(time);
+		index.fieldHasData[field][dataDescToSpectralWindow[dataDescId]] = true;
+	}
+	for(std::vector<double>& times : index.fieldTimes)
+	{
+		std::sort(times.begin(), times.end());
+		times.erase(std::unique(times.begin(), times.end()), times.end());
+	}
+	return index;
+}
+
+TimeIndex GridTimeIndex(const TimeGrid& timeGrid, const MetaData& metaData, const TimeSelection& timeSelection)
+{
+	if(!timeSelection.rowSelection.empty())
+		throw std::runtime_error("A row selection can not be combined with a time grid");
+	const size_t fieldCount = metaData.FieldCount();
+	TimeIndex index;
+	index.fieldTimes.resize(fieldCount);
+	index.fieldHasData.assign(fieldCount, std::vector<bool>(metaData.SpectralWindowCount(), true));
+	index.rowCount = 0;
+	const size_t count = size_t(std::floor((timeGrid.end - timeGrid.start) / timeGrid.interval + 1e-6)) + 1;
+	for(size_t field=0; field!=fieldCount; ++field)
+	{
+		for(size_t i=0; i!=count; ++i)
+		{
+			const double time = timeGrid.start + i * timeGrid.interval;
+			if(timeSelection.InRange(time))
+				index.fieldTimes[field].push_back(time);
+		}
+	}
+	return index;
+}
+
+MetaData ReadMetaData(const std::string& observationFilename, const std::string& sidecarFilename, std::unique_ptr<casacore::MeasurementSet>& ms)
+{
+	ProfileScope scope("read_meta_data");
+	const std::string sidecar = isRegularFile(observationFilename) ? observationFilename : sidecarFilename;
+	const bool useSidecar = !sidecar.empty() && access(sidecar.c_str(), F_OK) == 0;
+	if(useSidecar)
+		return MetaData::FromSidecar(sidecar);
+	ms.reset(new casacore::MeasurementSet(observationFilename));
+	MetaData metaData = MetaData::FromMS(*ms);
+	if(!sidecar.empty())
+	{
+		std::cout << "Writing meta data to sidecar " << sidecar << "...\n";
+		metaData.WriteSidecar(sidecar);
+	}
+	return metaData;
+}
+
+std::shared_ptr<const BeamBackend> ReadBeam(const MetaData& metaData, StationCache& stationCache)
+{
+	const uint64_t layoutKey = metaData.LayoutKey();
+	if(!stationCache.beam || stationCache.layoutKey != layoutKey)
+	{
+		ProfileScope scope("create_beam");
+		stationCache.beam = CreateBeamBackend(stationCache.beamName, metaData.Stations());
+		stationCache.layoutKey = layoutKey;
+	}
+	return stationCache.beam;
+}
+
+ObservationInfo MakeObservationInfo(const MetaData& metaData, std::shared_ptr<const BeamBackend> beam, TimeIndex timeIndex, size_t stride, const std::vector<double>& frequencies, bool follow)
+{
+	ObservationInfo info;
+	info.layoutKey = metaData.LayoutKey();
+	info.beam = std::move(beam);
+	info.fieldCount = metaData.FieldCount();
+	info.rowCount = timeIndex.rowCount;
+	std::vector<std::vector<double>>& fieldTimes = timeIndex.fieldTimes;
+
+	std::vector<size_t> unstridedCounts(info.fieldCount);
+	std::vector<double> lastTimes(info.fieldCount, 0.0);
+	for(size_t field=0; field!=info.fieldCount; ++field)
+	{
+		unstridedCounts[field] = fieldTimes[field].size();
+		if(!fieldTimes[field].empty())
+			lastTimes[field] = fieldTimes[field].back();
+	}
+	if(stride > 1)
+	{
+		for(std::vector<double>& times : fieldTimes)
+		{
+			size_t selected = 0;
+			for(size_t timestep=0; timestep<times.size(); timestep += stride)
+				times[selected++] = times[timestep];
+			Profiler::Count(Profiler::CulledTimesteps, times.size() - selected);
+			times.resize(selected);
+		}
+	}
+
+	Hasher hasher, timeHasher;
+	hasher.Add(metaData.Key());
+	hasher.Add(std::string(info.beam->Name()));
+	for(size_t field=0; field!=info.fieldCount; ++field)
+	{
+		timeHasher.Add(uint64_t(fieldTimes[field].size()));
+		for(double time : fieldTimes[field])
+			timeHasher.Add(time);
+	}
+	hasher.Add(timeHasher.Value());
+	info.key = hasher.Value();
+	info.timeKey = timeHasher.Value();
+
+	const size_t spectralWindowCount = metaData.SpectralWindowCount();
+	for(size_t field=0; field!=info.fieldCount; ++field)
+	{
+		if(fieldTimes[field].empty() && !follow)
+			continue;
+		info.fields.emplace_back();
+		FieldInfo& fieldInfo = info.fields.back();
+		fieldInfo.index = field;
+		Hasher fieldHasher;
+		fieldHasher.Add(info.key);
+		fieldHasher.Add(uint64_t(field));
+		fieldInfo.key = fieldHasher.Value();
+		if(frequencies.empty())
+		{
+			for(size_t spectralWindow=0; spectralWindow!=spectralWindowCount; ++spectralWindow)
+			{
+				if(timeIndex.fieldHasData[field][spectralWindow] || follow)
+					fieldInfo.frequencies.push_back(metaData.Band(spectralWindow).CentreFrequency());
+			}
+		}
+		else {
+			fieldInfo.frequencies = frequencies;
+		}
+		fieldInfo.engine.reset(new ResponseEngine(info.beam, metaData.DelayDirection(field), metaData.TileBeamDirection(field)));
+		fieldInfo.unstridedCount = unstridedCounts[field];
+		fieldInfo.lastTime = lastTimes[field];
+		fieldInfo.engine->AddTimes(fieldTimes[field].data(), fieldTimes[field].size());
+		fieldInfo.times = std::move(fieldTimes[field]);
+	}
+	if(info.fields.empty())
+		throw std::runtime_error("The observation has no timesteps: check the time selection, or specify a time grid for a measurement set with an empty main table");
+	return info;
+}
+
+ObservationInfo ReadObservationInfo(const std::string& observationFilename, const std::string& sidecarFilename, const TimeGrid& timeGrid, const TimeSelection& timeSelection, const std::vector<double>& frequencies, StationCache& stationCache, bool follow)
+{
+	ProfileScope scope("read_observation");
+	std::unique_ptr<casacore::MeasurementSet> ms;
+	const MetaData metaData = ReadMetaData(observationFilename, sidecarFilename, ms);
+	std::shared_ptr<const BeamBackend> beam = ReadBeam(metaData, stationCache);
+	TimeIndex timeIndex;
+	if(timeGrid.IsSet())
+		timeIndex = GridTimeIndex(timeGrid, metaData, timeSelection);
+	else {
+		if(!ms)
+			throw std::runtime_error("A time grid is required when the observation is given as a sidecar");
+		timeIndex = ReadTimeIndex(*ms, metaData, timeSelection);
+	}
+	return MakeObservationInfo(metaData, std::move(beam), std::move(timeIndex), timeSelection.stride, frequencies, follow);
+}
+
+size_t AppendNewTimesteps(ObservationInfo& info, casacore::MeasurementSet& ms, const TimeSelection& timeSelection)
+{
+	const size_t rowCount = ms.nrow();
+	if(rowCount < info.rowCount)
+		throw std::runtime_error("Rows were removed from the main table");
+	if(rowCount == info.rowCount)
+		return 0;
+
+	std::vector<size_t> fieldPositions(info.fieldCount, info.fields.size());
+	for(size_t f=0; f!=info.fields.size(); ++f)
+		fieldPositions[info.fields[f].index] = f;
+	size_t newTimesteps = 0;
+	casacore::ROScalarColumn<double> timeColumn(ms, ms.columnName(casacore::MSMainEnums::TIME));
+	casacore::ROScalarColumn<int> fieldColumn(ms, ms.columnName(casacore::MSMainEnums::FIELD_ID));
+	for(size_t row=info.rowCount; row!=rowCount; ++row)
+	{
+		const size_t fieldIndex = fieldColumn(row);
+		if(fieldIndex >= info.fieldCount || fieldPositions[fieldIndex] == info.fields.size())
+			continue;
+		FieldInfo& field = info.fields[fieldPositions[fieldIndex]];
+		const double time = timeColumn(row);
+		if(timeSelection.InRange(time) && (field.unstridedCount == 0 || time > field.lastTime))
+		{
+			if(field.unstridedCount % timeSelection.stride == 0)
+			{
+				field.AddTimestep(time);
+				++newTimesteps;
+			}
+			else
+				Profiler::Count(Profiler::CulledTimesteps);
+			++field.unstridedCount;
+			field.lastTime = time;
+		}
+	}
+	info.rowCount = rowCount;
+	return newTimesteps;
+}
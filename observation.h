@@ -0,0 +1,189 @@
+#ifndef OBSERVATION_H
+#define OBSERVATION_H
+
+#include "beambackend.h"
+#include "metadata.h"
+#include "responseengine.h"
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Regularly spaced timesteps that replace the timesteps of the main table,
+ * e.g. to calculate the response for a planned observation.
+ */
+struct TimeGrid
+{
+	TimeGrid() : start(0.0), end(0.0), interval(0.0) { }
+	bool IsSet() const { return interval > 0.0; }
+	/** Start and end (inclusive) in MJD seconds. */
+	double start, end;
+	/** Interval in seconds. */
+	double interval;
+};
+
+/**
+ * Restricts the timesteps at which the response is calculated. The time
+ * range and the row selection are applied when the main table is read, so
+ * that rows outside the selection are never read.
+ */
+struct TimeSelection
+{
+	TimeSelection() : start(0.0), end(0.0), stride(1) { }
+	bool HasRange() const { return end > start; }
+	bool InRange(double time) const { return !HasRange() || (time >= start && time <= end); }
+	/** Start and end (inclusive) in MJD seconds. */
+	double start, end;
+	/** Use every stride-th timestep of every field. */
+	size_t stride;
+	/** TaQL expression that selects the rows of the main table to use. */
+	std::string rowSelection;
+};
+
+/**
+ * The timesteps of every field of an observation, before the time stride is
+ * applied, and the spectral windows in which every field has data.
+ */
+struct TimeIndex
+{
+	/** Sorted, unique times of every field, in MJD seconds. */
+	std::vector<std::vector<double>> fieldTimes;
+	/** Per field, whether the main table has data in each spectral window. */
+	std::vector<std::vector<bool>> fieldHasData;
+	/** Number of rows of the main table that were read, before the selection. */
+	size_t rowCount;
+};
+
+/**
+ * Reads the times of the rows of the main table that are within the time
+ * range and the row selection. The time range and row selection are
+ * combined into a single TaQL selection, so only the selected rows are read.
+ */
+TimeIndex ReadTimeIndex(casacore::MeasurementSet& ms, const MetaData& metaData, const TimeSelection& timeSelection);
+
+/**
+ * The times of a time grid within the time range, for all fields and
+ * spectral windows.
+ */
+TimeIndex GridTimeIndex(const TimeGrid& timeGrid, const MetaData& metaData, const TimeSelection& timeSelection);
+
+/**
+ * The timesteps and frequencies at which the response is calculated for
+ * one field, i.e. one row of the FIELD table.
+ */
+struct FieldInfo
+{
+	/** Row in the FIELD table. */
+	size_t index;
+	/** Key of the observation and field, used to look up responses in the cache. */
+	uint64_t key;
+	/** Frequencies in Hz at which the response is calculated. */
+	std::vector<double> frequencies;
+	/** Time of every timestep, in MJD seconds. */
+	std::vector<double> times;
+	/**
+	 * Calculates the responses of the field. It holds the delay and tile beam
+	 * directions in ITRF coordinates for every timestep: they do not depend on
+	 * the source, so they are converted once and reused for all components.
+	 */
+	std::unique_ptr<ResponseEngine> engine;
+	/**
+	 * The number of selected timesteps before applying the time stride, and
+	 * the last of these. They are used to continue the selection when
+	 * timesteps are appended in follow mode.
+	 */
+	size_t unstridedCount;
+	double lastTime;
+
+	void AddTimestep(double time)
+	{
+		times.push_back(time);
+		engine->AddTimes(&time, 1);
+	}
+};
+
+struct ObservationInfo
+{
+	uint64_t key;
+	/** See MetaData::LayoutKey(). */
+	uint64_t layoutKey;
+	/** Hash of the times of all fields. */
+	uint64_t timeKey;
+	std::shared_ptr<const BeamBackend> beam;
+	/** Number of rows of the main table that were read, before the selection. */
+	size_t rowCount;
+	/** Total number of fields in the observation. */
+	size_t fieldCount;
+	/** The fields that have data. */
+	std::vector<FieldInfo> fields;
+};
+
+/**
+ * The beam backend of the previously read observation. It is reused when
+ * the next observation has the same layout, as is the case for the
+ * subbands of a single observation.
+ */
+struct StationCache
+{
+	explicit StationCache(const std::string& beamName_) : beamName(beamName_), layoutKey(0) { }
+	/** Name of the beam backend to create, see BeamBackendNames(). */
+	std::string beamName;
+	uint64_t layoutKey;
+	std::shared_ptr<const BeamBackend> beam;
+};
+
+/**
+ * Reads the meta data of an observation, which can be a measurement set or
+ * a sidecar file. When a separate sidecar filename is given, the meta data
+ * is read from that sidecar when it exists, and the sidecar is written
+ * otherwise. When the meta data was read from the measurement set, it is
+ * left open in ms.
+ */
+MetaData ReadMetaData(const std::string& observationFilename, const std::string& sidecarFilename, std::unique_ptr<casacore::MeasurementSet>& ms);
+
+/**
+ * Returns the beam backend for the stations of the meta data, which is
+ * reused from the cache when the layout did not change.
+ */
+std::shared_ptr<const BeamBackend> ReadBeam(const MetaData& metaData, StationCache& stationCache);
+
+/**
+ * Applies the time stride to the time index and sets up the fields of the
+ * observation, including the direction conversions of their timesteps.
+ * The response of a field is calculated at the timesteps and in the spectral
+ * windows for which the time index has data of that field. Without a list of
+ * frequencies, the response is calculated at the centre frequency of each of
+ * these spectral windows.
+ *
+ * When following an observation that is being written, all fields and
+ * spectral windows are used, because data for them may still be written.
+ */
+ObservationInfo MakeObservationInfo(const MetaData& metaData, std::shared_ptr<const BeamBackend> beam, TimeIndex timeIndex, size_t stride, const std::vector<double>& frequencies, bool follow = false);
+
+/**
+ * Reads the meta data and the timesteps of the observation.
+ *
+ * The observation can be a measurement set or a sidecar file, see
+ * ReadMetaData(). When a time grid is given, the times are taken from the
+ * grid and the main table is not read; this is required when the
+ * observation is a sidecar. The time selection is applied in both cases, but
+ * a row selection requires the main table. See MakeObservationInfo() for the
+ * fields and frequencies that are used.
+ */
+ObservationInfo ReadObservationInfo(const std::string& observationFilename, const std::string& sidecarFilename, const TimeGrid& timeGrid, const TimeSelection& timeSelection, const std::vector<double>& frequencies, StationCache& stationCache, bool follow = false);
+
+/**
+ * Appends the timesteps of the rows that were added to the main table since
+ * it was last read, for an observation that is being written. Rows are
+ * written in time order, so a timestep is new when it is later than the
+ * last timestep of its field. The time range and stride are applied; a row
+ * selection is not supported. Returns the number of timesteps that were
+ * appended to all fields together.
+ */
+size_t AppendNewTimesteps(ObservationInfo& info, casacore::MeasurementSet& ms, const TimeSelection& timeSelection);
+
+#endif
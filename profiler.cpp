@@ -0,0 +1,200 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+std::atomic<bool> Profiler::_enabled(false);
+std::atomic<uint64_t> Profiler::_counters[Profiler::CounterCount];
+
+namespace {
+	struct Span
+	{
+		const char* name;
+		int64_t start, end;
+	};
+
+	/**
+	 * The spans of one thread. The mutex is only contended while the trace or
+	 * summary is written.
+	 */
+	struct ThreadBuffer
+	{
+		size_t index;
+		std::string name;
+		std::mutex mutex;
+		std::vector<Span> spans;
+	};
+
+	std::chrono::steady_clock::time_point epoch;
+
+	/** Buffers are never removed, so spans of finished threads are kept. */
+	std::mutex registryMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> registry;
+
+	ThreadBuffer& threadBuffer()
+	{
+		thread_local ThreadBuffer* buffer = nullptr;
+		if(!buffer)
+		{
+			std::lock_guard<std::mutex> lock(registryMutex);
+			registry.emplace_back(new ThreadBuffer());
+			buffer = registry.back().get();
+			buffer->index = registry.size();
+		}
+		return *buffer;
+	}
+
+	std::string jsonString(const std::string& str)
+	{
+		std::string result = "\"";
+		for(char c : str)
+		{
+			if(c == '"' || c == '\\')
+				result += '\\';
+			if(static_cast<unsigned char>(c) >= 0x20)
+				result += c;
+		}
+		return result + '"';
+	}
+
+	/** Microseconds, the unit of the trace-event format. */
+	double microseconds(int64_t nanoseconds)
+	{
+		return nanoseconds * 1e-3;
+	}
+}
+
+void Profiler::Enable()
+{
+	epoch = std::chrono::steady_clock::now();
+	_enabled = true;
+}
+
+const char* Profiler::CounterName(Counter counter)
+{
+	switch(counter)
+	{
+		case ResponseCalls: return "response_calls";
+		case DirectionConversions: return "direction_conversions";
+		case CulledTimesteps: return "culled_timesteps";
+		case ResponseCacheHits: return "cache_hits";
+		case ResponseCacheMisses: return "cache_misses";
+		default: return "";
+	}
+}
+
+int64_t Profiler::now()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Profiler::record(const char* name, int64_t start, int64_t end)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.spans.push_back(Span{name, start, end});
+}
+
+void Profiler::NameThread(const std::string& name)
+{
+	ThreadBuffer& buffer = threadBuffer();
+	std::lock_guard<std::mutex> lock(buffer.mutex);
+	buffer.name = name;
+}
+
+void Profiler::WriteChromeTrace(const std::string& filename)
+{
+	std::ofstream file(filename);
+	if(!file)
+		throw std::runtime_error("Could not create trace file " + filename);
+	file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[\n";
+	bool isFirst = true;
+	auto separator = [&]() -> std::ostream&
+	{
+		if(!isFirst)
+			file << ",\n";
+		isFirst = false;
+		return file;
+	};
+	std::lock_guard<std::mutex> registryLock(registryMutex);
+	for(const std::unique_ptr<ThreadBuffer>& buffer : registry)
+	{
+		std::lock_guard<std::mutex> lock(buffer->mutex);
+		const std::string threadName = buffer->name.empty() ? "thread " + std::to_string(buffer->index) : buffer->name;
+		separator() << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->index
+			<< ",\"args\":{\"name\":" << jsonString(threadName) << "}}";
+		for(const Span& span : buffer->spans)
+		{
+			separator() << "{\"name\":" << jsonString(span.name) << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->index
+				<< ",\"ts\":" << microseconds(span.start) << ",\"dur\":" << microseconds(span.end - span.start) << '}';
+		}
+	}
+	// The counters are shown as a single sample at the end of the run
+	const double end = microseconds(now());
+	for(size_t counter=0; counter!=CounterCount; ++counter)
+	{
+		separator() << "{\"name\":\"" << CounterName(Counter(counter)) << "\",\"ph\":\"C\",\"pid\":1,\"ts\":" << end
+			<< ",\"args\":{\"value\":" << CounterValue(Counter(counter)) << "}}";
+	}
+	file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	if(!file.good())
+		throw std::runtime_error("Error writing trace file " + filename);
+}
+
+void Profiler::PrintSummary(std::ostream& stream)
+{
+	struct Totals
+	{
+		Totals() : count(0), total(0), longest(0) { }
+		size_t count;
+		int64_t total, longest;
+	};
+	std::map<std::string, Totals> totals;
+	{
+		std::lock_guard<std::mutex> registryLock(registryMutex);
+		for(const std::unique_ptr<ThreadBuffer>& buffer : registry)
+		{
+			std::lock_guard<std::mutex> lock(buffer->mutex);
+			for(const Span& span : buffer->spans)
+			{
+				Totals& t = totals[span.name];
+				++t.count;
+				t.total += span.end - span.start;
+				t.longest = std::max(t.longest, span.end - span.start);
+			}
+		}
+	}
+	// Sorted by total time, longest first
+	std::vector<std::pair<std::string, Totals>> rows(totals.begin(), totals.end());
+	std::sort(rows.begin(), rows.end(), [](const std::pair<std::string, Totals>& a, const std::pair<std::string, Totals>& b)
+	{
+		return a.second.total > b.second.total;
+	});
+	const double runTime = now() * 1e-9;
+	const std::ios::fmtflags flags = stream.flags();
+	const std::streamsize precision = stream.precision();
+	stream << std::fixed << std::setprecision(3)
+		<< "Profile of " << runTime << " s:\n"
+		<< std::left << std::setw(24) << "phase" << std::right << std::setw(10) << "count" << std::setw(12) << "total (s)"
+		<< std::setw(12) << "mean (ms)" << std::setw(12) << "max (ms)" << std::setw(9) << "% run" << '\n';
+	for(const std::pair<std::string, Totals>& row : rows)
+	{
+		const Totals& t = row.second;
+		stream << std::left << std::setw(24) << row.first << std::right << std::setw(10) << t.count
+			<< std::setw(12) << t.total*1e-9 << std::setw(12) << t.total*1e-6/t.count
+			<< std::setw(12) << t.longest*1e-6 << std::setw(9) << std::setprecision(1) << (runTime > 0.0 ? 100.0*t.total*1e-9/runTime : 0.0)
+			<< std::setprecision(3) << '\n';
+	}
+	stream << std::left << std::setw(24) << "counter" << std::right << std::setw(10) << "value" << '\n';
+	for(size_t counter=0; counter!=CounterCount; ++counter)
+		stream << std::left << std::setw(24) << CounterName(Counter(counter)) << std::right << std::setw(10) << CounterValue(Counter(counter)) << '\n';
+	stream.flags(flags);
+	stream.precision(precision);
+}
@@ -0,0 +1,112 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+/**
+ * Records how long the phases of a run take, and counts the most important
+ * operations. Phases are recorded as spans (name, thread, start and
+ * duration) with a @ref ProfileScope; each thread writes to its own buffer,
+ * so that recording does not need to synchronize between threads.
+ * The spans can be written as a Chrome trace-event file, which can be
+ * viewed in chrome://tracing or Perfetto, and summarized in a table.
+ *
+ * Profiling is disabled by default. While disabled, a scope or counter costs
+ * a single relaxed load and a branch, so the instrumentation can be left in
+ * inner loops.
+ */
+class Profiler
+{
+public:
+	enum Counter
+	{
+		/** Number of station beam responses that were evaluated. */
+		ResponseCalls,
+		/** Number of direction conversions to ITRF. */
+		DirectionConversions,
+		/** Timesteps that were not calculated because of the time stride or because they were finished earlier. */
+		CulledTimesteps,
+		ResponseCacheHits,
+		ResponseCacheMisses,
+		CounterCount
+	};
+
+	/**
+	 * Starts recording. Spans and counters are recorded from this point on,
+	 * and the times in the trace are relative to it.
+	 */
+	static void Enable();
+
+	static bool IsEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+	static void Count(Counter counter, uint64_t amount = 1)
+	{
+		if(IsEnabled())
+			_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+	}
+
+	static uint64_t CounterValue(Counter counter) { return _counters[counter].load(std::memory_order_relaxed); }
+
+	static const char* CounterName(Counter counter);
+
+	/**
+	 * Names the calling thread in the trace. Threads that are not named are
+	 * shown by their number.
+	 */
+	static void NameThread(const std::string& name);
+
+	/**
+	 * Writes the spans and counters recorded so far in the Chrome trace-event
+	 * format. Spans that are still open are not included.
+	 */
+	static void WriteChromeTrace(const std::string& filename);
+
+	/**
+	 * Prints per span name the number of spans, the total, average and longest
+	 * duration and the total as a percentage of the run time, followed by the
+	 * counters. Nested spans are included in the total of their parent.
+	 */
+	static void PrintSummary(std::ostream& stream);
+
+private:
+	friend class ProfileScope;
+
+	/** Nanoseconds since the profiler was enabled. */
+	static int64_t now();
+
+	static void record(const char* name, int64_t start, int64_t end);
+
+	static std::atomic<bool> _enabled;
+	static std::atomic<uint64_t> _counters[CounterCount];
+};
+
+/**
+ * Records the time between construction and destruction as a span. The name
+ * should be a string literal, as only the pointer is stored.
+ */
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name) :
+		_name(Profiler::IsEnabled() ? name : nullptr),
+		_start(_name ? Profiler::now() : 0)
+	{ }
+
+	~ProfileScope()
+	{
+		if(_name)
+			Profiler::record(_name, _start, Profiler::now());
+	}
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	const char* _name;
+	int64_t _start;
+};
+
+#endif
@@ -0,0 +1,569 @@
+/*
+ * Python extension module over the model reader and the batch response
+ * calculation of libsourceresponse.
+ *
+ * Results are calculated into buffers that are allocated by C++ and handed
+ * over to NumPy without copying: the arrays keep the buffers alive through
+ * a capsule that frees them when the array is destroyed. The GIL is released
+ * while files are read and responses are calculated.
+ */
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#define NPY_NO_DEPRECATED_API NPY_1_7_API_VERSION
+#include <numpy/arrayobject.h>
+
+#include "../beambackend.h"
+#include "../metadata.h"
+#include "../observation.h"
+#include "../responseengine.h"
+
+#include "../model/model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+
+	template<typename T>
+	void freeBuffer(PyObject* capsule)
+	{
+		delete[] static_cast<T*>(PyCapsule_GetPointer(capsule, nullptr));
+	}
+
+	/**
+	 * Wraps a buffer that was allocated with new[] in a NumPy array, which takes
+	 * ownership of it.
+	 */
+	template<typename T>
+	PyObject* wrapBuffer(std::unique_ptr<T[]> buffer, int typeNumber, int dimensionCount, npy_intp* dimensions)
+	{
+		PyObject* array = PyArray_SimpleNewFromData(dimensionCount, dimensions, typeNumber, buffer.get());
+		if(array == nullptr)
+			return nullptr;
+		PyObject* capsule = PyCapsule_New(buffer.get(), nullptr, freeBuffer<T>);
+		if(capsule == nullptr)
+		{
+			Py_DECREF(array);
+			return nullptr;
+		}
+		buffer.release();
+		// Steals the reference to capsule, also on failure
+		if(PyArray_SetBaseObject(reinterpret_cast<PyArrayObject*>(array), capsule) != 0)
+		{
+			Py_DECREF(array);
+			return nullptr;
+		}
+		return array;
+	}
+
+	/**
+	 * Converts a Python object to a contiguous one-dimensional double array.
+	 * NumPy arrays that already have this layout are not copied.
+	 */
+	PyArrayObject* asDoubleArray(PyObject* object)
+	{
+		return reinterpret_cast<PyArrayObject*>(PyArray_FROMANY(object, NPY_DOUBLE, 1, 1, NPY_ARRAY_IN_ARRAY));
+	}
+
+	struct ArrayRef
+	{
+		explicit ArrayRef(PyArrayObject* array) : _array(array) { }
+		~ArrayRef() { Py_XDECREF(_array); }
+		ArrayRef(const ArrayRef&) = delete;
+		ArrayRef& operator=(const ArrayRef&) = delete;
+		bool IsNull() const { return _array == nullptr; }
+		const double* Data() const { return static_cast<const double*>(PyArray_DATA(_array)); }
+		size_t Size() const { return PyArray_SIZE(_array); }
+	private:
+		PyArrayObject* _array;
+	};
+
+	/*
+	 * sourceresponse.Model
+	 */
+	struct ModelObject
+	{
+		PyObject_HEAD
+		Model* model;
+	};
+
+	int modelInit(ModelObject* self, PyObject* args, PyObject* kwargs)
+	{
+		static const char* keywords[] = { "filename", "lazy", nullptr };
+		const char* filename;
+		int lazy = 0;
+		if(!PyArg_ParseTupleAndKeywords(args, kwargs, "s|p", const_cast<char**>(keywords), &filename, &lazy))
+			return -1;
+		std::unique_ptr<Model> model;
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try {
+			model.reset(lazy ? new Model(Model::ReadIndex(filename)) : new Model(filename));
+		} catch(std::exception& e) {
+			error = e.what();
+		}
+		Py_END_ALLOW_THREADS
+		if(!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return -1;
+		}
+		delete self->model;
+		self->model = model.release();
+		return 0;
+	}
+
+	void modelDealloc(ModelObject* self)
+	{
+		PyTypeObject* type = Py_TYPE(self);
+		delete self->model;
+		type->tp_free(reinterpret_cast<PyObject*>(self));
+		Py_DECREF(type);
+	}
+
+	bool checkInitialized(const void* object, const char* typeName)
+	{
+		if(object == nullptr)
+		{
+			PyErr_Format(PyExc_RuntimeError, "%s is not initialized", typeName);
+			return false;
+		}
+		return true;
+	}
+
+	size_t componentCount(const Model& model)
+	{
+		size_t count = 0;
+		for(const ModelSource& source : model)
+			count += source.ComponentCount();
+		return count;
+	}
+
+	PyObject* modelNames(ModelObject* self, PyObject*)
+	{
+		if(!checkInitialized(self->model, "Model"))
+			return nullptr;
+		PyObject* list = PyList_New(0);
+		if(list == nullptr)
+			return nullptr;
+		for(const ModelSource& source : *self->model)
+		{
+			for(size_t i=0; i!=source.ComponentCount(); ++i)
+			{
+				PyObject* name = PyUnicode_FromStringAndSize(source.Name().data(), source.Name().size());
+				if(name == nullptr || PyList_Append(list, name) != 0)
+				{
+					Py_XDECREF(name);
+					Py_DECREF(list);
+					return nullptr;
+				}
+				Py_DECREF(name);
+			}
+		}
+		return list;
+	}
+
+	PyObject* modelPositions(ModelObject* self, PyObject*)
+	{
+		if(!checkInitialized(self->model, "Model"))
+			return nullptr;
+		npy_intp count = componentCount(*self->model);
+		std::unique_ptr<double[]> ra(new double[count]), dec(new double[count]);
+		size_t index = 0;
+		for(const ModelSource& source : *self->model)
+		{
+			for(size_t i=0; i!=source.ComponentCount(); ++i)
+			{
+				ra[index] = source.Component(i).PosRA();
+				dec[index] = source.Component(i).PosDec();
+				++index;
+			}
+		}
+		PyObject* raArray = wrapBuffer(std::move(ra), NPY_DOUBLE, 1, &count);
+		if(raArray == nullptr)
+			return nullptr;
+		PyObject* decArray = wrapBuffer(std::move(dec), NPY_DOUBLE, 1, &count);
+		if(decArray == nullptr)
+		{
+			Py_DECREF(raArray);
+			return nullptr;
+		}
+		return Py_BuildValue("NN", raArray, decArray);
+	}
+
+	PyObject* modelFluxes(ModelObject* self, PyObject* args)
+	{
+		if(!checkInitialized(self->model, "Model"))
+			return nullptr;
+		PyObject* frequencyObject;
+		if(!PyArg_ParseTuple(args, "O", &frequencyObject))
+			return nullptr;
+		ArrayRef frequencies(asDoubleArray(frequencyObject));
+		if(frequencies.IsNull())
+			return nullptr;
+		npy_intp dimensions[2] = { npy_intp(componentCount(*self->model)), npy_intp(frequencies.Size()) };
+		std::unique_ptr<double[]> fluxes(new double[dimensions[0] * dimensions[1]]);
+		// With a lazy model, the SEDs are parsed here, which can fail
+		try {
+			size_t index = 0;
+			for(const ModelSource& source : *self->model)
+			{
+				for(size_t i=0; i!=source.ComponentCount(); ++i)
+				{
+					const ModelComponent& component = source.Component(i);
+					if(!component.HasSED())
+						throw std::runtime_error("A component of source " + source.Name() + " has no SED");
+					for(size_t f=0; f!=frequencies.Size(); ++f)
+					{
+						fluxes[index] = std::fabs(component.SED().FluxAtFrequency(frequencies.Data()[f], aocommon::Polarization::StokesI));
+						++index;
+					}
+				}
+			}
+		} catch(std::exception& e) {
+			PyErr_SetString(PyExc_RuntimeError, e.what());
+			return nullptr;
+		}
+		return wrapBuffer(std::move(fluxes), NPY_DOUBLE, 2, dimensions);
+	}
+
+	PyMethodDef modelMethods[] = {
+		{ "names", reinterpret_cast<PyCFunction>(modelNames), METH_NOARGS,
+			"names()\n\nReturns a list with the source name of every component." },
+		{ "positions", reinterpret_cast<PyCFunction>(modelPositions), METH_NOARGS,
+			"positions()\n\nReturns a tuple (ra, dec) of arrays with the J2000 direction of every component in radians." },
+		{ "fluxes", reinterpret_cast<PyCFunction>(modelFluxes), METH_VARARGS,
+			"fluxes(frequencies)\n\nReturns a components x frequencies array with the Stokes I flux densities\nat the given frequencies in Hz." },
+		{ nullptr, nullptr, 0, nullptr }
+	};
+
+	PyType_Slot modelSlots[] = {
+		{ Py_tp_doc, const_cast<char*>("Model(filename, lazy=False)\n\nA sky model, read from a file in the ao model format. With lazy=True, the\nSEDs of the components are only parsed when they are used.") },
+		{ Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew) },
+		{ Py_tp_init, reinterpret_cast<void*>(modelInit) },
+		{ Py_tp_dealloc, reinterpret_cast<void*>(modelDealloc) },
+		{ Py_tp_methods, modelMethods },
+		{ 0, nullptr }
+	};
+
+	PyType_Spec modelSpec = { "sourceresponse.Model", sizeof(ModelObject), 0, Py_TPFLAGS_DEFAULT, modelSlots };
+
+	/*
+	 * sourceresponse.Observation
+	 */
+	struct ObservationState
+	{
+		MetaData metaData;
+		std::shared_ptr<const BeamBackend> beam;
+		/** The measurement set, or empty when the observation is a sidecar. */
+		std::string msFilename;
+	};
+
+	/**
+	 * The state is shared, so that a calculation that runs with the GIL
+	 * released keeps it alive when the object is initialized again meanwhile.
+	 */
+	struct ObservationObject
+	{
+		PyObject_HEAD
+		std::shared_ptr<const ObservationState>* state;
+	};
+
+	/** Returns the state of the observation, or nullptr with a Python error when it is not initialized. */
+	std::shared_ptr<const ObservationState> observationState(ObservationObject* self)
+	{
+		if(!checkInitialized(self->state, "Observation"))
+			return nullptr;
+		return *self->state;
+	}
+
+	int observationInit(ObservationObject* self, PyObject* args, PyObject* kwargs)
+	{
+		static const char* keywords[] = { "filename", "beam", nullptr };
+		const char* filename;
+		const char* beamName = nullptr;
+		if(!PyArg_ParseTupleAndKeywords(args, kwargs, "s|s", const_cast<char**>(keywords), &filename, &beamName))
+			return -1;
+		const std::string beamNameString = beamName ? beamName : BeamBackendNames().front();
+		std::unique_ptr<std::shared_ptr<const ObservationState>> state;
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try {
+			std::unique_ptr<casacore::MeasurementSet> ms;
+			MetaData metaData = ReadMetaData(filename, std::string(), ms);
+			StationCache stationCache(beamNameString);
+			std::shared_ptr<const BeamBackend> beam = ReadBeam(metaData, stationCache);
+			state.reset(new std::shared_ptr<const ObservationState>(new ObservationState{
+				std::move(metaData), std::move(beam), ms ? std::string(filename) : std::string() }));
+		} catch(std::exception& e) {
+			error = e.what();
+		}
+		Py_END_ALLOW_THREADS
+		if(!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return -1;
+		}
+		delete self->state;
+		self->state = state.release();
+		return 0;
+	}
+
+	void observationDealloc(ObservationObject* self)
+	{
+		PyTypeObject* type = Py_TYPE(self);
+		delete self->state;
+		type->tp_free(reinterpret_cast<PyObject*>(self));
+		Py_DECREF(type);
+	}
+
+	struct ResponseArguments
+	{
+		ResponseArguments() : field(0), ra(nullptr), dec(nullptr), times(nullptr), frequencies(nullptr) { }
+		std::shared_ptr<const ObservationState> state;
+		unsigned field;
+		std::unique_ptr<ArrayRef> ra, dec, times, frequencies;
+	};
+
+	bool parseResponseArguments(ObservationObject* self, PyObject* args, PyObject* kwargs, ResponseArguments& arguments, PyObject** fluxObject)
+	{
+		static const char* fluxKeywords[] = { "ra", "dec", "times", "frequencies", "fluxes", "field", nullptr };
+		static const char* jonesKeywords[] = { "ra", "dec", "times", "frequencies", "field", nullptr };
+		PyObject *raObject, *decObject, *timesObject, *frequenciesObject;
+		bool parsed = fluxObject ?
+			PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|OI", const_cast<char**>(fluxKeywords),
+				&raObject, &decObject, &timesObject, &frequenciesObject, fluxObject, &arguments.field) :
+			PyArg_ParseTupleAndKeywords(args, kwargs, "OOOO|I", const_cast<char**>(jonesKeywords),
+				&raObject, &decObject, &timesObject, &frequenciesObject, &arguments.field);
+		if(!parsed)
+			return false;
+		arguments.state = observationState(self);
+		if(!arguments.state)
+			return false;
+		if(arguments.field >= arguments.state->metaData.FieldCount())
+		{
+			PyErr_SetString(PyExc_IndexError, "Field index out of range");
+			return false;
+		}
+		arguments.ra.reset(new ArrayRef(asDoubleArray(raObject)));
+		arguments.dec.reset(new ArrayRef(asDoubleArray(decObject)));
+		arguments.times.reset(new ArrayRef(asDoubleArray(timesObject)));
+		arguments.frequencies.reset(new ArrayRef(asDoubleArray(frequenciesObject)));
+		if(arguments.ra->IsNull() || arguments.dec->IsNull() || arguments.times->IsNull() || arguments.frequencies->IsNull())
+			return false;
+		if(arguments.ra->Size() != arguments.dec->Size())
+		{
+			PyErr_SetString(PyExc_ValueError, "ra and dec must have the same size");
+			return false;
+		}
+		return true;
+	}
+
+	PyObject* observationApparentFluxes(ObservationObject* self, PyObject* args, PyObject* kwargs)
+	{
+		ResponseArguments arguments;
+		PyObject* fluxObject = Py_None;
+		if(!parseResponseArguments(self, args, kwargs, arguments, &fluxObject))
+			return nullptr;
+		const size_t directionCount = arguments.ra->Size(), timeCount = arguments.times->Size(), frequencyCount = arguments.frequencies->Size();
+		std::unique_ptr<ArrayRef> fluxes;
+		if(fluxObject != Py_None)
+		{
+			fluxes.reset(new ArrayRef(reinterpret_cast<PyArrayObject*>(PyArray_FROMANY(fluxObject, NPY_DOUBLE, 1, 2, NPY_ARRAY_IN_ARRAY))));
+			if(fluxes->IsNull())
+				return nullptr;
+			if(fluxes->Size() != directionCount * frequencyCount)
+			{
+				PyErr_SetString(PyExc_ValueError, "fluxes must have a value for every direction and frequency");
+				return nullptr;
+			}
+		}
+		npy_intp dimensions[3] = { npy_intp(directionCount), npy_intp(timeCount), npy_intp(frequencyCount) };
+		const size_t size = directionCount * timeCount * frequencyCount;
+		std::unique_ptr<double[]> maxFluxes(new double[size]), averageFluxes(new double[size]);
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try {
+			const MetaData& metaData = arguments.state->metaData;
+			ResponseEngine engine(arguments.state->beam, metaData.DelayDirection(arguments.field), metaData.TileBeamDirection(arguments.field));
+			engine.AddTimes(arguments.times->Data(), timeCount);
+			engine.ApparentFluxes(arguments.ra->Data(), arguments.dec->Data(), directionCount, 0, timeCount,
+				arguments.frequencies->Data(), frequencyCount, fluxes ? fluxes->Data() : nullptr, maxFluxes.get(), averageFluxes.get());
+		} catch(std::exception& e) {
+			error = e.what();
+		}
+		Py_END_ALLOW_THREADS
+		if(!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return nullptr;
+		}
+		PyObject* maxArray = wrapBuffer(std::move(maxFluxes), NPY_DOUBLE, 3, dimensions);
+		if(maxArray == nullptr)
+			return nullptr;
+		PyObject* averageArray = wrapBuffer(std::move(averageFluxes), NPY_DOUBLE, 3, dimensions);
+		if(averageArray == nullptr)
+		{
+			Py_DECREF(maxArray);
+			return nullptr;
+		}
+		return Py_BuildValue("NN", maxArray, averageArray);
+	}
+
+	PyObject* observationJones(ObservationObject* self, PyObject* args, PyObject* kwargs)
+	{
+		ResponseArguments arguments;
+		if(!parseResponseArguments(self, args, kwargs, arguments, nullptr))
+			return nullptr;
+		const size_t directionCount = arguments.ra->Size(), timeCount = arguments.times->Size(), frequencyCount = arguments.frequencies->Size();
+		const size_t stationCount = arguments.state->beam->StationCount();
+		npy_intp dimensions[6] = { npy_intp(directionCount), npy_intp(timeCount), npy_intp(frequencyCount), npy_intp(stationCount), 2, 2 };
+		std::unique_ptr<std::complex<double>[]> jones(new std::complex<double>[directionCount * timeCount * frequencyCount * stationCount * 4]);
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try {
+			const MetaData& metaData = arguments.state->metaData;
+			ResponseEngine engine(arguments.state->beam, metaData.DelayDirection(arguments.field), metaData.TileBeamDirection(arguments.field));
+			engine.AddTimes(arguments.times->Data(), timeCount);
+			engine.Jones(arguments.ra->Data(), arguments.dec->Data(), directionCount, 0, timeCount,
+				arguments.frequencies->Data(), frequencyCount, jones.get());
+		} catch(std::exception& e) {
+			error = e.what();
+		}
+		Py_END_ALLOW_THREADS
+		if(!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return nullptr;
+		}
+		return wrapBuffer(std::move(jones), NPY_COMPLEX128, 6, dimensions);
+	}
+
+	PyObject* observationTimes(ObservationObject* self, PyObject* args, PyObject* kwargs)
+	{
+		static const char* keywords[] = { "field", nullptr };
+		unsigned field = 0;
+		if(!PyArg_ParseTupleAndKeywords(args, kwargs, "|I", const_cast<char**>(keywords), &field))
+			return nullptr;
+		const std::shared_ptr<const ObservationState> state = observationState(self);
+		if(!state)
+			return nullptr;
+		if(field >= state->metaData.FieldCount())
+		{
+			PyErr_SetString(PyExc_IndexError, "Field index out of range");
+			return nullptr;
+		}
+		if(state->msFilename.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, "A sidecar file has no timesteps: open the measurement set instead");
+			return nullptr;
+		}
+		std::vector<double> times;
+		std::string error;
+		Py_BEGIN_ALLOW_THREADS
+		try {
+			casacore::MeasurementSet ms(state->msFilename);
+			times = std::move(ReadTimeIndex(ms, state->metaData, TimeSelection()).fieldTimes[field]);
+		} catch(std::exception& e) {
+			error = e.what();
+		}
+		Py_END_ALLOW_THREADS
+		if(!error.empty())
+		{
+			PyErr_SetString(PyExc_RuntimeError, error.c_str());
+			return nullptr;
+		}
+		npy_intp dimensions[1] = { npy_intp(times.size()) };
+		std::unique_ptr<double[]> buffer(new double[times.size()]);
+		std::copy(times.begin(), times.end(), buffer.get());
+		return wrapBuffer(std::move(buffer), NPY_DOUBLE, 1, dimensions);
+	}
+
+	PyObject* observationFieldCount(ObservationObject* self, PyObject*)
+	{
+		return PyLong_FromSize_t(self->state ? (*self->state)->metaData.FieldCount() : 0);
+	}
+
+	PyObject* observationStationCount(ObservationObject* self, PyObject*)
+	{
+		return PyLong_FromSize_t(self->state ? (*self->state)->beam->StationCount() : 0);
+	}
+
+	PyMethodDef observationMethods[] = {
+		{ "apparent_fluxes", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(observationApparentFluxes)), METH_VARARGS | METH_KEYWORDS,
+			"apparent_fluxes(ra, dec, times, frequencies, fluxes=None, field=0)\n\n"
+			"Returns a tuple (max, average) of directions x times x frequencies arrays\n"
+			"with the apparent flux densities: the largest eigenvalue of the individual\n"
+			"station responses and of the station-averaged response, multiplied with\n"
+			"the flux density. Directions are J2000 in radians, times in MJD seconds and\n"
+			"frequencies in Hz. fluxes holds the Stokes I flux density for every\n"
+			"direction and frequency; by default, unit flux density is used." },
+		{ "jones", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(observationJones)), METH_VARARGS | METH_KEYWORDS,
+			"jones(ra, dec, times, frequencies, field=0)\n\n"
+			"Returns a directions x times x frequencies x stations x 2 x 2 complex array\n"
+			"with the Jones matrices of the stations." },
+		{ "times", reinterpret_cast<PyCFunction>(reinterpret_cast<void(*)()>(observationTimes)), METH_VARARGS | METH_KEYWORDS,
+			"times(field=0)\n\n"
+			"Returns the times in MJD seconds of the timesteps of the field in the main\n"
+			"table of the measurement set, which can be passed to apparent_fluxes()." },
+		{ "field_count", reinterpret_cast<PyCFunction>(observationFieldCount), METH_NOARGS,
+			"field_count()\n\nNumber of fields of the observation." },
+		{ "station_count", reinterpret_cast<PyCFunction>(observationStationCount), METH_NOARGS,
+			"station_count()\n\nNumber of stations of the observation." },
+		{ nullptr, nullptr, 0, nullptr }
+	};
+
+	PyType_Slot observationSlots[] = {
+		{ Py_tp_doc, const_cast<char*>("Observation(filename, beam=None)\n\nThe station layouts and field directions of a measurement set or sidecar file.\nbeam selects the beam model, 'lofar' or 'analytic'; by default, the LOFAR beam is\nused when it is available.") },
+		{ Py_tp_new, reinterpret_cast<void*>(PyType_GenericNew) },
+		{ Py_tp_init, reinterpret_cast<void*>(observationInit) },
+		{ Py_tp_dealloc, reinterpret_cast<void*>(observationDealloc) },
+		{ Py_tp_methods, observationMethods },
+		{ 0, nullptr }
+	};
+
+	PyType_Spec observationSpec = { "sourceresponse.Observation", sizeof(ObservationObject), 0, Py_TPFLAGS_DEFAULT, observationSlots };
+
+	/** Adds a type, created from its spec, to the module. */
+	bool addType(PyObject* module, const char* name, PyType_Spec& spec)
+	{
+		PyObject* type = PyType_FromSpec(&spec);
+		if(type == nullptr)
+			return false;
+		if(PyModule_AddObject(module, name, type) != 0)
+		{
+			Py_DECREF(type);
+			return false;
+		}
+		return true;
+	}
+
+	PyModuleDef moduleDefinition = {
+		PyModuleDef_HEAD_INIT,
+		"sourceresponse",
+		"Beam responses of LOFAR observations towards sky model components.",
+		-1,
+		nullptr, nullptr, nullptr, nullptr, nullptr
+	};
+}
+
+PyMODINIT_FUNC PyInit_sourceresponse()
+{
+	import_array();
+
+	PyObject* module = PyModule_Create(&moduleDefinition);
+	if(module == nullptr)
+		return nullptr;
+	if(!addType(module, "Model", modelSpec) || !addType(module, "Observation", observationSpec))
+	{
+		Py_DECREF(module);
+		return nullptr;
+	}
+	return module;
+}
@@ -0,0 +1,322 @@
+#include "queryserver.h"
+
+#include "beamresponse.h"
+#include "directionconverter.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+	const char requestMagic[8] = { 'S', 'R', 'Q', 'U', 'E', 'R', 'Y', '1' };
+	const char replyMagic[8] = { 'S', 'R', 'R', 'E', 'P', 'L', 'Y', '1' };
+
+	// Limits that protect the server against requests that would make it run
+	// out of memory
+	const uint32_t maxQueryCount = 1 << 24;
+	const uint32_t maxStringTableSize = 1 << 28;
+
+	bool readAll(int fd, void* buffer, size_t size)
+	{
+		char* data = static_cast<char*>(buffer);
+		while(size != 0)
+		{
+			ssize_t n = read(fd, data, size);
+			if(n < 0 && errno == EINTR)
+				continue;
+			if(n <= 0)
+				return false;
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	bool writeAll(int fd, const void* buffer, size_t size)
+	{
+		const char* data = static_cast<const char*>(buffer);
+		while(size != 0)
+		{
+			ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+			if(n < 0 && errno == EINTR)
+				continue;
+			if(n <= 0)
+				return false;
+			data += n;
+			size -= n;
+		}
+		return true;
+	}
+
+	void writeError(int fd, const std::string& message)
+	{
+		QueryServer::ReplyHeader header = QueryServer::ReplyHeader();
+		std::copy(replyMagic, replyMagic+8, header.magic);
+		header.errorLength = message.size();
+		if(writeAll(fd, &header, sizeof(header)))
+			writeAll(fd, message.data(), message.size());
+	}
+}
+
+QueryServer::QueryServer(const std::string& socketPath, std::shared_ptr<const BeamBackend> beam, const std::vector<Field>& fields, const Model& model, size_t threadsPerClient) :
+	_socketPath(socketPath),
+	_socket(-1),
+	_beam(std::move(beam)),
+	_fields(fields),
+	_model(model),
+	_threadsPerClient(std::max<size_t>(1, threadsPerClient))
+{
+	// The lookups of the client threads are only thread safe once the indices are built
+	model.BuildIndices();
+
+	sockaddr_un address = sockaddr_un();
+	address.sun_family = AF_UNIX;
+	if(socketPath.size() >= sizeof(address.sun_path))
+		throw std::runtime_error("Socket path is too long: " + socketPath);
+	std::copy(socketPath.begin(), socketPath.end(), address.sun_path);
+	_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(_socket < 0)
+		throw std::runtime_error(std::string("Could not create socket: ") + strerror(errno));
+	unlink(socketPath.c_str());
+	if(bind(_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(_socket, 16) != 0)
+	{
+		const std::string error = strerror(errno);
+		close(_socket);
+		throw std::runtime_error("Could not listen on socket " + socketPath + ": " + error);
+	}
+}
+
+QueryServer::~QueryServer()
+{
+	close(_socket);
+	unlink(_socketPath.c_str());
+}
+
+void QueryServer::Run(const volatile std::sig_atomic_t& stop)
+{
+	while(!stop)
+	{
+		pollfd pollInfo = pollfd();
+		pollInfo.fd = _socket;
+		pollInfo.events = POLLIN;
+		// Wake up regularly to check the stop flag
+		int result = poll(&pollInfo, 1, 250);
+		removeFinishedClients();
+		if(result < 0 && errno != EINTR)
+			throw std::runtime_error(std::string("Error waiting for clients: ") + strerror(errno));
+		if(result <= 0)
+			continue;
+		int fd = accept(_socket, nullptr, nullptr);
+		if(fd < 0)
+			continue;
+		std::lock_guard<std::mutex> lock(_clientMutex);
+		_clients.emplace_back();
+		Client& client = _clients.back();
+		client.fd = fd;
+		client.finished = false;
+		client.thread = std::thread(&QueryServer::serveClient, this, std::ref(client));
+	}
+
+	// Unblock the clients that are waiting for a request
+	std::unique_lock<std::mutex> lock(_clientMutex);
+	for(Client& client : _clients)
+		shutdown(client.fd, SHUT_RDWR);
+	lock.unlock();
+	for(Client& client : _clients)
+		client.thread.join();
+	_clients.clear();
+}
+
+void QueryServer::removeFinishedClients()
+{
+	std::lock_guard<std::mutex> lock(_clientMutex);
+	std::list<Client>::iterator client = _clients.begin();
+	while(client != _clients.end())
+	{
+		if(client->finished)
+		{
+			client->thread.join();
+			client = _clients.erase(client);
+		}
+		else {
+			++client;
+		}
+	}
+}
+
+void QueryServer::serveClient(Client& client)
+{
+	aocommon::ParallelFor<size_t> loop(_threadsPerClient);
+	std::vector<QueryRecord> queries;
+	std::string strings;
+	std::vector<ResultRecord> results;
+	RequestHeader header;
+	while(readAll(client.fd, &header, sizeof(header)))
+	{
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		if(!std::equal(requestMagic, requestMagic+8, header.magic))
+		{
+			writeError(client.fd, "Invalid request");
+			break;
+		}
+		if(header.count > maxQueryCount || header.stringTableSize > maxStringTableSize)
+		{
+			writeError(client.fd, "Request is too large");
+			break;
+		}
+		queries.resize(header.count);
+		strings.resize(header.stringTableSize);
+		if(!readAll(client.fd, queries.data(), queries.size()*sizeof(QueryRecord)) ||
+			!readAll(client.fd, &strings[0], strings.size()))
+			break;
+		bool valid = true;
+		for(const QueryRecord& query : queries)
+			valid = valid && size_t(query.nameOffset) + query.nameLength <= strings.size();
+		if(!valid)
+		{
+			writeError(client.fd, "Source name outside string table");
+			break;
+		}
+
+		{
+			ProfileScope scope("query_request");
+			evaluate(queries, strings, results, loop);
+		}
+
+		ReplyHeader reply = ReplyHeader();
+		std::copy(replyMagic, replyMagic+8, reply.magic);
+		reply.count = results.size();
+		if(!writeAll(client.fd, &reply, sizeof(reply)) ||
+			!writeAll(client.fd, results.data(), results.size()*sizeof(ResultRecord)))
+			break;
+		addLatency(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+	close(client.fd);
+	client.finished = true;
+}
+
+void QueryServer::evaluate(const std::vector<QueryRecord>& queries, const std::string& strings, std::vector<ResultRecord>& results, aocommon::ParallelFor<size_t>& loop) const
+{
+	results.assign(queries.size(), ResultRecord());
+
+	// Queries with the same field and time share their direction conversions:
+	// sort them, and distribute the groups of equal field and time over the
+	// threads. A time that is not finite can not be ordered, so such queries
+	// are answered right away.
+	std::vector<size_t> order;
+	order.reserve(queries.size());
+	for(size_t i=0; i!=queries.size(); ++i)
+	{
+		if(std::isfinite(queries[i].time))
+			order.push_back(i);
+		else
+			results[i].status = InvalidTime;
+	}
+	std::sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+		return queries[a].field < queries[b].field ||
+			(queries[a].field == queries[b].field && queries[a].time < queries[b].time);
+	});
+	std::vector<size_t> groupStarts;
+	for(size_t i=0; i!=order.size(); ++i)
+	{
+		if(i == 0 || queries[order[i]].field != queries[order[i-1]].field || queries[order[i]].time != queries[order[i-1]].time)
+			groupStarts.push_back(i);
+	}
+	groupStarts.push_back(order.size());
+	if(order.empty())
+		return;
+
+	loop.Run(0, groupStarts.size()-1, [&](size_t group, size_t)
+	{
+		ProfileScope scope("query_group");
+		const QueryRecord& first = queries[order[groupStarts[group]]];
+		if(first.field >= _fields.size())
+		{
+			for(size_t i=groupStarts[group]; i!=groupStarts[group+1]; ++i)
+				results[order[i]].status = InvalidField;
+			return;
+		}
+		const Field& field = _fields[first.field];
+		DirectionConverter converter(first.time);
+		const BeamBackend::Vector3 station0 = converter.ToITRF(field.delayDirection);
+		const BeamBackend::Vector3 tile0 = converter.ToITRF(field.tileBeamDirection);
+
+		auto addGains = [&](double ra, double dec, double frequency, double flux, ResultRecord& result)
+		{
+			const BeamBackend::Vector3 itrfDirection = converter.J2000ToITRF(ra, dec);
+			double maxGain, averageGain;
+			stationGains(*_beam, first.time, frequency, itrfDirection, station0, tile0, maxGain, averageGain);
+			result.maxFlux += maxGain * flux;
+			result.averageFlux += averageGain * flux;
+		};
+
+		for(size_t i=groupStarts[group]; i!=groupStarts[group+1]; ++i)
+		{
+			const QueryRecord& query = queries[order[i]];
+			ResultRecord& result = results[order[i]];
+			if(query.nameLength == 0)
+			{
+				addGains(query.ra, query.dec, query.frequency, 1.0, result);
+			}
+			else {
+				const size_t sourceIndex = _model.FindSourceIndex(std::string_view(strings).substr(query.nameOffset, query.nameLength));
+				if(sourceIndex == Model::npos)
+				{
+					result.status = UnknownSource;
+					continue;
+				}
+				const ModelSource& modelSource = _model.Source(sourceIndex);
+				try {
+					for(size_t c=0; c!=modelSource.ComponentCount(); ++c)
+					{
+						const ModelComponent& component = modelSource.Component(c);
+						const double flux = std::fabs(component.SED().FluxAtFrequency(query.frequency, aocommon::Polarization::StokesI));
+						addGains(component.PosRA(), component.PosDec(), query.frequency, flux, result);
+					}
+				} catch(std::exception&) {
+					// A lazily read SED can not be parsed: an exception must not leave
+					// the worker thread, which would terminate the daemon
+					result = ResultRecord();
+					result.status = InvalidSED;
+				}
+			}
+		}
+	});
+}
+
+void QueryServer::addLatency(double seconds)
+{
+	std::lock_guard<std::mutex> lock(_latencyMutex);
+	_latencies.push_back(seconds);
+}
+
+void QueryServer::ReportLatencies(std::ostream& stream) const
+{
+	std::vector<double> latencies;
+	{
+		std::lock_guard<std::mutex> lock(_latencyMutex);
+		latencies = _latencies;
+	}
+	stream << "Requests: " << latencies.size();
+	if(!latencies.empty())
+	{
+		std::sort(latencies.begin(), latencies.end());
+		auto percentile = [&](double p) {
+			return latencies[std::min(latencies.size()-1, size_t(p * 0.01 * latencies.size()))] * 1e3;
+		};
+		stream << ", latency p50: " << percentile(50) << " ms, p90: " << percentile(90) << " ms, p99: "
+			<< percentile(99) << " ms, max: " << latencies.back() * 1e3 << " ms";
+	}
+	stream << '\n';
+}
@@ -0,0 +1,146 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include "beambackend.h"
+#include "model/model.h"
+
+#include <casacore/measures/Measures/MDirection.h>
+
+#include <aocommon/parallelfor.h>
+
+#include <atomic>
+#include <csignal>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Answers apparent-flux queries over a Unix domain socket, with the station
+ * objects and the model kept in memory between queries.
+ *
+ * A client sends requests and receives one reply per request, on the same
+ * connection. All values are in native byte order. A request consists of a
+ * @ref RequestHeader, followed by count @ref QueryRecord structures and a
+ * string table of stringTableSize bytes. A query asks for the apparent flux
+ * of a model source, given by a name in the string table, or of a 1 Jy
+ * source at the given RA and Dec when the name is empty. The reply consists
+ * of a @ref ReplyHeader, followed by either count @ref ResultRecord
+ * structures, or an error message of errorLength bytes when the request was
+ * invalid. After an error, the server closes the connection.
+ *
+ * Every client gets its own thread and its own pool of worker threads, over
+ * which the queries of a request are distributed.
+ */
+class QueryServer
+{
+public:
+	struct Field
+	{
+		casacore::MDirection delayDirection, tileBeamDirection;
+	};
+
+	struct RequestHeader
+	{
+		/** "SRQUERY1" */
+		char magic[8];
+		uint32_t count, stringTableSize;
+	};
+
+	struct QueryRecord
+	{
+		/** Time in MJD seconds. */
+		double time;
+		/** Frequency in Hz. */
+		double frequency;
+		/** J2000 direction in radians, used when nameLength is zero. */
+		double ra, dec;
+		/** Row in the FIELD table of the observation. */
+		uint32_t field;
+		/** Name of a model source in the string table. */
+		uint32_t nameOffset, nameLength;
+		uint32_t padding;
+	};
+
+	struct ReplyHeader
+	{
+		/** "SRREPLY1" */
+		char magic[8];
+		uint32_t count, errorLength;
+	};
+
+	/**
+	 * Result of a single query. InvalidSED is returned when the SED of a
+	 * component of the source can not be parsed, which is only found out when
+	 * the SED is first used, because the model is read lazily. InvalidTime is
+	 * returned for a time that is not a finite number.
+	 */
+	enum Status { Ok = 0, UnknownSource = 1, InvalidField = 2, InvalidSED = 3, InvalidTime = 4 };
+
+	struct ResultRecord
+	{
+		/**
+		 * Largest eigenvalue of the responses of the individual stations and of
+		 * the station-averaged response, multiplied with the Stokes I flux
+		 * density. For a source with several components, these are summed over
+		 * the components.
+		 */
+		double maxFlux, averageFlux;
+		uint32_t status;
+		uint32_t padding;
+	};
+
+	/**
+	 * Creates the socket. An existing file at socketPath is removed first.
+	 */
+	QueryServer(const std::string& socketPath, std::shared_ptr<const BeamBackend> beam, const std::vector<Field>& fields, const Model& model, size_t threadsPerClient);
+
+	~QueryServer();
+
+	QueryServer(const QueryServer&) = delete;
+	QueryServer& operator=(const QueryServer&) = delete;
+
+	/**
+	 * Accepts and serves clients until stop becomes non-zero, e.g. because it
+	 * is set by a signal handler. Returns after all clients were disconnected.
+	 */
+	void Run(const volatile std::sig_atomic_t& stop);
+
+	/**
+	 * Writes the number of requests and the 50th, 90th and 99th percentile and
+	 * maximum of the time spent on a request, from receiving it until sending
+	 * the reply.
+	 */
+	void ReportLatencies(std::ostream& stream) const;
+
+private:
+	struct Client
+	{
+		int fd;
+		std::atomic<bool> finished;
+		std::thread thread;
+	};
+
+	void serveClient(Client& client);
+	void evaluate(const std::vector<QueryRecord>& queries, const std::string& strings, std::vector<ResultRecord>& results, aocommon::ParallelFor<size_t>& loop) const;
+	void removeFinishedClients();
+	void addLatency(double seconds);
+
+	std::string _socketPath;
+	int _socket;
+	std::shared_ptr<const BeamBackend> _beam;
+	std::vector<Field> _fields;
+	const Model& _model;
+	size_t _threadsPerClient;
+
+	std::mutex _clientMutex;
+	std::list<Client> _clients;
+
+	mutable std::mutex _latencyMutex;
+	std::vector<double> _latencies;
+};
+
+#endif
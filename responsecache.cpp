@@ -0,0 +1,222 @@
+#include "responsecache.h"
+
+#include "hasher.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	const char cacheMagic[8] = { 'S', 'R', 'C', 'A', 'C', 'H', 'E', '1' };
+	const std::string cacheExtension = ".srcache";
+
+	struct CacheHeader
+	{
+		char magic[8];
+		uint64_t key;
+		uint64_t count;
+	};
+}
+
+ResponseCache::Entry::~Entry()
+{
+	munmap(_mapping, _mappingSize);
+}
+
+ResponseCache::ResponseCache(const std::string& directory, uint64_t sizeLimit) :
+	_directory(directory),
+	_sizeLimit(sizeLimit),
+	_hitCount(0),
+	_missCount(0),
+	_totalSize(0),
+	_storesSinceScan(0)
+{
+	if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+		throw std::runtime_error("Could not create cache directory " + directory + ": " + strerror(errno));
+	scan();
+}
+
+uint64_t ResponseCache::MakeKey(uint64_t observationKey, double frequency, double ra, double dec)
+{
+	Hasher hasher;
+	hasher.Add(observationKey);
+	hasher.Add(frequency);
+	hasher.Add(ra);
+	hasher.Add(dec);
+	return hasher.Value();
+}
+
+std::string ResponseCache::entryPath(uint64_t key) const
+{
+	char name[17];
+	snprintf(name, sizeof name, "%016llx", static_cast<unsigned long long>(key));
+	return _directory + '/' + name + cacheExtension;
+}
+
+std::unique_ptr<ResponseCache::Entry> ResponseCache::Find(uint64_t key) const
+{
+	std::unique_ptr<Entry> entry;
+	const std::string path = entryPath(key);
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd < 0)
+	{
+		++_missCount;
+		return entry;
+	}
+	struct stat fileStat;
+	if(fstat(fd, &fileStat) == 0 && size_t(fileStat.st_size) >= sizeof(CacheHeader))
+	{
+		size_t size = fileStat.st_size;
+		void* mapping = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+		if(mapping != MAP_FAILED)
+		{
+			const CacheHeader& header = *static_cast<const CacheHeader*>(mapping);
+			if(std::equal(cacheMagic, cacheMagic+8, header.magic) && header.key == key &&
+				size == sizeof(CacheHeader) + header.count*sizeof(Sample))
+			{
+				const Sample* samples = reinterpret_cast<const Sample*>(static_cast<const char*>(mapping) + sizeof(CacheHeader));
+				entry.reset(new Entry(mapping, size, samples, header.count));
+			}
+			else {
+				munmap(mapping, size);
+			}
+		}
+	}
+	close(fd);
+	if(entry)
+	{
+		// Mark as recently used
+		utimensat(AT_FDCWD, path.c_str(), nullptr, 0);
+		markUsed(key, entry->_mappingSize);
+		++_hitCount;
+	}
+	else {
+		++_missCount;
+	}
+	return entry;
+}
+
+void ResponseCache::Store(uint64_t key, const std::vector<Sample>& samples)
+{
+	const std::string path = entryPath(key);
+	// Write to a temporary file first, so that an interrupted write never
+	// leaves a truncated entry behind. The name is unique, because other
+	// processes may store the same entry in a shared cache directory.
+	std::string tempPath = path + ".XXXXXX";
+	const int fd = mkstemp(&tempPath[0]);
+	if(fd < 0)
+		throw std::runtime_error("Could not create cache entry " + tempPath + ": " + strerror(errno));
+	// mkstemp() makes the file private, while the entries of a shared cache are not
+	fchmod(fd, 0644);
+	close(fd);
+	CacheHeader header;
+	{
+		std::ofstream file(tempPath, std::ios::binary);
+		std::copy(cacheMagic, cacheMagic+8, header.magic);
+		header.key = key;
+		header.count = samples.size();
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(samples.data()), samples.size()*sizeof(Sample));
+		if(!file.good())
+		{
+			std::remove(tempPath.c_str());
+			throw std::runtime_error("Could not write cache entry " + tempPath);
+		}
+	}
+	if(std::rename(tempPath.c_str(), path.c_str()) != 0)
+	{
+		std::remove(tempPath.c_str());
+		throw std::runtime_error("Could not rename cache entry " + tempPath + ": " + strerror(errno));
+	}
+	markUsed(key, sizeof(CacheHeader) + samples.size()*sizeof(Sample));
+	++_storesSinceScan;
+	if(_storesSinceScan >= rescanInterval)
+		scan();
+	evict();
+}
+
+void ResponseCache::scan()
+{
+	struct FileInfo
+	{
+		uint64_t key;
+		uint64_t size;
+		struct timespec lastUse;
+	};
+	std::vector<FileInfo> files;
+
+	DIR* dir = opendir(_directory.c_str());
+	if(dir == nullptr)
+		throw std::runtime_error("Could not open cache directory " + _directory);
+	while(struct dirent* dirEntry = readdir(dir))
+	{
+		const std::string name(dirEntry->d_name);
+		// Only entries, named by their key, and not the temporary files
+		if(name.size() == 16 + cacheExtension.size() &&
+			name.compare(16, cacheExtension.size(), cacheExtension) == 0 &&
+			name.find_first_not_of("0123456789abcdef") == 16)
+		{
+			FileInfo info;
+			info.key = std::strtoull(name.substr(0, 16).c_str(), nullptr, 16);
+			struct stat fileStat;
+			if(stat((_directory + '/' + name).c_str(), &fileStat) == 0)
+			{
+				info.size = fileStat.st_size;
+				info.lastUse = fileStat.st_mtim;
+				files.push_back(info);
+			}
+		}
+	}
+	closedir(dir);
+
+	std::sort(files.begin(), files.end(), [](const FileInfo& a, const FileInfo& b) {
+		return a.lastUse.tv_sec < b.lastUse.tv_sec ||
+			(a.lastUse.tv_sec == b.lastUse.tv_sec && a.lastUse.tv_nsec < b.lastUse.tv_nsec);
+	});
+	_useOrder.clear();
+	_entries.clear();
+	_totalSize = 0;
+	for(const FileInfo& file : files)
+		markUsed(file.key, file.size);
+	_storesSinceScan = 0;
+}
+
+void ResponseCache::markUsed(uint64_t key, uint64_t size) const
+{
+	std::unordered_map<uint64_t, EntryInfo>::iterator entry = _entries.find(key);
+	if(entry == _entries.end())
+	{
+		_useOrder.push_back(key);
+		_entries.emplace(key, EntryInfo{size, std::prev(_useOrder.end())});
+		_totalSize += size;
+	}
+	else {
+		_useOrder.splice(_useOrder.end(), _useOrder, entry->second.use);
+		_totalSize = _totalSize - entry->second.size + size;
+		entry->second.size = size;
+	}
+}
+
+void ResponseCache::evict()
+{
+	while(_totalSize > _sizeLimit && !_useOrder.empty())
+	{
+		const uint64_t key = _useOrder.front();
+		// The entry may already have been removed by another process
+		unlink(entryPath(key).c_str());
+		_totalSize -= _entries[key].size;
+		_entries.erase(key);
+		_useOrder.pop_front();
+	}
+}
@@ -0,0 +1,120 @@
+#ifndef RESPONSE_CACHE_H
+#define RESPONSE_CACHE_H
+
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * On-disk cache of beam-response time series. Every entry holds the
+ * response of a single direction for a full observation, and is stored in
+ * its own file inside the cache directory. Entries are identified by a key,
+ * which is supposed to combine the meta data of the observation, the
+ * frequency setup and the direction (see @ref MakeKey()).
+ *
+ * Values are stored for a unit flux density, so that an entry can be reused
+ * when only the SED of a component changes. Entries are memory mapped when
+ * they are read. When storing a new entry would make the cache exceed its
+ * size limit, the least recently used entries are removed. The time of last
+ * use is stored as the modification time of the entry files.
+ *
+ * The directory is scanned when the cache is opened, after which the sizes
+ * and the order of use of the entries are tracked in memory, so that a
+ * store does not list the directory. Entries that other processes store
+ * in the same directory are only seen when they are found, and by rescans
+ * after every rescanInterval stores.
+ */
+class ResponseCache
+{
+public:
+	struct Sample
+	{
+		/** Time in seconds since the start of the observation. */
+		double time;
+		/** Largest eigenvalue of the responses of the individual stations. */
+		double maxGain;
+		/** Largest eigenvalue of the station-averaged response. */
+		double averageGain;
+	};
+
+	/**
+	 * A read-only, memory-mapped cache entry. The entry stays valid until it
+	 * is destructed, even when it is evicted from the cache in the meantime.
+	 */
+	class Entry
+	{
+	public:
+		~Entry();
+		Entry(const Entry&) = delete;
+		Entry& operator=(const Entry&) = delete;
+
+		const Sample* begin() const { return _samples; }
+		const Sample* end() const { return _samples + _count; }
+		size_t size() const { return _count; }
+
+	private:
+		friend class ResponseCache;
+		Entry(void* mapping, size_t mappingSize, const Sample* samples, size_t count) :
+			_mapping(mapping), _mappingSize(mappingSize), _samples(samples), _count(count)
+		{ }
+
+		void* _mapping;
+		size_t _mappingSize;
+		const Sample* _samples;
+		size_t _count;
+	};
+
+	/**
+	 * @param directory Directory in which the entries are stored. It is
+	 * created when it does not exist.
+	 * @param sizeLimit Maximum total size of all entries in bytes.
+	 */
+	ResponseCache(const std::string& directory, uint64_t sizeLimit);
+
+	/**
+	 * Combine the key of an observation with a frequency and a J2000 direction.
+	 */
+	static uint64_t MakeKey(uint64_t observationKey, double frequency, double ra, double dec);
+
+	/**
+	 * Look up an entry. Returns an empty pointer when the entry is not
+	 * available or when it is corrupt.
+	 */
+	std::unique_ptr<Entry> Find(uint64_t key) const;
+
+	void Store(uint64_t key, const std::vector<Sample>& samples);
+
+	size_t HitCount() const { return _hitCount; }
+	size_t MissCount() const { return _missCount; }
+
+	static constexpr size_t rescanInterval = 1024;
+
+private:
+	struct EntryInfo
+	{
+		uint64_t size;
+		/** Position of the entry in _useOrder. */
+		std::list<uint64_t>::iterator use;
+	};
+
+	std::string entryPath(uint64_t key) const;
+	/** Reads the entries in the directory, replacing the tracked entries. */
+	void scan();
+	/** Makes the entry the most recently used one, and starts tracking it when it is not tracked. */
+	void markUsed(uint64_t key, uint64_t size) const;
+	void evict();
+
+	std::string _directory;
+	uint64_t _sizeLimit;
+	mutable size_t _hitCount, _missCount;
+	/** Keys of the tracked entries, least recently used first. */
+	mutable std::list<uint64_t> _useOrder;
+	mutable std::unordered_map<uint64_t, EntryInfo> _entries;
+	mutable uint64_t _totalSize;
+	size_t _storesSinceScan;
+};
+
+#endif
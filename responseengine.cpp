@@ -0,0 +1,128 @@
+#include "responseengine.h"
+
+#include "beamresponse.h"
+#include "directionconverter.h"
+#include "profiler.h"
+
+#include <cmath>
+#include <utility>
+
+namespace {
+	/**
+	 * Orthonormal J2000 axes that all make an angle of 35 degrees with the
+	 * ecliptic. The directions along them stay far from the Sun, so that the
+	 * deflection of light by the Sun does not affect the conversion that is
+	 * derived from them.
+	 */
+	std::array<BeamBackend::Vector3, 3> eclipticTiltedAxes()
+	{
+		const double obliquity = 23.439 * M_PI / 180.0;
+		const double pole[3] = { 0.0, -std::sin(obliquity), std::cos(obliquity) };
+		const double equinox[3] = { 1.0, 0.0, 0.0 };
+		const double solstice[3] = { 0.0, std::cos(obliquity), std::sin(obliquity) };
+		std::array<BeamBackend::Vector3, 3> axes;
+		for(size_t axis=0; axis!=3; ++axis)
+		{
+			const double angle = axis * 2.0 * M_PI / 3.0;
+			for(size_t i=0; i!=3; ++i)
+				axes[axis][i] = pole[i] / std::sqrt(3.0) + std::sqrt(2.0 / 3.0) * (std::cos(angle) * equinox[i] + std::sin(angle) * solstice[i]);
+		}
+		return axes;
+	}
+}
+
+ResponseEngine::ResponseEngine(std::shared_ptr<const BeamBackend> beam, const casacore::MDirection& delayDirection, const casacore::MDirection& tileBeamDirection) :
+	_beam(std::move(beam)),
+	_delayDirection(delayDirection),
+	_tileBeamDirection(tileBeamDirection)
+{ }
+
+void ResponseEngine::AddTimes(const double* times, size_t count)
+{
+	ProfileScope scope("direction_conversion");
+	const std::array<BeamBackend::Vector3, 3> axes = eclipticTiltedAxes();
+	for(size_t i=0; i!=count; ++i)
+	{
+		DirectionConverter converter(times[i]);
+		_times.push_back(times[i]);
+		_itrfDelayDirections.push_back(converter.ToITRF(_delayDirection));
+		_itrfTileBeamDirections.push_back(converter.ToITRF(_tileBeamDirection));
+		// Aberration moves a direction n to about n + v, with v the velocity of the
+		// observer in units of c. The images of an axis a and its opposite are then
+		// R a + v_a and -R a + v_a, with v_a the part of v perpendicular to R a, so
+		// their difference gives the rotation R and their sum over the axes 2 v.
+		J2000Transform transform;
+		transform.matrix.fill(0.0);
+		transform.offset.fill(0.0);
+		for(const BeamBackend::Vector3& axis : axes)
+		{
+			const double ra = std::atan2(axis[1], axis[0]), dec = std::asin(axis[2]);
+			const BeamBackend::Vector3
+				image = converter.J2000ToITRF(ra, dec),
+				opposite = converter.J2000ToITRF(ra + M_PI, -dec);
+			for(size_t row=0; row!=3; ++row)
+			{
+				const double rotatedAxis = 0.5 * (image[row] - opposite[row]);
+				for(size_t column=0; column!=3; ++column)
+					transform.matrix[row*3 + column] += rotatedAxis * axis[column];
+				transform.offset[row] += 0.25 * (image[row] + opposite[row]);
+			}
+		}
+		_j2000ToITRF.push_back(transform);
+	}
+}
+
+BeamBackend::Vector3 ResponseEngine::toITRF(const J2000Transform& transform, double ra, double dec)
+{
+	const double cosDec = std::cos(dec);
+	const double j2000[3] = { cosDec * std::cos(ra), cosDec * std::sin(ra), std::sin(dec) };
+	BeamBackend::Vector3 itrf;
+	for(size_t row=0; row!=3; ++row)
+		itrf[row] = transform.matrix[row*3] * j2000[0] + transform.matrix[row*3 + 1] * j2000[1] + transform.matrix[row*3 + 2] * j2000[2] + transform.offset[row];
+	const double norm = std::sqrt(itrf[0]*itrf[0] + itrf[1]*itrf[1] + itrf[2]*itrf[2]);
+	for(double& value : itrf)
+		value /= norm;
+	return itrf;
+}
+
+void ResponseEngine::Jones(const double* ra, const double* dec, size_t directionCount, size_t startTimestep, size_t endTimestep, const double* frequencies, size_t frequencyCount, std::complex<double>* jones) const
+{
+	const size_t timeCount = endTimestep - startTimestep;
+	const size_t stationCount = _beam->StationCount();
+	Profiler::Count(Profiler::ResponseCalls, directionCount * timeCount * frequencyCount * stationCount);
+	for(size_t timestep=startTimestep; timestep!=endTimestep; ++timestep)
+	{
+		const double time = _times[timestep];
+		for(size_t d=0; d!=directionCount; ++d)
+		{
+			const BeamBackend::Vector3 itrfDirection = toITRF(_j2000ToITRF[timestep], ra[d], dec[d]);
+			std::complex<double>* matrices = jones +
+				((d * timeCount + (timestep - startTimestep)) * frequencyCount * stationCount) * 4;
+			_beam->Responses(time, frequencies, frequencyCount, itrfDirection,
+				_itrfDelayDirections[timestep], _itrfTileBeamDirections[timestep], matrices);
+		}
+	}
+}
+
+void ResponseEngine::ApparentFluxes(const double* ra, const double* dec, size_t directionCount, size_t startTimestep, size_t endTimestep, const double* frequencies, size_t frequencyCount, const double* fluxes, double* maxFluxes, double* averageFluxes) const
+{
+	const size_t timeCount = endTimestep - startTimestep;
+	for(size_t timestep=startTimestep; timestep!=endTimestep; ++timestep)
+	{
+		const double time = _times[timestep];
+		for(size_t d=0; d!=directionCount; ++d)
+		{
+			const BeamBackend::Vector3 itrfDirection = toITRF(_j2000ToITRF[timestep], ra[d], dec[d]);
+			for(size_t f=0; f!=frequencyCount; ++f)
+			{
+				const size_t index = (d * timeCount + (timestep - startTimestep)) * frequencyCount + f;
+				double maxGain, averageGain;
+				stationGains(*_beam, time, frequencies[f], itrfDirection,
+					_itrfDelayDirections[timestep], _itrfTileBeamDirections[timestep], maxGain, averageGain);
+				const double flux = fluxes ? fluxes[d * frequencyCount + f] : 1.0;
+				maxFluxes[index] = maxGain * flux;
+				averageFluxes[index] = averageGain * flux;
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef RESPONSE_ENGINE_H
+#define RESPONSE_ENGINE_H
+
+#include "beambackend.h"
+
+#include <casacore/measures/Measures/MDirection.h>
+
+#include <array>
+#include <complex>
+#include <memory>
+#include <vector>
+
+/**
+ * Calculates beam responses of a set of stations for one field, in batches,
+ * with one of the beam backends.
+ * The timesteps are added beforehand, at which point the delay and tile
+ * beam directions are converted to ITRF, and the J2000 to ITRF conversion
+ * is approximated by a rotation and an offset; these are reused by all
+ * later calculations. The rotation and offset describe precession,
+ * nutation, the rotation of the Earth and aberration to first order in the
+ * velocity of the observer. Only the deflection of light by the Sun is
+ * ignored, so that directions differ from those of casacore by less than
+ * 0.1 arcseconds more than 20 degrees from the Sun, and by at most 1.75
+ * arcseconds at its limb, far below the scale of the beam.
+ *
+ * The calculation functions fill caller-provided arrays, do not allocate
+ * memory and do not perform any file I/O: they only do arithmetic and call
+ * the beam backend. They are const and can be called
+ * concurrently from several threads. Results are stored with the direction
+ * as slowest varying index, followed by the timestep and the frequency.
+ */
+class ResponseEngine
+{
+public:
+	ResponseEngine(std::shared_ptr<const BeamBackend> beam, const casacore::MDirection& delayDirection, const casacore::MDirection& tileBeamDirection);
+
+	/**
+	 * Adds timesteps, given in MJD seconds.
+	 */
+	void AddTimes(const double* times, size_t count);
+
+	size_t TimeCount() const { return _times.size(); }
+
+	double Time(size_t timestep) const { return _times[timestep]; }
+
+	size_t StationCount() const { return _beam->StationCount(); }
+
+	/**
+	 * Calculates the Jones matrix of every station for every combination of
+	 * direction, timestep in the range [startTimestep, endTimestep) and
+	 * frequency. Directions are J2000 in radians, frequencies in Hz.
+	 * @param jones Array of directionCount x (endTimestep - startTimestep) x
+	 * frequencyCount x StationCount() matrices of 4 elements each, in
+	 * row-major order.
+	 */
+	void Jones(const double* ra, const double* dec, size_t directionCount, size_t startTimestep, size_t endTimestep, const double* frequencies, size_t frequencyCount, std::complex<double>* jones) const;
+
+	/**
+	 * Calculates the apparent flux density for every combination of
+	 * direction, timestep in the range [startTimestep, endTimestep) and
+	 * frequency. The maximum flux is the largest eigenvalue of the responses of
+	 * the individual stations, and the average flux the largest eigenvalue of
+	 * the station-averaged response, multiplied with the flux density.
+	 * @param fluxes Stokes I flux density for every direction and frequency
+	 * (directionCount x frequencyCount), or nullptr to use unit flux density.
+	 * @param maxFluxes Array of directionCount x (endTimestep - startTimestep)
+	 * x frequencyCount values.
+	 * @param averageFluxes Array of the same size as maxFluxes.
+	 */
+	void ApparentFluxes(const double* ra, const double* dec, size_t directionCount, size_t startTimestep, size_t endTimestep, const double* frequencies, size_t frequencyCount, const double* fluxes, double* maxFluxes, double* averageFluxes) const;
+
+private:
+	/**
+	 * The conversion of J2000 unit vectors to ITRF at one timestep: a vector
+	 * is multiplied with the matrix, the offset is added and the result is
+	 * normalised.
+	 */
+	struct J2000Transform
+	{
+		/** Row-major rotation matrix. */
+		std::array<double, 9> matrix;
+		/** The aberration, i.e. the velocity of the observer in units of c. */
+		BeamBackend::Vector3 offset;
+	};
+
+	static BeamBackend::Vector3 toITRF(const J2000Transform& transform, double ra, double dec);
+
+	std::shared_ptr<const BeamBackend> _beam;
+	casacore::MDirection _delayDirection, _tileBeamDirection;
+	std::vector<double> _times;
+	std::vector<BeamBackend::Vector3> _itrfDelayDirections, _itrfTileBeamDirections;
+	std::vector<J2000Transform> _j2000ToITRF;
+};
+
+#endif
@@ -0,0 +1,59 @@
+#include "responseoutput.h"
+
+#include "model/modelsource.h"
+
+#include <sstream>
+
+std::string ComponentName(const ModelSource& source, size_t component)
+{
+	return (source.ComponentCount()!=1) ? source.Name() + "_" + std::to_string(component) : source.Name();
+}
+
+std::string OutputName(const std::string& componentName, const ObservationInfo& info, const FieldInfo& field, double frequency)
+{
+	std::ostringstream name;
+	name << componentName;
+	if(info.fieldCount != 1)
+		name << "_field" << field.index;
+	if(field.frequencies.size() != 1)
+		name << '_' << frequency*1e-6 << "MHz";
+	return name.str();
+}
+
+std::string FormatSamples(const ResponseCache::Sample* begin, const ResponseCache::Sample* end, double stokesI)
+{
+	std::ostringstream text;
+	for(const ResponseCache::Sample* sample = begin; sample != end; ++sample)
+		text << (sample->time/3600.0) << '\t' << (sample->maxGain*stokesI) << '\t' << (sample->averageGain*stokesI) << '\n';
+	return text.str();
+}
+
+void PlotScript::Open(const std::string& directory, const std::string& name, int column)
+{
+	_file.open(directory + name + ".plt");
+	_column = column;
+	_isEmpty = true;
+	_file <<
+		"set terminal pdfcairo enhanced color font 'Times,16'\n"
+		"#set logscale xy\n"
+		"#set yrange [0.1:]\n"
+		"set output \"" << name << ".pdf\"\n"
+		"set key above\n"
+		"set xlabel \"Time (h)\"\n"
+		"set ylabel \"Apparent flux (Jy)\"\n"
+		"plot \\\n";
+}
+
+void PlotScript::AddOutput(const std::string& outputName)
+{
+	if(!_isEmpty)
+		_file << ",\\\n";
+	_isEmpty = false;
+	_file << '"' << outputName << ".txt\" using 1:" << _column << " with lines title '" << outputName << "' lw 2";
+}
+
+void PlotScript::Close()
+{
+	_file << "\n";
+	_file.close();
+}
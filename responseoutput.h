@@ -0,0 +1,64 @@
+#ifndef RESPONSE_OUTPUT_H
+#define RESPONSE_OUTPUT_H
+
+#include "observation.h"
+#include "responsecache.h"
+
+#include <fstream>
+#include <string>
+
+class ModelSource;
+
+/**
+ * The output files of sourceresponse: a text file per combination of
+ * component, field and frequency with the time in hours and the maximum
+ * and average apparent flux of every timestep, and gnuplot scripts that plot
+ * all of them. These are used by the sourceresponse executable and the
+ * end-to-end benchmark, and are not part of the library.
+ */
+
+/**
+ * Name of a component: the name of its source, with the component index
+ * when the source has several components.
+ */
+std::string ComponentName(const ModelSource& source, size_t component);
+
+/**
+ * Name of the output of a component, which includes the field and the
+ * frequency when the observation has several of them. The output file is
+ * named after it, with the extension ".txt".
+ */
+std::string OutputName(const std::string& componentName, const ObservationInfo& info, const FieldInfo& field, double frequency);
+
+/**
+ * The lines of an output file for the given samples, with the gains
+ * multiplied with the Stokes I flux density of the component.
+ */
+std::string FormatSamples(const ResponseCache::Sample* begin, const ResponseCache::Sample* end, double stokesI);
+
+/**
+ * A gnuplot script that plots a column of all outputs that are added to it.
+ */
+class PlotScript
+{
+public:
+	PlotScript() : _column(0), _isEmpty(true)
+	{ }
+
+	/**
+	 * Starts the script directory + name + ".plt", which plots column 2
+	 * (maximum flux) or 3 (average flux) of the outputs to name + ".pdf".
+	 */
+	void Open(const std::string& directory, const std::string& name, int column);
+
+	void AddOutput(const std::string& outputName);
+
+	void Close();
+
+private:
+	std::ofstream _file;
+	int _column;
+	bool _isEmpty;
+};
+
+#endif
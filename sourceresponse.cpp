@@ -1,147 +1,909 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <functional>
 #include <iostream>
 #include <fstream>
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <thread>
 
-#include "model/model.h"
+#include <sys/stat.h>
+#include <unistd.h>
 
-#include <casacore/measures/TableMeasures/ArrayMeasColumn.h>
-#include <casacore/measures/Measures/MEpoch.h>
+#include "beambackend.h"
+#include "checkpoint.h"
+#include "hasher.h"
+#include "metadata.h"
+#include "observation.h"
+#include "profiler.h"
+#include "queryserver.h"
+#include "responsecache.h"
+#include "responseengine.h"
+#include "responseoutput.h"
 
-#include <StationResponse/LofarMetaDataUtil.h>
-#include <StationResponse/ITRFConverter.h>
+#include "model/model.h"
+#include "model/modelreader.h"
+#include "model/modelview.h"
 
-#include <aocommon/banddata.h>
-#include <aocommon/matrix2x2.h>
+#include <casacore/casa/Quanta/MVTime.h>
 
-using aocommon::MC2x2;
+#include <aocommon/lane.h>
 
-void dirToITRF(LOFAR::StationResponse::ITRFConverter& converter, const casacore::MDirection& dir, LOFAR::StationResponse::vector3r_t& itrf)
+double parseTime(const std::string& str)
 {
-	casacore::MDirection itrfDir = converter.toDirection(dir);
-	casacore::Vector<double> itrfVal = itrfDir.getValue().getValue();
-	itrf[0] = itrfVal[0];
-	itrf[1] = itrfVal[1];
-	itrf[2] = itrfVal[2];
+  casacore::Quantity time;
+  if(!casacore::MVTime::read(time, str))
+    throw std::runtime_error("Could not parse time '" + str + "'");
+  return time.getValue("s");
 }
 
-void sourceResponse(const std::string& msFilename, const ModelComponent& source, const std::string& filename)
-{
-  casacore::MeasurementSet ms(msFilename);
-  
-  aocommon::BandData band(ms.spectralWindow());
-  double subbandFrequency = band.CentreFrequency();
-  
-  casacore::MSField fieldTable(ms.field());
-  if(fieldTable.nrow() != 1)
-    throw std::runtime_error("Set has multiple fields");
-  casacore::ScalarMeasColumn<casacore::MDirection> delayDirColumn(fieldTable, casacore::MSField::columnName(casacore::MSFieldEnums::DELAY_DIR));
-  casacore::MDirection delayDir = delayDirColumn(0);
-  
-  casacore::MDirection tileBeamDir;
-  if(fieldTable.tableDesc().isColumn("LOFAR_TILE_BEAM_DIR")) {
-    casacore::ROArrayMeasColumn<casacore::MDirection> tileBeamDirColumn(fieldTable, "LOFAR_TILE_BEAM_DIR");
-    tileBeamDir = *(tileBeamDirColumn(0).data());
-  } else {
-    tileBeamDir = delayDir;
-  }
-  std::vector<LOFAR::StationResponse::Station::Ptr> stations(ms.antenna().nrow());
-  readStations(ms, stations.begin());
-  
-  casacore::MEpoch::ScalarColumn timeColumn(ms, ms.columnName(casacore::MSMainEnums::TIME));
-  double startTime = timeColumn(0).getValue().get()*86400.0;
-  double prevTime = startTime - 1.0;
-  
-  std::ofstream file(filename);
-  for(size_t row=0; row!=ms.nrow(); ++row)
-  {
-    casacore::MEpoch time = timeColumn(row);
-    double timeAsDouble = time.getValue().get()*86400.0;
-    if(timeAsDouble != prevTime)
-    {
-      prevTime = timeAsDouble;
-      LOFAR::StationResponse::ITRFConverter itrfConverter(timeAsDouble);
-      
-      LOFAR::StationResponse::vector3r_t station0, tile0;
-      dirToITRF(itrfConverter, delayDir, station0);
-      dirToITRF(itrfConverter, tileBeamDir, tile0);
-      
-      LOFAR::StationResponse::vector3r_t itrfDirection;
-      static const casacore::Unit radUnit("rad");
-      casacore::MDirection sourceDir(casacore::MVDirection(
-        casacore::Quantity(source.PosRA(), radUnit),
-        casacore::Quantity(source.PosDec(),radUnit)),
-        casacore::MDirection::J2000);
-      
-      double stokesI = source.SED().FluxAtFrequency(subbandFrequency, aocommon::Polarization::StokesI);
-
-      dirToITRF(itrfConverter, sourceDir, itrfDirection);
-      MC2x2 response = MC2x2::Zero();
-      size_t count = 0;
-      double maxEigenValue = 0.0;
-      for(size_t station=0; station!=stations.size(); ++station)
+/**
+ * Calculates the response towards the direction of the source for unit
+ * flux density at each of the given frequencies, starting at the given
+ * timestep of the field. The samples are passed to the callback function in
+ * blocks of at most blockSize timesteps, with one block per frequency.
+ */
+void calculateResponse(const ModelComponent& source, const FieldInfo& field, const std::vector<double>& frequencies, size_t startTimestep, size_t blockSize, const std::function<void(size_t, const std::vector<std::vector<ResponseCache::Sample>>&)>& onBlock)
+{
+  if(startTimestep >= field.times.size())
+    return;
+  
+  const double ra = source.PosRA(), dec = source.PosDec();
+  const double startTime = field.times.front();
+  const size_t frequencyCount = frequencies.size();
+  std::vector<double> maxGains(blockSize * frequencyCount), averageGains(blockSize * frequencyCount);
+  std::vector<std::vector<ResponseCache::Sample>> blocks(frequencyCount);
+  for(size_t blockStart=startTimestep; blockStart < field.times.size(); blockStart += blockSize)
+  {
+    const size_t blockEnd = std::min(blockStart + blockSize, field.times.size());
+    {
+      ProfileScope scope("response_evaluation");
+      field.engine->ApparentFluxes(&ra, &dec, 1, blockStart, blockEnd, frequencies.data(), frequencyCount, nullptr, maxGains.data(), averageGains.data());
+    }
+    for(size_t f=0; f!=frequencyCount; ++f)
+    {
+      blocks[f].resize(blockEnd - blockStart);
+      for(size_t t=0; t!=blockEnd - blockStart; ++t)
       {
-        LOFAR::StationResponse::matrix22c_t gainMatrix =
-          stations[station]->response(timeAsDouble, subbandFrequency, itrfDirection, subbandFrequency, station0, tile0);
-        
-        MC2x2 stationResponse( gainMatrix[0][0], gainMatrix[0][1], gainMatrix[1][0], gainMatrix[1][1] );
-        response += stationResponse;
-        ++count;
-        std::complex<double> e1,e2;
-        (stationResponse * stokesI).EigenValues(e1, e2);
-        maxEigenValue = std::max(maxEigenValue, std::max(std::abs(e1), std::abs(e2)));
+        ResponseCache::Sample& sample = blocks[f][t];
+        sample.time = field.times[blockStart + t] - startTime;
+        sample.maxGain = maxGains[t * frequencyCount + f];
+        sample.averageGain = averageGains[t * frequencyCount + f];
       }
-      response = response * (1.0 / count);
-      std::complex<double> e1, e2;
-      (response * stokesI).EigenValues(e1, e2);
-      file << ((timeAsDouble-startTime)/3600.0) << '\t' << maxEigenValue << '\t' << std::max(std::abs(e1), std::abs(e2)) << '\n';
     }
+    onBlock(blockStart, blocks);
   }
 }
 
-std::ofstream header(const std::string& name)
-{
-  std::ofstream responsePlt(name + ".plt");
-  responsePlt <<
-    "set terminal pdfcairo enhanced color font 'Times,16'\n"
-    "#set logscale xy\n"
-    "#set yrange [0.1:]\n"
-    "set output \"" << name << ".pdf\"\n"
-    "set key above\n"
-    "set xlabel \"Time (h)\"\n"
-    "set ylabel \"Apparent flux (Jy)\"\n"
-    "plot \\\n";
-  return responsePlt;
+/**
+ * A response time series that is written by @ref sourceResponse(): there
+ * is one for every combination of component, observation, field and
+ * frequency.
+ */
+struct Output
+{
+  double frequency;
+  /** Key of the observation and field, used to look up the response in the cache. */
+  uint64_t fieldKey;
+  /** Name of the output in the manifest and in the plots. */
+  std::string name;
+  /** Filename of the output, including the observation directory. */
+  std::string filename;
+  Checkpoint* checkpoint;
+};
+
+/**
+ * Writes the responses of a component for all given outputs. The outputs
+ * must belong to fields that share the stations, directions and times of
+ * the given field. Outputs that are neither finished nor cached are
+ * calculated together, so that the direction conversions are done only once.
+ */
+void sourceResponse(const ModelComponent& source, const FieldInfo& field, const std::vector<Output>& outputs, ResponseCache* cache, size_t blockSize)
+{
+  struct OutputState
+  {
+    double stokesI;
+    uint64_t directionKey;
+    Checkpoint::Progress progress;
+    std::ofstream file;
+    bool storeInCache;
+    std::vector<ResponseCache::Sample> calculated;
+  };
+  std::vector<OutputState> states(outputs.size());
+  
+  ProfileScope scope("source_response");
+  auto writeSamples = [&](size_t index, const ResponseCache::Sample* begin, const ResponseCache::Sample* end)
+  {
+    ProfileScope writeScope("write_output");
+    const Output& output = outputs[index];
+    OutputState& state = states[index];
+    const std::string str = FormatSamples(begin, end, state.stokesI);
+    state.file.write(str.data(), str.size());
+    state.file.flush();
+    if(!state.file.good())
+      throw std::runtime_error("Error writing " + output.filename);
+    state.progress.timesteps += end - begin;
+    state.progress.outputSize += str.size();
+    if(output.checkpoint)
+      output.checkpoint->Record(output.name, state.progress);
+  };
+  
+  auto finish = [&](size_t index)
+  {
+    if(outputs[index].checkpoint)
+    {
+      states[index].progress.finished = true;
+      outputs[index].checkpoint->Record(outputs[index].name, states[index].progress);
+    }
+  };
+  
+  std::vector<size_t> pending;
+  std::vector<double> pendingFrequencies;
+  size_t startTimestep = field.times.size();
+  for(size_t index=0; index!=outputs.size(); ++index)
+  {
+    const Output& output = outputs[index];
+    OutputState& state = states[index];
+    // The eigenvalues scale linearly with the flux, so the response is
+    // calculated (and cached) for unit flux and scaled afterwards.
+    state.stokesI = std::fabs(source.SED().FluxAtFrequency(output.frequency, aocommon::Polarization::StokesI));
+    state.directionKey = ResponseCache::MakeKey(output.fieldKey, output.frequency, source.PosRA(), source.PosDec());
+    
+    if(output.checkpoint)
+    {
+      Hasher hasher;
+      hasher.Add(state.directionKey);
+      hasher.Add(state.stokesI);
+      state.progress = output.checkpoint->Find(output.name, hasher.Value());
+      state.progress.componentKey = hasher.Value();
+      if(state.progress.finished)
+      {
+        Profiler::Count(Profiler::CulledTimesteps, state.progress.timesteps);
+        std::cout << "Skipping " << output.name << ": already finished.\n";
+        continue;
+      }
+      struct stat fileStat;
+      if(state.progress.timesteps != 0 &&
+        (stat(output.filename.c_str(), &fileStat) != 0 || uint64_t(fileStat.st_size) < state.progress.outputSize ||
+        truncate(output.filename.c_str(), state.progress.outputSize) != 0))
+      {
+        std::cout << "Output of " << output.name << " does not match the manifest: restarting component.\n";
+        state.progress.timesteps = 0;
+        state.progress.outputSize = 0;
+      }
+      Profiler::Count(Profiler::CulledTimesteps, state.progress.timesteps);
+      if(state.progress.timesteps != 0)
+        std::cout << "Resuming " << output.name << " at timestep " << state.progress.timesteps << ".\n";
+    }
+    
+    if(state.progress.timesteps != 0)
+      state.file.open(output.filename, std::ios::app);
+    else
+      state.file.open(output.filename);
+    
+    std::unique_ptr<ResponseCache::Entry> cached;
+    if(cache)
+    {
+      ProfileScope cacheScope("cache_lookup");
+      cached = cache->Find(state.directionKey);
+      Profiler::Count(cached ? Profiler::ResponseCacheHits : Profiler::ResponseCacheMisses);
+    }
+    if(cached)
+    {
+      writeSamples(index, cached->begin() + std::min(state.progress.timesteps, cached->size()), cached->end());
+      finish(index);
+    }
+    else {
+      // Only a calculation over the full observation can be stored in the cache
+      state.storeInCache = cache && state.progress.timesteps == 0;
+      pending.push_back(index);
+      pendingFrequencies.push_back(output.frequency);
+      startTimestep = std::min(startTimestep, state.progress.timesteps);
+    }
+  }
+  
+  if(!pending.empty())
+  {
+    calculateResponse(source, field, pendingFrequencies, startTimestep, blockSize,
+      [&](size_t firstTimestep, const std::vector<std::vector<ResponseCache::Sample>>& blocks)
+      {
+        for(size_t i=0; i!=pending.size(); ++i)
+        {
+          OutputState& state = states[pending[i]];
+          const std::vector<ResponseCache::Sample>& block = blocks[i];
+          // Outputs that were resumed at a later timestep than others skip
+          // the samples they already have.
+          size_t skip = 0;
+          if(state.progress.timesteps > firstTimestep)
+            skip = std::min(state.progress.timesteps - firstTimestep, block.size());
+          writeSamples(pending[i], block.data() + skip, block.data() + block.size());
+          if(state.storeInCache)
+            state.calculated.insert(state.calculated.end(), block.begin(), block.end());
+        }
+      });
+    for(size_t index : pending)
+    {
+      if(states[index].storeInCache)
+      {
+        ProfileScope cacheScope("cache_store");
+        cache->Store(states[index].directionKey, states[index].calculated);
+      }
+      finish(index);
+    }
+  }
 }
 
-int main(int argc, char* argv[])
+/**
+ * Reads the meta data of a list of observations on a separate thread, so
+ * that the meta data of the next observation is read while the responses
+ * of the current one are calculated. Station objects are shared between
+ * consecutive observations with the same layout.
+ */
+class ObservationReader
+{
+public:
+  ObservationReader(const std::vector<std::string>& filenames, const std::string& sidecarFilename, const TimeGrid& timeGrid, const TimeSelection& timeSelection, const std::vector<double>& frequencies, const std::string& beamName) :
+    _filenames(filenames),
+    _sidecarFilename(sidecarFilename),
+    _timeGrid(timeGrid),
+    _timeSelection(timeSelection),
+    _frequencies(frequencies),
+    _beamName(beamName),
+    _lane(1),
+    _stop(false),
+    _thread(&ObservationReader::run, this)
+  { }
+  
+  ~ObservationReader()
+  {
+    _stop = true;
+    std::unique_ptr<ObservationInfo> info;
+    while(_lane.read(info))
+    { }
+    _thread.join();
+  }
+  
+  /**
+   * Returns the next observation in the order of the filenames, or false
+   * when all have been read. Errors of the reading thread are rethrown.
+   */
+  bool Read(std::unique_ptr<ObservationInfo>& info)
+  {
+    if(_lane.read(info))
+      return true;
+    if(_error)
+      std::rethrow_exception(_error);
+    return false;
+  }
+  
+private:
+  void run()
+  {
+    Profiler::NameThread("observation reader");
+    try {
+      StationCache stationCache(_beamName);
+      for(const std::string& filename : _filenames)
+      {
+        if(_stop)
+          break;
+        std::cout << "Reading meta data of " << filename << "...\n";
+        _lane.write(std::unique_ptr<ObservationInfo>(new ObservationInfo(
+          ReadObservationInfo(filename, _sidecarFilename, _timeGrid, _timeSelection, _frequencies, stationCache))));
+      }
+    } catch(...) {
+      _error = std::current_exception();
+    }
+    _lane.write_end();
+  }
+  
+  std::vector<std::string> _filenames;
+  std::string _sidecarFilename;
+  TimeGrid _timeGrid;
+  TimeSelection _timeSelection;
+  std::vector<double> _frequencies;
+  std::string _beamName;
+  aocommon::Lane<std::unique_ptr<ObservationInfo>> _lane;
+  std::atomic<bool> _stop;
+  std::exception_ptr _error;
+  std::thread _thread;
+};
+
+/**
+ * Reads the sources of a model in batches on a separate thread, so that
+ * the next batch is parsed while the responses of the current one are
+ * calculated. Only one batch waits to be processed, so that at most three
+ * batches of the model are in memory.
+ */
+class SourceBatchReader
 {
-  if(argc < 3)
-    std::cout << "Syntax: sourceresponse <ms> <model>\n";
+public:
+  SourceBatchReader(const std::string& modelFilename, size_t batchSize) :
+    _modelFilename(modelFilename),
+    _batchSize(batchSize),
+    _lane(1),
+    _stop(false),
+    _thread(&SourceBatchReader::run, this)
+  { }
+  
+  ~SourceBatchReader()
+  {
+    _stop = true;
+    std::unique_ptr<std::vector<ModelSource>> batch;
+    while(_lane.read(batch))
+    { }
+    _thread.join();
+  }
   
-  std::ofstream maxPlt(header("response-max"));
-  std::ofstream avgPlt(header("response-avg"));
+  /**
+   * Returns the next batch of sources in the order of the model, or false
+   * when all have been read. Errors of the reading thread are rethrown.
+   */
+  bool Read(std::unique_ptr<std::vector<ModelSource>>& batch)
+  {
+    if(_lane.read(batch))
+      return true;
+    if(_error)
+      std::rethrow_exception(_error);
+    return false;
+  }
+  
+private:
+  void run()
+  {
+    Profiler::NameThread("model reader");
+    try {
+      ModelReader reader(_modelFilename);
+      while(!_stop)
+      {
+        std::unique_ptr<std::vector<ModelSource>> batch(new std::vector<ModelSource>());
+        bool isRead;
+        {
+          ProfileScope scope("model_read");
+          isRead = reader.Read(*batch, _batchSize);
+        }
+        if(!isRead)
+          break;
+        _lane.write(std::move(batch));
+      }
+    } catch(...) {
+      _error = std::current_exception();
+    }
+    _lane.write_end();
+  }
+  
+  std::string _modelFilename;
+  size_t _batchSize;
+  aocommon::Lane<std::unique_ptr<std::vector<ModelSource>>> _lane;
+  std::atomic<bool> _stop;
+  std::exception_ptr _error;
+  std::thread _thread;
+};
+
+/**
+ * The outputs of a single observation. In batch mode, these are written
+ * to a directory named after the measurement set.
+ */
+struct ObservationOutput
+{
+  std::unique_ptr<ObservationInfo> info;
+  /** Empty, or a directory name including the trailing slash. */
+  std::string directory;
+  std::unique_ptr<Checkpoint> checkpoint;
+  PlotScript maxPlot, averagePlot;
+};
+
+std::string batchDirectory(std::string observationFilename)
+{
+  while(observationFilename.size() > 1 && observationFilename.back() == '/')
+    observationFilename.pop_back();
+  const size_t slash = observationFilename.rfind('/');
+  std::string directory = (slash == std::string::npos) ? observationFilename : observationFilename.substr(slash + 1);
+  if(mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+    throw std::runtime_error("Could not create output directory " + directory + ": " + strerror(errno));
+  return directory + '/';
+}
+
+void startGroup(std::vector<std::unique_ptr<ObservationOutput>>& group, bool useCheckpoint)
+{
+  for(std::unique_ptr<ObservationOutput>& observation : group)
+  {
+    if(useCheckpoint)
+      observation->checkpoint.reset(new Checkpoint(observation->directory + "sourceresponse.manifest", observation->info->key));
+    observation->maxPlot.Open(observation->directory, "response-max", 2);
+    observation->averagePlot.Open(observation->directory, "response-avg", 3);
+  }
+}
+
+/**
+ * Calculates the responses of the components of a source for a group of
+ * observations that share the stations, fields and times, i.e., that differ
+ * only in frequency. When an observation has several fields, the names of
+ * the outputs include the field index.
+ */
+void processSource(std::vector<std::unique_ptr<ObservationOutput>>& group, const ModelSource& s, ResponseCache* cache, size_t blockSize)
+{
+  const ObservationInfo& info = *group.front()->info;
+  for(size_t i=0; i!=s.ComponentCount(); ++i)
+  {
+    const ModelComponent& c = s.Component(i);
+    const std::string componentName = ComponentName(s, i);
+    std::cout << "Calculating " << componentName << "...\n";
+    for(size_t f=0; f!=info.fields.size(); ++f)
+    {
+      std::vector<Output> outputs;
+      for(std::unique_ptr<ObservationOutput>& observation : group)
+      {
+        const FieldInfo& field = observation->info->fields[f];
+        for(double frequency : field.frequencies)
+        {
+          Output output;
+          output.frequency = frequency;
+          output.fieldKey = field.key;
+          output.name = OutputName(componentName, *observation->info, field, frequency);
+          output.filename = observation->directory + output.name + ".txt";
+          output.checkpoint = observation->checkpoint.get();
+          outputs.push_back(output);
+          observation->maxPlot.AddOutput(output.name);
+          observation->averagePlot.AddOutput(output.name);
+        }
+      }
+      sourceResponse(c, info.fields[f], outputs, cache, blockSize);
+    }
+  }
+}
+
+void finishGroup(std::vector<std::unique_ptr<ObservationOutput>>& group)
+{
+  for(std::unique_ptr<ObservationOutput>& observation : group)
+  {
+    observation->maxPlot.Close();
+    observation->averagePlot.Close();
+  }
+}
+
+/**
+ * Calculates the responses of all components of the sources of a model
+ * that is in memory for a group of observations, see processSource().
+ */
+void processGroup(std::vector<std::unique_ptr<ObservationOutput>>& group, const ModelView& sources, ResponseCache* cache, bool useCheckpoint, size_t blockSize)
+{
+  ProfileScope scope("process_group");
+  startGroup(group, useCheckpoint);
+  for(const ModelSource& s : sources)
+    processSource(group, s, cache, blockSize);
+  finishGroup(group);
+}
+
+/**
+ * Calculates the responses of all components of a model file for a group
+ * of observations, while the model is read in batches of sources. The
+ * model is never completely in memory. When clusterName is not empty, only
+ * the sources in that cluster are used.
+ */
+void processGroup(std::vector<std::unique_ptr<ObservationOutput>>& group, const std::string& modelFilename, size_t modelBatchSize, const std::string& clusterName, ResponseCache* cache, bool useCheckpoint, size_t blockSize)
+{
+  ProfileScope scope("process_group");
+  startGroup(group, useCheckpoint);
+  SourceBatchReader reader(modelFilename, modelBatchSize);
+  std::unique_ptr<std::vector<ModelSource>> batch;
+  while(reader.Read(batch))
+  {
+    for(const ModelSource& s : *batch)
+    {
+      if(clusterName.empty() || s.ClusterName() == clusterName)
+        processSource(group, s, cache, blockSize);
+    }
+  }
+  finishGroup(group);
+}
+
+volatile std::sig_atomic_t stopRunning = 0;
+
+void onInterrupt(int)
+{
+  stopRunning = 1;
+}
 
-  Model model(argv[2]);
-  bool isFirst = true;
-  for(const ModelSource& s : model)
+/**
+ * Follows an observation that is being written. The main table is polled
+ * for new rows; the timesteps they add are appended to the fields, and the
+ * responses of only these timesteps are calculated and appended to the
+ * outputs. The outputs are kept open between updates, so that an update
+ * costs time proportional to the number of new timesteps. Following stops
+ * on an interrupt (ctrl-c).
+ */
+void followObservation(const std::string& filename, ObservationInfo& info, const ModelView& sources, const TimeSelection& timeSelection, double pollInterval)
+{
+  struct FollowedOutput
+  {
+    const ModelComponent* component;
+    size_t field;
+    std::vector<double> stokesI;
+    std::vector<std::unique_ptr<std::ofstream>> files;
+  };
+  std::vector<FollowedOutput> outputs;
+  for(const ModelSource& s : sources)
   {
     for(size_t i=0; i!=s.ComponentCount(); ++i)
     {
       const ModelComponent& c = s.Component(i);
-      std::string name = (s.ComponentCount()!=1) ? s.Name() + "_" + std::to_string(i) : s.Name();
-      std::cout << "Calculating " << name << "...\n";
-      sourceResponse(argv[1], c, name + ".txt");
-      if(!isFirst) {
-        maxPlt << ",\\\n";
-        avgPlt << ",\\\n";
-      }
-      else {
-        isFirst = false;
+      const std::string componentName = ComponentName(s, i);
+      for(size_t f=0; f!=info.fields.size(); ++f)
+      {
+        FollowedOutput output;
+        output.component = &c;
+        output.field = f;
+        for(double frequency : info.fields[f].frequencies)
+        {
+          output.stokesI.push_back(std::fabs(c.SED().FluxAtFrequency(frequency, aocommon::Polarization::StokesI)));
+          const std::string name = OutputName(componentName, info, info.fields[f], frequency) + ".txt";
+          output.files.emplace_back(new std::ofstream(name, std::ios::app));
+        }
+        outputs.push_back(std::move(output));
       }
-      maxPlt << '"' << name << ".txt\" using 1:2 with lines title '" << name << "' lw 2";
-      avgPlt << '"' << name << ".txt\" using 1:3 with lines title '" << name << "' lw 2";
-   }
+    }
+  }
+  
+  // Without read locking, the writer of the observation is never blocked
+  casacore::MeasurementSet ms(filename, casacore::TableLock(casacore::TableLock::AutoNoReadLocking));
+  std::signal(SIGINT, onInterrupt);
+  std::cout << "Following " << filename << ", press ctrl-c to stop.\n";
+  while(!stopRunning)
+  {
+    std::this_thread::sleep_for(std::chrono::duration<double>(pollInterval));
+    ms.resync();
+    std::vector<size_t> previousCounts(info.fields.size());
+    for(size_t f=0; f!=info.fields.size(); ++f)
+      previousCounts[f] = info.fields[f].times.size();
+    const size_t newTimesteps = AppendNewTimesteps(info, ms, timeSelection);
+    if(newTimesteps == 0)
+      continue;
+    ProfileScope scope("follow_update");
+    for(FollowedOutput& output : outputs)
+    {
+      const FieldInfo& field = info.fields[output.field];
+      const size_t previousCount = previousCounts[output.field];
+      calculateResponse(*output.component, field, field.frequencies, previousCount, std::max<size_t>(1, field.times.size() - previousCount),
+        [&](size_t, const std::vector<std::vector<ResponseCache::Sample>>& blocks)
+        {
+          for(size_t i=0; i!=blocks.size(); ++i)
+          {
+            std::ofstream& file = *output.files[i];
+            file << FormatSamples(blocks[i].data(), blocks[i].data() + blocks[i].size(), output.stokesI[i]);
+            file.flush();
+            if(!file.good())
+              throw std::runtime_error("Error writing output while following " + filename);
+          }
+        });
+    }
+    std::cout << "Appended " << newTimesteps << " timesteps.\n";
   }
-  maxPlt << "\n";
-  avgPlt << "\n";
+  std::cout << "Stopped following " << filename << ".\n";
 }
 
+int main(int argc, char* argv[])
+{
+  int argi = 1;
+  std::string cacheDirectory;
+  uint64_t cacheSizeLimit = 1024;
+  std::string sidecarFilename;
+  bool useCheckpoint = false;
+  size_t checkpointInterval = 100;
+  bool batch = false;
+  bool follow = false;
+  double pollInterval = 5.0;
+  std::string socketPath;
+  size_t threadsPerClient = 4;
+  std::string beamName = BeamBackendNames().front();
+  TimeGrid timeGrid;
+  TimeSelection timeSelection;
+  std::vector<double> frequencies;
+  bool profile = false;
+  std::string traceFilename;
+  size_t modelBatchSize = 1000;
+  std::string clusterName;
+  while(argi < argc && argv[argi][0] == '-')
+  {
+    std::string param(&argv[argi][1]);
+    if(param == "cache" && argi+1 < argc)
+    {
+      ++argi;
+      cacheDirectory = argv[argi];
+    }
+    else if(param == "cache-size" && argi+1 < argc)
+    {
+      ++argi;
+      cacheSizeLimit = std::atoll(argv[argi]);
+    }
+    else if(param == "sidecar" && argi+1 < argc)
+    {
+      ++argi;
+      sidecarFilename = argv[argi];
+    }
+    else if(param == "time-grid" && argi+3 < argc)
+    {
+      timeGrid.start = parseTime(argv[argi+1]);
+      timeGrid.end = parseTime(argv[argi+2]);
+      timeGrid.interval = std::atof(argv[argi+3]);
+      if(timeGrid.interval <= 0.0 || timeGrid.end < timeGrid.start)
+        throw std::runtime_error("Invalid time grid");
+      argi += 3;
+    }
+    else if(param == "time-range" && argi+2 < argc)
+    {
+      timeSelection.start = parseTime(argv[argi+1]);
+      timeSelection.end = parseTime(argv[argi+2]);
+      if(!timeSelection.HasRange())
+        throw std::runtime_error("Invalid time range");
+      argi += 2;
+    }
+    else if(param == "time-stride" && argi+1 < argc)
+    {
+      ++argi;
+      timeSelection.stride = std::max(1ll, std::atoll(argv[argi]));
+    }
+    else if(param == "select" && argi+1 < argc)
+    {
+      ++argi;
+      timeSelection.rowSelection = argv[argi];
+    }
+    else if(param == "frequencies" && argi+1 < argc)
+    {
+      ++argi;
+      std::istringstream list(argv[argi]);
+      std::string frequency;
+      while(std::getline(list, frequency, ','))
+        frequencies.push_back(std::atof(frequency.c_str()) * 1e6);
+    }
+    else if(param == "checkpoint")
+    {
+      useCheckpoint = true;
+    }
+    else if(param == "checkpoint-interval" && argi+1 < argc)
+    {
+      ++argi;
+      checkpointInterval = std::max(1ll, std::atoll(argv[argi]));
+    }
+    else if(param == "batch")
+    {
+      batch = true;
+    }
+    else if(param == "follow")
+    {
+      follow = true;
+    }
+    else if(param == "follow-interval" && argi+1 < argc)
+    {
+      ++argi;
+      pollInterval = std::atof(argv[argi]);
+    }
+    else if(param == "daemon" && argi+1 < argc)
+    {
+      ++argi;
+      socketPath = argv[argi];
+    }
+    else if(param == "daemon-threads" && argi+1 < argc)
+    {
+      ++argi;
+      threadsPerClient = std::max(1ll, std::atoll(argv[argi]));
+    }
+    else if(param == "model-batch" && argi+1 < argc)
+    {
+      ++argi;
+      modelBatchSize = std::max(1ll, std::atoll(argv[argi]));
+    }
+    else if(param == "cluster" && argi+1 < argc)
+    {
+      ++argi;
+      clusterName = argv[argi];
+    }
+    else if(param == "beam" && argi+1 < argc)
+    {
+      ++argi;
+      beamName = argv[argi];
+    }
+    else if(param == "profile")
+    {
+      profile = true;
+    }
+    else if(param == "trace" && argi+1 < argc)
+    {
+      ++argi;
+      traceFilename = argv[argi];
+    }
+    else {
+      std::cerr << "Invalid parameter: " << argv[argi] << '\n';
+      return -1;
+    }
+    ++argi;
+  }
+  if(argc - argi < 2 || (!batch && argc - argi != 2))
+  {
+    std::string beamNames;
+    for(const std::string& name : BeamBackendNames())
+      beamNames += (beamNames.empty() ? "" : ", ") + name;
+    std::cout <<
+      "Syntax: sourceresponse [options] <ms or sidecar> <model>\n"
+      "        sourceresponse -batch [options] <ms1> [<ms2> ...] <model>\n"
+      "Options:\n"
+      "-batch\n"
+      "   Calculate the responses for several observations, e.g. all subbands\n"
+      "   of an observation. The outputs of every observation are written to a\n"
+      "   directory named after it. Observations that have the same stations,\n"
+      "   directions and times share their stations and direction conversions.\n"
+      "-cache <directory>\n"
+      "   Store the calculated responses in the given directory, and reuse them\n"
+      "   in later runs on the same observation.\n"
+      "-cache-size <MB>\n"
+      "   Maximum size of the cache directory. Least recently used responses are\n"
+      "   removed when the cache grows larger. Default: 1024 MB.\n"
+      "-sidecar <file>\n"
+      "   Read the station layouts, directions and frequencies from the given\n"
+      "   sidecar file instead of from the measurement set subtables. When the\n"
+      "   file does not exist, it is created from the measurement set.\n"
+      "-time-grid <start> <end> <interval>\n"
+      "   Calculate the response at regularly spaced times instead of at the\n"
+      "   timesteps of the measurement set, without reading its main table. Start\n"
+      "   and end are dates like 2020/01/31/12:00:00, the interval is in seconds.\n"
+      "   This makes it possible to use a measurement set with an empty main\n"
+      "   table or a sidecar file as observation.\n"
+      "-time-range <start> <end>\n"
+      "   Only calculate the response for timesteps between start and end\n"
+      "   (inclusive), given as dates like 2020/01/31/12:00:00.\n"
+      "-time-stride <n>\n"
+      "   Only calculate the response for every n-th timestep.\n"
+      "-select <TaQL expression>\n"
+      "   Only use the rows of the main table that match the given expression,\n"
+      "   e.g. \"ANTENNA1 != ANTENNA2 && FIELD_ID == 0\".\n"
+      "-frequencies <list>\n"
+      "   Comma-separated list of frequencies in MHz at which to calculate the\n"
+      "   response. Default: the centre frequency of every spectral window.\n"
+      "-checkpoint\n"
+      "   Record the progress in a manifest file in the output directory. When\n"
+      "   the run is interrupted, rerunning with -checkpoint in the same directory\n"
+      "   skips the finished work and continues appending to the same outputs.\n"
+      "-checkpoint-interval <timesteps>\n"
+      "   Number of timesteps between recording progress. Default: 100.\n"
+      "-follow\n"
+      "   After processing the measurement set, keep watching it for rows that\n"
+      "   are being appended, and append the responses of new timesteps to the\n"
+      "   outputs, until interrupted with ctrl-c.\n"
+      "-follow-interval <seconds>\n"
+      "   Time between checks for new rows in follow mode. Default: 5 s.\n"
+      "-daemon <socket>\n"
+      "   Instead of calculating responses, read the meta data and model once and\n"
+      "   answer apparent-flux queries on the given Unix domain socket, until\n"
+      "   interrupted with ctrl-c. See queryserver.h for the protocol.\n"
+      "-daemon-threads <n>\n"
+      "   Number of threads used for the requests of each client. Default: 4.\n"
+      "-model-batch <n>\n"
+      "   Number of sources that are read from the model at a time while the\n"
+      "   responses are calculated. A larger batch uses more memory. Default: 1000.\n"
+      "-cluster <name>\n"
+      "   Only calculate the responses of the sources in the given cluster.\n"
+      "-beam <name>\n"
+      "   Beam model to use: " << beamNames << ". Default: " << BeamBackendNames().front() << ".\n"
+      "   The analytic beam is an approximation that does not require the LOFAR\n"
+      "   beam library.\n"
+      "-profile\n"
+      "   Print a table with the time spent in every phase of the run and counts\n"
+      "   of response calls, direction conversions, culled timesteps and cache\n"
+      "   hits at the end of the run.\n"
+      "-trace <file>\n"
+      "   Write the phases of the run per thread to the given file in the Chrome\n"
+      "   trace-event format, for viewing in chrome://tracing or Perfetto.\n";
+    return -1;
+  }
+  if(batch && !sidecarFilename.empty())
+  {
+    std::cerr << "The -sidecar option can not be used in batch mode.\n";
+    return -1;
+  }
+  if(follow && (batch || timeGrid.IsSet() || !timeSelection.rowSelection.empty() || !cacheDirectory.empty() || useCheckpoint))
+  {
+    std::cerr << "The -follow option can not be combined with -batch, -time-grid, -select, -cache or -checkpoint.\n";
+    return -1;
+  }
+  const std::vector<std::string> observationFilenames(argv + argi, argv + argc - 1);
+  const std::string modelFilename = argv[argc - 1];
+  
+  if(profile || !traceFilename.empty())
+  {
+    Profiler::Enable();
+    Profiler::NameThread("main");
+  }
+  auto reportProfile = [&]()
+  {
+    if(!traceFilename.empty())
+      Profiler::WriteChromeTrace(traceFilename);
+    if(profile)
+      Profiler::PrintSummary(std::cout);
+  };
+  
+  std::unique_ptr<ResponseCache> cache;
+  if(!cacheDirectory.empty())
+    cache.reset(new ResponseCache(cacheDirectory, cacheSizeLimit*1024*1024));
+  
+  // Other modes read the model in batches while calculating, see SourceBatchReader
+  Model model;
+  if(!socketPath.empty() || follow)
+  {
+    ProfileScope scope("model_load");
+    // Queries touch few sources, so the daemon does not parse the SEDs it does not need
+    if(socketPath.empty())
+      model = Model(modelFilename);
+    else
+      model = Model::ReadIndex(modelFilename);
+  }
+  if(!socketPath.empty())
+  {
+    if(batch)
+    {
+      std::cerr << "The -daemon option can not be used in batch mode.\n";
+      return -1;
+    }
+    std::unique_ptr<casacore::MeasurementSet> ms;
+    const MetaData metaData = ReadMetaData(observationFilenames.front(), sidecarFilename, ms);
+    ms.reset();
+    StationCache stationCache(beamName);
+    std::shared_ptr<const BeamBackend> beam = ReadBeam(metaData, stationCache);
+    std::vector<QueryServer::Field> fields(metaData.FieldCount());
+    for(size_t field=0; field!=fields.size(); ++field)
+    {
+      fields[field].delayDirection = metaData.DelayDirection(field);
+      fields[field].tileBeamDirection = metaData.TileBeamDirection(field);
+    }
+    QueryServer server(socketPath, beam, fields, model, threadsPerClient);
+    std::signal(SIGINT, onInterrupt);
+    std::signal(SIGTERM, onInterrupt);
+    std::cout << "Serving queries on " << socketPath << ", press ctrl-c to stop.\n";
+    server.Run(stopRunning);
+    server.ReportLatencies(std::cout);
+    reportProfile();
+    return 0;
+  }
+  if(follow)
+  {
+    StationCache stationCache(beamName);
+    std::vector<std::unique_ptr<ObservationOutput>> group(1);
+    group.front().reset(new ObservationOutput());
+    group.front()->info.reset(new ObservationInfo(ReadObservationInfo(observationFilenames.front(), sidecarFilename, timeGrid, timeSelection, frequencies, stationCache, true)));
+    const ModelView sources = clusterName.empty() ? ModelView(model) : model.GetSourcesInCluster(clusterName);
+    processGroup(group, sources, nullptr, false, checkpointInterval);
+    followObservation(observationFilenames.front(), *group.front()->info, sources, timeSelection, pollInterval);
+    reportProfile();
+    return 0;
+  }
+  ObservationReader reader(observationFilenames, sidecarFilename, timeGrid, timeSelection, frequencies, beamName);
+  std::vector<std::unique_ptr<ObservationOutput>> group;
+  std::unique_ptr<ObservationInfo> info;
+  size_t observationIndex = 0;
+  while(reader.Read(info))
+  {
+    if(!group.empty() &&
+      (info->layoutKey != group.front()->info->layoutKey || info->timeKey != group.front()->info->timeKey))
+    {
+      processGroup(group, modelFilename, modelBatchSize, clusterName, cache.get(), useCheckpoint, checkpointInterval);
+      group.clear();
+    }
+    std::unique_ptr<ObservationOutput> observation(new ObservationOutput());
+    observation->info = std::move(info);
+    if(batch)
+      observation->directory = batchDirectory(observationFilenames[observationIndex]);
+    group.push_back(std::move(observation));
+    ++observationIndex;
+  }
+  if(!group.empty())
+    processGroup(group, modelFilename, modelBatchSize, clusterName, cache.get(), useCheckpoint, checkpointInterval);
+  if(cache)
+    std::cout << "Response cache: " << cache->HitCount() << " hits, " << cache->MissCount() << " misses.\n";
+  reportProfile();
+}
@@ -0,0 +1,44 @@
+#ifndef STATION_LAYOUT_H
+#define STATION_LAYOUT_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Plain description of the layout of a station, as stored in the ANTENNA
+ * and LOFAR_ANTENNA_FIELD tables of a measurement set. All positions are
+ * ITRF coordinates in meters.
+ */
+struct ElementLayout
+{
+	/** Offset of the element with respect to the origin of its field. */
+	double offset[3];
+	/** Whether the X and Y dipoles of the element are working. */
+	bool enabled[2];
+};
+
+struct AntennaFieldLayout
+{
+	std::string name;
+	double origin[3];
+	/** The P, Q and R coordinate axes of the field. */
+	double axes[3][3];
+	/** True for HBA fields, which have a tile configuration. */
+	bool hasTileConfig;
+	/**
+	 * ITRF offsets of the 16 elements of an HBA tile with respect to the
+	 * centre of the tile, as in the TILE_ELEMENT_OFFSET column.
+	 */
+	double tileConfig[16][3];
+	std::vector<ElementLayout> elements;
+};
+
+struct StationLayout
+{
+	std::string name;
+	double position[3];
+	double phaseReference[3];
+	std::vector<AntennaFieldLayout> fields;
+};
+
+#endif
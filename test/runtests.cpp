@@ -0,0 +1,7 @@
+/*
+ * Unit tests of the model and caching code. The tests of every module are
+ * in a separate file, in a test suite named after the module; run them with
+ * ctest or directly with sourceresponse-tests.
+ */
+#define BOOST_TEST_MODULE sourceresponse
+#include <boost/test/included/unit_test.hpp>
@@ -0,0 +1,134 @@
+#include "testdata.h"
+
+#include "../model/binarymodel.h"
+#include "../model/model.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+	Model makeModel(double flux)
+	{
+		Model model;
+		model.FindOrAddCluster("c1");
+		model.FindOrAddCluster("c2");
+		ModelSource first = MakeSource("first", "c1", 1.25, 0.5, 150e6, flux);
+		first.Peak().MSED().AddMeasurement(flux * 0.5, 300e6);
+		first.AddComponent(MakeComponent(1.25, 0.5 + 1e-4, 150e6, 0.25));
+		model.AddSource(first);
+		model.AddSource(MakeSource("second", "c2", 4.5, -0.75, 120e6, 3.0));
+		return model;
+	}
+
+	std::string toText(const Model& model)
+	{
+		std::ostringstream stream;
+		model.Save(stream);
+		return stream.str();
+	}
+
+	std::string readFile(const std::string& filename)
+	{
+		std::ifstream file(filename);
+		return std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+	}
+
+	void setModificationTime(const std::string& filename, time_t seconds)
+	{
+		struct timespec times[2];
+		times[0].tv_sec = seconds;
+		times[0].tv_nsec = 0;
+		times[1] = times[0];
+		BOOST_REQUIRE_EQUAL(utimensat(AT_FDCWD, filename.c_str(), times, 0), 0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(binarymodel)
+
+BOOST_AUTO_TEST_CASE( round_trip )
+{
+	TemporaryDirectory directory;
+	const Model model = makeModel(2.0);
+	const std::string filename = directory.File("model.bin");
+	model.Save(filename, true);
+	const std::string data = readFile(filename);
+	BOOST_CHECK(BinaryModel::IsBinaryModel(data.data(), data.size()));
+
+	const Model loaded(filename);
+	BOOST_REQUIRE_EQUAL(loaded.SourceCount(), 2u);
+	BOOST_CHECK_EQUAL(loaded.ClusterCount(), 2u);
+	BOOST_CHECK_EQUAL(loaded.Source(1).ClusterName(), "c2");
+	BOOST_CHECK_EQUAL(toText(loaded), toText(model));
+}
+
+BOOST_AUTO_TEST_CASE( cache )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.txt");
+	const std::string cacheFilename = BinaryModel::CacheFilename(filename);
+	makeModel(2.0).Save(filename);
+	setModificationTime(filename, 1000000000);
+
+	const std::string text = toText(Model(filename));
+	BOOST_CHECK_EQUAL(text, toText(makeModel(2.0)));
+	const std::string cache = readFile(cacheFilename);
+	BOOST_CHECK(BinaryModel::IsBinaryModel(cache.data(), cache.size()));
+	// The second read uses the cache, and does not rewrite it
+	BOOST_CHECK_EQUAL(toText(Model(filename)), text);
+	BOOST_CHECK(readFile(cacheFilename) == cache);
+	// Without the cache, the same model is read
+	BOOST_CHECK_EQUAL(toText(Model(filename, false)), text);
+}
+
+BOOST_AUTO_TEST_CASE( stale_cache )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.txt");
+	makeModel(2.0).Save(filename);
+	setModificationTime(filename, 1000000000);
+	const size_t size = readFile(filename).size();
+	const Model original(filename);
+	BOOST_CHECK_EQUAL(original.SourceCount(), 2u);
+
+	// Same size, but a different modification time
+	makeModel(4.0).Save(filename);
+	BOOST_REQUIRE_EQUAL(readFile(filename).size(), size);
+	setModificationTime(filename, 1000000001);
+	const std::string changed = toText(makeModel(4.0));
+	BOOST_CHECK_EQUAL(toText(Model(filename)), changed);
+	// The cache was rewritten for the new text
+	BinaryModel::TextStamp stamp;
+	BOOST_REQUIRE(BinaryModel::ReadTextStamp(filename, stamp));
+	Model cached;
+	BOOST_REQUIRE(BinaryModel::ReadCache(cached, filename, stamp));
+	BOOST_CHECK_EQUAL(toText(cached), changed);
+
+	// Same modification time, but a different size
+	makeModel(3.5).Save(filename);
+	setModificationTime(filename, 1000000001);
+	BOOST_CHECK_EQUAL(toText(Model(filename)), toText(makeModel(3.5)));
+}
+
+BOOST_AUTO_TEST_CASE( corrupt_cache )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.txt");
+	makeModel(2.0).Save(filename);
+	const std::string text = toText(Model(filename));
+	const std::string cacheFilename = BinaryModel::CacheFilename(filename);
+	std::string cache = readFile(cacheFilename);
+	cache[cache.size() / 2] ^= 0x55;
+	std::ofstream(cacheFilename) << cache;
+	BOOST_CHECK_EQUAL(toText(Model(filename)), text);
+
+	std::ofstream(cacheFilename) << "truncated";
+	BOOST_CHECK_EQUAL(toText(Model(filename)), text);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
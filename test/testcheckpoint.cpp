@@ -0,0 +1,83 @@
+#include "testdata.h"
+
+#include "../checkpoint.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+
+namespace {
+	Checkpoint::Progress makeProgress(uint64_t componentKey, size_t timesteps, uint64_t outputSize, bool finished)
+	{
+		Checkpoint::Progress progress;
+		progress.componentKey = componentKey;
+		progress.timesteps = timesteps;
+		progress.outputSize = outputSize;
+		progress.finished = finished;
+		return progress;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(checkpoint)
+
+BOOST_AUTO_TEST_CASE( resume )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("manifest");
+	{
+		Checkpoint checkpoint(filename, 42);
+		checkpoint.Record("a", makeProgress(7, 100, 1234, false));
+		checkpoint.Record("a", makeProgress(7, 200, 2345, true));
+		checkpoint.Record("b", makeProgress(8, 100, 1234, false));
+	}
+	Checkpoint checkpoint(filename, 42);
+	const Checkpoint::Progress a = checkpoint.Find("a", 7);
+	BOOST_CHECK(a.finished);
+	BOOST_CHECK_EQUAL(a.timesteps, 200u);
+	BOOST_CHECK_EQUAL(a.outputSize, 2345u);
+	const Checkpoint::Progress b = checkpoint.Find("b", 8);
+	BOOST_CHECK(!b.finished);
+	BOOST_CHECK_EQUAL(b.timesteps, 100u);
+	BOOST_CHECK_EQUAL(b.outputSize, 1234u);
+	// A component with another key, e.g. because its model changed, starts from scratch
+	BOOST_CHECK_EQUAL(checkpoint.Find("b", 9).timesteps, 0u);
+	BOOST_CHECK_EQUAL(checkpoint.Find("c", 7).timesteps, 0u);
+}
+
+BOOST_AUTO_TEST_CASE( other_observation )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("manifest");
+	Checkpoint(filename, 42).Record("a", makeProgress(7, 100, 1234, true));
+	Checkpoint checkpoint(filename, 43);
+	BOOST_CHECK(!checkpoint.Find("a", 7).finished);
+	BOOST_CHECK_EQUAL(checkpoint.Find("a", 7).timesteps, 0u);
+}
+
+BOOST_AUTO_TEST_CASE( partial_record )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("manifest");
+	{
+		Checkpoint checkpoint(filename, 42);
+		checkpoint.Record("a", makeProgress(7, 100, 1234, true));
+		checkpoint.Record("b", makeProgress(8, 50, 600, false));
+	}
+	// A record that was cut off when the process was killed
+	std::ofstream(filename, std::ios::app) << "c\t8\t000";
+	{
+		Checkpoint checkpoint(filename, 42);
+		BOOST_CHECK(checkpoint.Find("a", 7).finished);
+		BOOST_CHECK_EQUAL(checkpoint.Find("b", 8).timesteps, 50u);
+		BOOST_CHECK_EQUAL(checkpoint.Find("c", 8).timesteps, 0u);
+		// The partial record is removed, so that new records are readable
+		checkpoint.Record("c", makeProgress(9, 10, 100, false));
+	}
+	Checkpoint checkpoint(filename, 42);
+	BOOST_CHECK(checkpoint.Find("a", 7).finished);
+	BOOST_CHECK_EQUAL(checkpoint.Find("b", 8).timesteps, 50u);
+	BOOST_CHECK_EQUAL(checkpoint.Find("c", 9).timesteps, 10u);
+	BOOST_CHECK_EQUAL(checkpoint.Find("c", 9).outputSize, 100u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
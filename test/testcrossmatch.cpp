@@ -0,0 +1,103 @@
+#include "testdata.h"
+
+#include "../model/crossmatch.h"
+#include "../model/model.h"
+
+#include <boost/test/unit_test.hpp>
+
+namespace {
+	/**
+	 * The first model has sources a to d, and e1 and e2 close together. The
+	 * second has a match for a; a source near b, but outside the tolerance;
+	 * two sources near c, of which c1 is nearest; nothing near d; and a
+	 * single source near e1 and e2, which is nearest to e1.
+	 */
+	struct Models
+	{
+		static constexpr double tolerance = 1e-5;
+
+		Models()
+		{
+			first.AddSource(MakeSource("a", "", 0.5, 0.0));
+			first.AddSource(MakeSource("b", "", 1.0, 0.1));
+			first.AddSource(MakeSource("c", "", 2.0, 0.2));
+			first.AddSource(MakeSource("d", "", 3.0, 0.3));
+			first.AddSource(MakeSource("e1", "", 4.0, 0.4));
+			first.AddSource(MakeSource("e2", "", 4.0, 0.4 + 4e-6));
+
+			second.AddSource(MakeSource("a", "", 0.5 + 1e-6, 0.0, 150e6, 3.0));
+			second.AddSource(MakeSource("b", "", 1.0, 0.1 + 5e-5));
+			second.AddSource(MakeSource("c2", "", 2.0, 0.2 + 4e-6));
+			second.AddSource(MakeSource("c1", "", 2.0, 0.2 + 2e-6, 160e6, 2.0));
+			second.AddSource(MakeSource("e", "", 4.0, 0.4 - 1e-6));
+		}
+
+		Model first, second;
+	};
+}
+
+BOOST_AUTO_TEST_SUITE(crossmatch)
+
+BOOST_AUTO_TEST_CASE( mutual_nearest_within_tolerance )
+{
+	Models models;
+	for(size_t threadCount : {1, 3})
+	{
+		CrossMatch match(models.first, models.second, Models::tolerance, threadCount);
+		const std::vector<CrossMatch::Match>& matches = match.Matches();
+		BOOST_REQUIRE_EQUAL(matches.size(), 3u);
+		BOOST_CHECK_EQUAL(matches[0].first, 0u);
+		BOOST_CHECK_EQUAL(matches[0].second, 0u);
+		BOOST_CHECK_CLOSE(matches[0].distance, 1e-6, 1e-3);
+		// c matches the nearest of the two candidates
+		BOOST_CHECK_EQUAL(matches[1].first, 2u);
+		BOOST_CHECK_EQUAL(matches[1].second, 3u);
+		BOOST_CHECK_CLOSE(matches[1].distance, 2e-6, 1e-3);
+		// The source near e1 and e2 is matched once, to the nearest
+		BOOST_CHECK_EQUAL(matches[2].first, 4u);
+		BOOST_CHECK_EQUAL(matches[2].second, 4u);
+
+		const std::vector<size_t> unmatchedFirst{1, 3, 5}, unmatchedSecond{1, 2};
+		BOOST_CHECK_EQUAL_COLLECTIONS(match.UnmatchedFirst().begin(), match.UnmatchedFirst().end(), unmatchedFirst.begin(), unmatchedFirst.end());
+		BOOST_CHECK_EQUAL_COLLECTIONS(match.UnmatchedSecond().begin(), match.UnmatchedSecond().end(), unmatchedSecond.begin(), unmatchedSecond.end());
+	}
+}
+
+BOOST_AUTO_TEST_CASE( zero_tolerance )
+{
+	Model first, second;
+	first.AddSource(MakeSource("a", "", 1.0, 0.5));
+	first.AddSource(MakeSource("b", "", 2.0, 0.5));
+	second.AddSource(MakeSource("b", "", 2.0, 0.5));
+	second.AddSource(MakeSource("a", "", 1.0, 0.5 + 1e-12));
+	CrossMatch match(first, second, 0.0, 1);
+	BOOST_REQUIRE_EQUAL(match.Matches().size(), 1u);
+	BOOST_CHECK_EQUAL(match.Matches()[0].first, 1u);
+	BOOST_CHECK_EQUAL(match.Matches()[0].second, 0u);
+	BOOST_CHECK_EQUAL(match.Matches()[0].distance, 0.0);
+}
+
+BOOST_AUTO_TEST_CASE( merge )
+{
+	Models models;
+	CrossMatch match(models.first, models.second, Models::tolerance, 1);
+	const Model merged = match.Merge(0.5);
+	// All sources of the first model, followed by b and c2 of the second
+	BOOST_REQUIRE_EQUAL(merged.SourceCount(), 8u);
+	BOOST_CHECK_EQUAL(merged.Source(6).Name(), "b");
+	BOOST_CHECK_EQUAL(merged.Source(7).Name(), "c2");
+
+	// a has measurements at the same frequency, which are averaged
+	const MeasuredSED& a = merged.Source(0).Peak().MSED();
+	BOOST_CHECK_EQUAL(a.MeasurementCount(), 1u);
+	BOOST_CHECK_CLOSE(double(a.FluxAtFrequencyFromIndex(150e6, 0)), 2.0, 1e-6);
+	// c gets the measurement of c1 at a new frequency
+	const MeasuredSED& c = merged.Source(2).Peak().MSED();
+	BOOST_CHECK_EQUAL(c.MeasurementCount(), 2u);
+	BOOST_CHECK_CLOSE(double(c.FluxAtFrequencyFromIndex(160e6, 0)), 2.0, 1e-6);
+	BOOST_CHECK_EQUAL(merged.Source(2).ComponentCount(), 1u);
+	// Unmatched sources of the first model are unchanged
+	BOOST_CHECK_EQUAL(merged.Source(1).Peak().MSED().MeasurementCount(), 1u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#ifndef TEST_DATA_H
+#define TEST_DATA_H
+
+#include "../model/measuredsed.h"
+#include "../model/modelcomponent.h"
+#include "../model/modelsource.h"
+
+#include <cstdlib>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+/** A point component with a single Stokes I measurement. */
+inline ModelComponent MakeComponent(double ra, double dec, double frequency = 150e6, double flux = 1.0)
+{
+	ModelComponent component;
+	component.SetPosRA(ra);
+	component.SetPosDec(dec);
+	MeasuredSED sed;
+	Measurement measurement;
+	measurement.SetFrequencyHz(frequency);
+	measurement.SetFluxDensityFromIndex(0, flux);
+	sed.AddMeasurement(measurement);
+	component.SetSED(sed);
+	return component;
+}
+
+/** A source with a single component, see MakeComponent(). */
+inline ModelSource MakeSource(const std::string& name, const std::string& cluster, double ra, double dec, double frequency = 150e6, double flux = 1.0)
+{
+	ModelSource source;
+	source.SetName(name);
+	source.SetClusterName(cluster);
+	source.AddComponent(MakeComponent(ra, dec, frequency, flux));
+	return source;
+}
+
+/** A new directory in the temporary directory, removed with its contents on destruction. */
+class TemporaryDirectory
+{
+	public:
+		TemporaryDirectory()
+		{
+			std::string pattern = (std::filesystem::temp_directory_path() / "sourceresponse-test-XXXXXX").string();
+			if(mkdtemp(&pattern[0]) == nullptr)
+				throw std::runtime_error("Could not create a temporary directory");
+			_path = pattern;
+		}
+
+		~TemporaryDirectory()
+		{
+			std::error_code error;
+			std::filesystem::remove_all(_path, error);
+		}
+
+		TemporaryDirectory(const TemporaryDirectory&) = delete;
+		TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+		const std::string& Path() const { return _path; }
+
+		std::string File(const std::string& name) const { return _path + "/" + name; }
+
+	private:
+		std::string _path;
+};
+
+#endif
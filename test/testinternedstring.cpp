@@ -0,0 +1,44 @@
+#include "../model/internedstring.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+BOOST_AUTO_TEST_SUITE(internedstring)
+
+BOOST_AUTO_TEST_CASE( interning )
+{
+	const InternedString a("test-interning-a"), b(std::string("test-interning-a")), c("test-interning-c");
+	BOOST_CHECK(a == b);
+	BOOST_CHECK(a != c);
+	BOOST_CHECK_EQUAL(&a.Str(), &b.Str());
+	BOOST_CHECK_EQUAL(a.Str(), "test-interning-a");
+	BOOST_CHECK_EQUAL(InternedString::Hash()(a), InternedString::Hash()(b));
+
+	const InternedString empty;
+	BOOST_CHECK(empty.Empty());
+	BOOST_CHECK_EQUAL(empty.Str(), "");
+	BOOST_CHECK(!a.Empty());
+	BOOST_CHECK(InternedString("").Empty());
+}
+
+BOOST_AUTO_TEST_CASE( find )
+{
+	InternedString found;
+	BOOST_CHECK(!InternedString::Find("test-find", found));
+	{
+		const InternedString string("test-find");
+		BOOST_REQUIRE(InternedString::Find("test-find", found));
+		BOOST_CHECK(found == string);
+	}
+	// found still holds a reference
+	BOOST_CHECK_EQUAL(found.Str(), "test-find");
+	InternedString copy(found);
+	found = InternedString();
+	BOOST_CHECK_EQUAL(copy.Str(), "test-find");
+	copy = InternedString();
+	// The string is released with its last reference
+	BOOST_CHECK(!InternedString::Find("test-find", found));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+#include "testdata.h"
+
+#include "../model/model.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace {
+	const std::string goodSource =
+		"source {\n"
+		"  name \"good\"\n"
+		"  component {\n"
+		"    type point\n"
+		"    position 08h13m36.0s 48d12m15.0s\n"
+		"    sed {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy 2 0 0 0\n"
+		"      spectral-index { -0.7 }\n"
+		"    }\n"
+		"  }\n"
+		"  component {\n"
+		"    type gaussian\n"
+		"    position 08h13m40.0s 48d12m30.0s\n"
+		"    shape 20 10 45\n"
+		"    measurement {\n"
+		"      frequency 120 MHz\n"
+		"      fluxdensity Jy 1.5 0.25 0 0\n"
+		"    }\n"
+		"    measurement {\n"
+		"      frequency 180 MHz\n"
+		"      fluxdensity Jy 1 0.125 0 0\n"
+		"    }\n"
+		"  }\n"
+		"}\n";
+
+	/** A source with a single component with the given SED blocks. */
+	std::string makeSource(const std::string& name, const std::string& sedBlocks)
+	{
+		return "source {\n"
+			"  name \"" + name + "\"\n"
+			"  component {\n"
+			"    type point\n"
+			"    position 08h14m00.0s 48d00m00.0s\n" +
+			sedBlocks +
+			"  }\n"
+			"}\n";
+	}
+
+	std::string writeModel(const TemporaryDirectory& directory, const std::string& sources)
+	{
+		const std::string filename = directory.File("model.txt");
+		std::ofstream file(filename);
+		file << "skymodel fileformat 1.1\n" << sources;
+		return filename;
+	}
+
+	std::string toText(const Model& model)
+	{
+		std::ostringstream stream;
+		model.Save(stream);
+		return stream.str();
+	}
+
+	bool throwsMessage(const std::runtime_error& error, const std::string& message)
+	{
+		return error.what() == message;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(lazysed)
+
+BOOST_AUTO_TEST_CASE( fluxes_match_eager )
+{
+	TemporaryDirectory directory;
+	const std::string filename = writeModel(directory, goodSource + makeSource("second",
+		"    sed {\n"
+		"      frequency 60 MHz\n"
+		"      fluxdensity Jy 10 1 2 3\n"
+		"      spectral-index { -0.8 0.1 }\n"
+		"    }\n"));
+	const Model eager(filename, false);
+	const Model lazy = Model::ReadIndex(filename);
+	BOOST_REQUIRE_EQUAL(lazy.SourceCount(), eager.SourceCount());
+	for(size_t s=0; s!=lazy.SourceCount(); ++s)
+	{
+		const ModelSource& lazySource = lazy.Source(s);
+		const ModelSource& eagerSource = eager.Source(s);
+		BOOST_CHECK_EQUAL(lazySource.Name(), eagerSource.Name());
+		BOOST_REQUIRE_EQUAL(lazySource.ComponentCount(), eagerSource.ComponentCount());
+		for(size_t c=0; c!=lazySource.ComponentCount(); ++c)
+		{
+			const ModelComponent& lazyComponent = lazySource.Component(c);
+			const ModelComponent& eagerComponent = eagerSource.Component(c);
+			BOOST_CHECK(lazyComponent.HasUnparsedSED());
+			BOOST_CHECK(!eagerComponent.HasUnparsedSED());
+			BOOST_CHECK_EQUAL(lazyComponent.PosRA(), eagerComponent.PosRA());
+			BOOST_CHECK_EQUAL(lazyComponent.PosDec(), eagerComponent.PosDec());
+			for(double frequency : { 100e6, 150e6, 200e6 })
+			{
+				for(size_t p=0; p!=4; ++p)
+					BOOST_CHECK_EQUAL(lazyComponent.SED().FluxAtFrequencyFromIndex(frequency, p), eagerComponent.SED().FluxAtFrequencyFromIndex(frequency, p));
+			}
+		}
+	}
+	BOOST_CHECK(lazy.Source(0).Component(0).HasPowerLawSED());
+	BOOST_CHECK(lazy.Source(0).Component(1).HasMeasuredSED());
+	BOOST_CHECK_EQUAL(toText(lazy), toText(eager));
+}
+
+BOOST_AUTO_TEST_CASE( error_on_access )
+{
+	TemporaryDirectory directory;
+	const std::string filename = writeModel(directory, goodSource + makeSource("broken",
+		"    sed {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy abc 0 0 0\n"
+		"      spectral-index { -0.7 }\n"
+		"    }\n"));
+	const auto isNumberError = [](const std::runtime_error& e) { return throwsMessage(e, "Expecting number, got 'abc'"); };
+	BOOST_CHECK_EXCEPTION(Model(filename, false), std::runtime_error, isNumberError);
+
+	// The error is only found when the SED is first used, and again on every later use
+	const Model model = Model::ReadIndex(filename);
+	BOOST_REQUIRE_EQUAL(model.SourceCount(), 2u);
+	BOOST_CHECK_EQUAL(model.Source(1).Name(), "broken");
+	const ModelComponent& broken = model.Source(1).Peak();
+	BOOST_CHECK(broken.HasSED());
+	BOOST_CHECK(broken.HasUnparsedSED());
+	BOOST_CHECK_EXCEPTION(broken.SED(), std::runtime_error, isNumberError);
+	BOOST_CHECK_EXCEPTION(broken.SED(), std::runtime_error, isNumberError);
+	BOOST_CHECK_EQUAL(model.Source(0).Peak().SED().FluxAtFrequencyFromIndex(150e6, 0), 2.0);
+}
+
+BOOST_AUTO_TEST_CASE( measurement_and_sed )
+{
+	TemporaryDirectory directory;
+	const std::string filename = writeModel(directory, goodSource + makeSource("both",
+		"    measurement {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy 1 0 0 0\n"
+		"    }\n"
+		"    sed {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy 2 0 0 0\n"
+		"      spectral-index { -0.7 }\n"
+		"    }\n"));
+	const auto isCombinationError = [](const std::runtime_error& e) { return throwsMessage(e, "Invalid 'sed' combined with other brightness specification"); };
+	BOOST_CHECK_EXCEPTION(Model(filename, false), std::runtime_error, isCombinationError);
+
+	// Both blocks are kept as the text of one lazy SED, which fails when it is parsed
+	const Model model = Model::ReadIndex(filename);
+	BOOST_REQUIRE_EQUAL(model.SourceCount(), 2u);
+	const ModelComponent& both = model.Source(1).Peak();
+	BOOST_CHECK(both.HasUnparsedSED());
+	BOOST_CHECK_EXCEPTION(both.SED(), std::runtime_error, isCombinationError);
+	BOOST_CHECK_EXCEPTION(both.HasMeasuredSED(), std::runtime_error, isCombinationError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#include "testdata.h"
+
+#include "../benchmark/syntheticdata.h"
+
+#include "../lofarbeambackend.h"
+#include "../metadata.h"
+
+#include <StationResponse/LofarMetaDataUtil.h>
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <complex>
+#include <vector>
+
+namespace {
+	BeamBackend::Vector3 normalized(double x, double y, double z)
+	{
+		const double norm = std::sqrt(x*x + y*y + z*z);
+		return BeamBackend::Vector3{{ x / norm, y / norm, z / norm }};
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(lofarbeambackend)
+
+BOOST_AUTO_TEST_CASE( hba_station_matches_library )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("hba.ms");
+	SyntheticMSOptions options;
+	options.stationCount = 2;
+	options.elementsPerStation = 8;
+	options.timestepCount = 1;
+	options.centreFrequency = 150e6;
+	options.hba = true;
+	CreateSyntheticMS(filename, options);
+
+	casacore::MeasurementSet ms(filename);
+	const MetaData metaData = MetaData::FromMS(ms);
+	const LofarBeamBackend backend(metaData.Stations());
+	std::vector<LOFAR::StationResponse::Station::Ptr> stations(ms.antenna().nrow());
+	LOFAR::StationResponse::readStations(ms, stations.begin());
+
+	// Directions near the zenith of the core, with the tile beam off the delay direction
+	const BeamBackend::Vector3
+		delayDirection = normalized(3826577.0, 461023.0, 5064893.0),
+		tileBeamDirection = normalized(3826577.0, 461023.0 + 1e5, 5064893.0),
+		direction = normalized(3826577.0 + 2e5, 461023.0, 5064893.0);
+	const LOFAR::StationResponse::vector3r_t
+		lofarDelay = {{ delayDirection[0], delayDirection[1], delayDirection[2] }},
+		lofarTile = {{ tileBeamDirection[0], tileBeamDirection[1], tileBeamDirection[2] }},
+		lofarDirection = {{ direction[0], direction[1], direction[2] }};
+	const double time = options.startTime, frequency = 150e6;
+	for(size_t station=0; station!=stations.size(); ++station)
+	{
+		std::complex<double> jones[4];
+		backend.Response(station, time, frequency, direction, delayDirection, tileBeamDirection, jones);
+		const LOFAR::StationResponse::matrix22c_t expected = stations[station]->response(time, frequency, lofarDirection, frequency, lofarDelay, lofarTile);
+		const std::complex<double> expectedJones[4] = { expected[0][0], expected[0][1], expected[1][0], expected[1][1] };
+		for(size_t i=0; i!=4; ++i)
+			BOOST_CHECK_SMALL(std::abs(jones[i] - expectedJones[i]), 1e-9 * std::abs(expectedJones[i]) + 1e-12);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,87 @@
+#include "testdata.h"
+
+#include "../benchmark/syntheticdata.h"
+
+#include "../metadata.h"
+#include "../observation.h"
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+#include <casacore/tables/Tables/ArrayColumn.h>
+#include <casacore/tables/Tables/Table.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+
+namespace {
+	SyntheticMSOptions smallOptions()
+	{
+		SyntheticMSOptions options;
+		options.stationCount = 3;
+		options.elementsPerStation = 4;
+		options.timestepCount = 2;
+		options.channelCount = 4;
+		return options;
+	}
+
+	/** Flags the X dipole of the first element of the first station. */
+	void flagElement(const std::string& filename)
+	{
+		casacore::MeasurementSet ms(filename, casacore::Table::Update);
+		casacore::Table antennaFieldTable(ms.keywordSet().asTable("LOFAR_ANTENNA_FIELD"));
+		antennaFieldTable.reopenRW();
+		casacore::ArrayColumn<bool> flagColumn(antennaFieldTable, "ELEMENT_FLAG");
+		casacore::Array<bool> flags = flagColumn(0);
+		flags(casacore::IPosition(2, 0, 0)) = true;
+		flagColumn.put(0, flags);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(metadata)
+
+BOOST_AUTO_TEST_CASE( element_flags_change_the_layout )
+{
+	TemporaryDirectory directory;
+	const std::string first = directory.File("first.ms"), second = directory.File("second.ms");
+	CreateSyntheticMS(first, smallOptions());
+	CreateSyntheticMS(second, smallOptions());
+
+	std::unique_ptr<casacore::MeasurementSet> ms;
+	const MetaData unchanged = ReadMetaData(second, std::string(), ms);
+	const MetaData firstMetaData = ReadMetaData(first, std::string(), ms);
+	BOOST_CHECK_EQUAL(unchanged.LayoutKey(), firstMetaData.LayoutKey());
+	BOOST_CHECK_EQUAL(unchanged.Key(), firstMetaData.Key());
+
+	ms.reset();
+	flagElement(second);
+	const MetaData flagged = ReadMetaData(second, std::string(), ms);
+	BOOST_REQUIRE(!flagged.Stations()[0].fields[0].elements[0].enabled[0]);
+	BOOST_CHECK_NE(flagged.LayoutKey(), firstMetaData.LayoutKey());
+	BOOST_CHECK_NE(flagged.Key(), firstMetaData.Key());
+
+	// Batch mode only shares the beam between observations with the same layout
+	StationCache stationCache("analytic");
+	const std::shared_ptr<const BeamBackend> firstBeam = ReadBeam(firstMetaData, stationCache);
+	BOOST_CHECK(ReadBeam(unchanged, stationCache) == firstBeam);
+	BOOST_CHECK(ReadBeam(flagged, stationCache) != firstBeam);
+}
+
+BOOST_AUTO_TEST_CASE( sidecar_has_the_same_keys )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("observation.ms"), sidecar = directory.File("observation.sidecar");
+	SyntheticMSOptions options = smallOptions();
+	options.hba = true;
+	CreateSyntheticMS(filename, options);
+	std::unique_ptr<casacore::MeasurementSet> ms;
+	// Writes the sidecar, and reads it the second time
+	const MetaData fromMS = ReadMetaData(filename, sidecar, ms);
+	BOOST_REQUIRE(ms);
+	ms.reset();
+	const MetaData fromSidecar = ReadMetaData(filename, sidecar, ms);
+	BOOST_CHECK(!ms);
+	BOOST_CHECK_EQUAL(fromSidecar.LayoutKey(), fromMS.LayoutKey());
+	BOOST_CHECK_EQUAL(fromSidecar.Key(), fromMS.Key());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
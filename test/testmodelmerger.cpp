@@ -0,0 +1,101 @@
+#include "testdata.h"
+
+#include "../model/model.h"
+#include "../model/modelmerger.h"
+#include "../model/modelview.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+namespace {
+	/**
+	 * Adds two models to the merger that have a source in common, measured at
+	 * 150 MHz in both: with a flux density of 1 Jy in the first and of 3 Jy in
+	 * the second. The second also measured it at 160 MHz, and has a second
+	 * source. The common source is offset by 1e-7 rad in the second model.
+	 */
+	void addModels(ModelMerger& merger)
+	{
+		Model first, second;
+		first.AddSource(MakeSource("common", "c1", 1.0, 0.5, 150e6, 1.0));
+		ModelSource common = MakeSource("common", "c1", 1.0, 0.5 + 1e-7, 150e6, 3.0);
+		common.Peak().MSED().AddMeasurement(5.0, 160e6);
+		second.AddSource(common);
+		second.AddSource(MakeSource("other", "c2", 2.0, -0.5, 150e6, 4.0));
+		merger.Add(first);
+		merger.Add(second);
+	}
+
+	double fluxAt(const Model& model, size_t source, double frequency)
+	{
+		return model.Source(source).Peak().MSED().FluxAtFrequencyFromIndex(frequency, 0);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(modelmerger)
+
+BOOST_AUTO_TEST_CASE( collision_policies )
+{
+	const ModelMerger::CollisionPolicy policies[] = { ModelMerger::KeepFirstMeasurement, ModelMerger::KeepLastMeasurement, ModelMerger::AverageMeasurements };
+	const double expected[] = { 1.0, 3.0, 2.0 };
+	for(size_t i=0; i!=3; ++i)
+	{
+		ModelMerger merger(1e-6, policies[i]);
+		addModels(merger);
+		const Model merged = merger.Finish();
+		BOOST_REQUIRE_EQUAL(merged.SourceCount(), 2u);
+		BOOST_CHECK_EQUAL(merged.ClusterCount(), 2u);
+		BOOST_CHECK_EQUAL(merged.Source(0).Name(), "common");
+		BOOST_CHECK_EQUAL(merged.Source(0).ComponentCount(), 1u);
+		BOOST_CHECK_EQUAL(merged.Source(0).Peak().MSED().MeasurementCount(), 2u);
+		BOOST_CHECK_CLOSE(fluxAt(merged, 0, 150e6), expected[i], 1e-6);
+		BOOST_CHECK_CLOSE(fluxAt(merged, 0, 160e6), 5.0, 1e-6);
+		BOOST_CHECK_EQUAL(merged.Source(1).Name(), "other");
+		BOOST_CHECK_CLOSE(fluxAt(merged, 1, 150e6), 4.0, 1e-6);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( reject_collisions )
+{
+	ModelMerger merger(1e-6, ModelMerger::RejectCollisions);
+	addModels(merger);
+	BOOST_CHECK_THROW(merger.Finish(), std::runtime_error);
+	// The merger is unchanged, so it fails in the same way again
+	BOOST_CHECK_THROW(merger.Finish(), std::runtime_error);
+
+	ModelMerger distinct(1e-6, ModelMerger::RejectCollisions);
+	distinct.AddSource(MakeSource("a", "", 1.0, 0.5, 150e6, 1.0));
+	distinct.AddSource(MakeSource("a", "", 1.0, 0.5, 160e6, 2.0));
+	const Model merged = distinct.Finish();
+	BOOST_REQUIRE_EQUAL(merged.SourceCount(), 1u);
+	BOOST_CHECK_EQUAL(merged.Source(0).Peak().MSED().MeasurementCount(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE( tolerance )
+{
+	// Outside the tolerance, the common source is not combined
+	ModelMerger merger(1e-8, ModelMerger::KeepFirstMeasurement);
+	addModels(merger);
+	const Model merged = merger.Finish();
+	BOOST_CHECK_EQUAL(merged.ComponentCount(), 3u);
+
+	// A tolerance far below the precision of a direction only matches equal directions
+	ModelMerger exact(1e-20, ModelMerger::AverageMeasurements);
+	exact.AddSource(MakeSource("a", "", 1.0, 0.5, 150e6, 1.0));
+	exact.AddSource(MakeSource("a", "", 1.0, 0.5, 150e6, 3.0));
+	exact.AddSource(MakeSource("b", "", 1.0, 0.5 + 1e-9, 150e6, 3.0));
+	const Model exactMerged = exact.Finish();
+	BOOST_CHECK_EQUAL(exactMerged.ComponentCount(), 2u);
+	BOOST_CHECK_CLOSE(fluxAt(exactMerged, 0, 150e6), 2.0, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE( finish_clears )
+{
+	ModelMerger merger(1e-6, ModelMerger::AverageMeasurements);
+	addModels(merger);
+	BOOST_CHECK_EQUAL(merger.Finish().SourceCount(), 2u);
+	BOOST_CHECK_EQUAL(merger.Finish().SourceCount(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
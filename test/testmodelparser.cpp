@@ -0,0 +1,121 @@
+#include "../model/model.h"
+#include "../model/modelparser.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+	/**
+	 * A model text with sourceCount sources. Every tenth source has a name
+	 * that spans lines and holds braces, a '#' and the word "source" at the
+	 * start of a line, and the sources hold comments with quotes in them.
+	 */
+	std::string makeText(size_t sourceCount)
+	{
+		std::ostringstream text;
+		text << "skymodel fileformat 1.1\n"
+			"// A comment with a \"quote\n";
+		for(size_t i=0; i!=sourceCount; ++i)
+		{
+			text << "source {\n";
+			if(i%10 == 3)
+				text << "  name \"tricky " << i << " {\n}\n# source {\nsource\"\n";
+			else
+				text << "  name \"s" << i << "\"\n";
+			text << "  cluster \"c" << i%7 << "\"\n"
+				"  // don't \"open a string here\n"
+				"  component {\n"
+				"    type point\n"
+				"    position 08h13m" << (i%60) << ".0s 48d12m15.0s\n";
+			if(i%2 == 0)
+				text << "    sed {\n"
+					"      frequency 150 MHz\n"
+					"      fluxdensity Jy " << (i%100 + 1) << " 0 0 0\n"
+					"      spectral-index { -0.7 }\n"
+					"    }\n";
+			else
+				text << "    measurement {\n"
+					"      frequency 150 MHz\n"
+					"      fluxdensity Jy " << (i%100 + 1) << " 0 0 0\n"
+					"    }\n";
+			text << "  }\n}\n";
+		}
+		return text.str();
+	}
+
+	Model parse(const std::string& text, size_t threadCount)
+	{
+		Model model;
+		ModelParser(threadCount).Parse(model, text.data(), text.size());
+		return model;
+	}
+
+	std::string toText(const Model& model)
+	{
+		std::ostringstream stream;
+		model.Save(stream);
+		return stream.str();
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(modelparser)
+
+BOOST_AUTO_TEST_CASE( thread_count )
+{
+	// Large enough to be parsed in parallel
+	const std::string text = makeText(6000);
+	BOOST_REQUIRE_GT(text.size(), 1024u*1024u);
+
+	const Model serial = parse(text, 1);
+	BOOST_REQUIRE_EQUAL(serial.SourceCount(), 6000u);
+	BOOST_CHECK_EQUAL(serial.ClusterCount(), 7u);
+	BOOST_CHECK_EQUAL(serial.Source(3).Name(), "tricky 3 {\n}\n# source {\nsource");
+	const std::string expected = toText(serial);
+	for(size_t threadCount : { 2, 4, 7 })
+	{
+		const Model parallel = parse(text, threadCount);
+		BOOST_CHECK_EQUAL(parallel.SourceCount(), serial.SourceCount());
+		BOOST_CHECK_EQUAL(parallel.ClusterCount(), serial.ClusterCount());
+		BOOST_CHECK(toText(parallel) == expected);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( forced_chunks )
+{
+	// Smaller than the size that is parsed in parallel, so the chunks are
+	// forced by a small chunk size, which puts a part start at almost every line
+	const std::string text = makeText(25);
+	const std::string expected = toText(parse(text, 1));
+	for(size_t chunkSize : { 8, 64, 500 })
+	{
+		ModelParser parser(4);
+		parser.Start(text.data(), text.size());
+		const std::vector<const char*> boundaries = parser.SplitIntoChunks(chunkSize);
+		BOOST_REQUIRE_GT(boundaries.size(), 2u);
+		BOOST_CHECK(boundaries.back() == text.data() + text.size());
+		for(size_t i=1; i+1!=boundaries.size(); ++i)
+		{
+			BOOST_CHECK(boundaries[i] > boundaries[i-1]);
+			BOOST_CHECK_EQUAL(std::string(boundaries[i], 8), "source {");
+		}
+
+		Model model;
+		for(size_t i=0; i+1!=boundaries.size(); ++i)
+		{
+			std::vector<ModelSource> sources;
+			parser.ParseChunk(boundaries[i], boundaries[i+1], sources);
+			for(ModelSource& source : sources)
+			{
+				model.FindOrAddCluster(source.ClusterName());
+				model.AddSource(std::move(source));
+			}
+		}
+		BOOST_CHECK_EQUAL(model.SourceCount(), 25u);
+		BOOST_CHECK(toText(model) == expected);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
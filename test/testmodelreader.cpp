@@ -0,0 +1,136 @@
+#include "testdata.h"
+
+#include "../model/bbsmodel.h"
+#include "../model/binarymodel.h"
+#include "../model/model.h"
+#include "../model/modelreader.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+	Model makeModel(size_t sourceCount)
+	{
+		Model model;
+		for(size_t i=0; i!=sourceCount; ++i)
+		{
+			const std::string cluster = "c" + std::to_string(i%5);
+			model.FindOrAddCluster(cluster);
+			const double ra = 0.5 + (i%1000) * 1e-3, dec = 0.25 + (i/1000) * 1e-3;
+			ModelSource source = MakeSource("s" + std::to_string(i), cluster, ra, dec, 150e6, 1.0 + i%10);
+			if(i%3 == 0)
+				source.AddComponent(MakeComponent(ra + 1e-5, dec, 120e6, 0.5));
+			model.AddSource(std::move(source));
+		}
+		return model;
+	}
+
+	std::string sourcesText(const Model& model)
+	{
+		std::string text;
+		for(const ModelSource& source : model)
+			text += source.ToString();
+		return text;
+	}
+
+	/**
+	 * Reads the model in batches of several sizes and checks that the sources
+	 * are those of the expected text, in the same order.
+	 */
+	void checkBatches(const std::string& filename, const std::string& expected, size_t sourceCount)
+	{
+		for(size_t batchSize : { 1, 3, 1000, 100000 })
+		{
+			ModelReader reader(filename);
+			std::vector<ModelSource> batch;
+			std::string text;
+			size_t count = 0;
+			bool hadPartialBatch = false;
+			while(reader.Read(batch, batchSize))
+			{
+				// Only the last batch may be smaller than requested
+				BOOST_CHECK(!hadPartialBatch);
+				BOOST_CHECK_LE(batch.size(), batchSize);
+				hadPartialBatch = batch.size() != batchSize;
+				count += batch.size();
+				for(const ModelSource& source : batch)
+					text += source.ToString();
+			}
+			BOOST_CHECK(batch.empty());
+			BOOST_CHECK(!reader.Read(batch, batchSize));
+			BOOST_CHECK_EQUAL(count, sourceCount);
+			BOOST_CHECK(text == expected);
+		}
+	}
+
+	/** Reads a text model, then reads it again through the cache that Model writes. */
+	void checkTextAndCache(const std::string& filename, size_t sourceCount)
+	{
+		const std::string cacheFilename = BinaryModel::CacheFilename(filename);
+		const std::string expected = sourcesText(Model(filename, false));
+		checkBatches(filename, expected, sourceCount);
+		// The reader does not write the cache
+		BOOST_CHECK(!std::filesystem::exists(cacheFilename));
+
+		BOOST_CHECK(sourcesText(Model(filename)) == expected);
+		BOOST_REQUIRE(std::filesystem::exists(cacheFilename));
+		checkBatches(filename, expected, sourceCount);
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(modelreader)
+
+BOOST_AUTO_TEST_CASE( text )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.txt");
+	makeModel(20).Save(filename);
+	checkTextAndCache(filename, 20);
+}
+
+BOOST_AUTO_TEST_CASE( chunks )
+{
+	// Large enough to be split into several chunks when there are several threads
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.txt");
+	makeModel(20000).Save(filename);
+	BOOST_REQUIRE_GT(std::filesystem::file_size(filename), 3u*1024u*1024u);
+	checkTextAndCache(filename, 20000);
+}
+
+BOOST_AUTO_TEST_CASE( binary )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.bin");
+	makeModel(50).Save(filename, true);
+	checkBatches(filename, sourcesText(Model(filename)), 50);
+}
+
+BOOST_AUTO_TEST_CASE( bbs )
+{
+	TemporaryDirectory directory;
+	const std::string filename = directory.File("model.skymodel");
+	{
+		std::ofstream file(filename);
+		file << "format = Name, Type, Patch, Ra, Dec, I, SpectralIndex, ReferenceFrequency\n"
+			"# A comment\n"
+			", , p1, 08h13m36.0s, 48d12m15.0s,\n";
+		for(size_t i=0; i!=25; ++i)
+		{
+			if(i == 10)
+				file << ", , p2, 08h14m00.0s, 48d00m00.0s,\n";
+			file << "s" << i << ", POINT, " << (i < 10 ? "p1" : "p2") << ", 08h13m" << (10 + i) << ".0s, 48d12m15.0s, " << (1.0 + i) << ", [-0.7, 0.1], 150e6,\n";
+		}
+	}
+	const Model model = BBSModel::Read(filename);
+	BOOST_REQUIRE_EQUAL(model.SourceCount(), 25u);
+	BOOST_CHECK_EQUAL(model.Source(12).Name(), "s12");
+	BOOST_CHECK_EQUAL(model.Source(12).ClusterName(), "p2");
+	checkBatches(filename, sourcesText(model), 25);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
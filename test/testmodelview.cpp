@@ -0,0 +1,77 @@
+#include "testdata.h"
+
+#include "../model/model.h"
+#include "../model/modelview.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+namespace {
+	/** Sources s0 to s9, in the clusters c0 to c2. */
+	Model makeModel()
+	{
+		Model model;
+		for(size_t i=0; i!=10; ++i)
+		{
+			const std::string cluster = "c" + std::to_string(i % 3);
+			model.FindOrAddCluster(cluster);
+			model.AddSource(MakeSource("s" + std::to_string(i), cluster, 0.1 * i, 0.0, 150e6, 1.0 + i));
+		}
+		return model;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(modelview)
+
+BOOST_AUTO_TEST_CASE( complete_view )
+{
+	const Model model = makeModel();
+	const ModelView view(model);
+	BOOST_CHECK_EQUAL(view.SourceCount(), 10u);
+	BOOST_CHECK_EQUAL(view.ComponentCount(), 10u);
+	size_t index = 0;
+	for(ModelView::const_iterator i=view.begin(); i!=view.end(); ++i)
+	{
+		BOOST_CHECK_EQUAL(i.ModelIndex(), index);
+		BOOST_CHECK_EQUAL(&*i, &model.Source(index));
+		++index;
+	}
+	BOOST_CHECK_EQUAL(index, 10u);
+}
+
+BOOST_AUTO_TEST_CASE( cluster_and_filter )
+{
+	const Model model = makeModel();
+	const ModelView cluster = ModelView(model).Cluster("c1");
+	BOOST_REQUIRE_EQUAL(cluster.SourceCount(), 3u);
+	BOOST_CHECK_EQUAL(cluster.ModelIndex(0), 1u);
+	BOOST_CHECK_EQUAL(cluster.ModelIndex(1), 4u);
+	BOOST_CHECK_EQUAL(cluster.ModelIndex(2), 7u);
+	BOOST_CHECK_EQUAL(&cluster.Source(1), &model.Source(4));
+	// s1 + s4 + s7 have 2 + 5 + 8 Jy
+	BOOST_CHECK_CLOSE(cluster.TotalFlux(150e6, aocommon::Polarization::StokesI), 15.0, 1e-6);
+
+	const ModelView bright = ModelView(model).Filter([](const ModelSource& source) { return source.Name() >= "s5"; });
+	BOOST_CHECK_EQUAL(bright.SourceCount(), 5u);
+	const ModelView brightCluster = bright.Cluster("c1");
+	BOOST_REQUIRE_EQUAL(brightCluster.SourceCount(), 1u);
+	BOOST_CHECK_EQUAL(brightCluster.Source(0).Name(), "s7");
+
+	BOOST_CHECK(ModelView(model).Cluster("none").Empty());
+	BOOST_CHECK(bright.Cluster("none").Empty());
+}
+
+BOOST_AUTO_TEST_CASE( to_model )
+{
+	const Model model = makeModel();
+	const Model copy = ModelView(model).Cluster("c2").ToModel();
+	BOOST_REQUIRE_EQUAL(copy.SourceCount(), 3u);
+	BOOST_CHECK_EQUAL(copy.ClusterCount(), 1u);
+	BOOST_CHECK_EQUAL(copy.Source(0).Name(), "s2");
+	BOOST_CHECK_EQUAL(copy.Source(2).Name(), "s8");
+	BOOST_CHECK_EQUAL(copy.FindSourceIndex("s5"), 1u);
+	BOOST_CHECK_EQUAL(copy.FindSourceIndex("s1"), Model::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,138 @@
+#include "testdata.h"
+
+#include "../benchmark/syntheticdata.h"
+
+#include "../metadata.h"
+#include "../observation.h"
+
+#include <casacore/ms/MeasurementSets/MeasurementSet.h>
+#include <casacore/ms/MeasurementSets/MSMainColumns.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+	/**
+	 * A small measurement set with a single field and two rows per timestep,
+	 * that is followed as it grows.
+	 */
+	struct GrowingObservation
+	{
+		GrowingObservation() :
+			filename(directory.File("observation.ms")),
+			stationCache("analytic")
+		{
+			options.stationCount = 3;
+			options.elementsPerStation = 4;
+			options.timestepCount = 4;
+			options.rowsPerTimestep = 2;
+			options.channelCount = 4;
+			CreateSyntheticMS(filename, options);
+			metaData = ReadMetaData(filename, std::string(), ms);
+		}
+
+		ObservationInfo Read(const TimeSelection& selection)
+		{
+			return MakeObservationInfo(metaData, ReadBeam(metaData, stationCache), ReadTimeIndex(*ms, metaData, selection), selection.stride, std::vector<double>(), true);
+		}
+
+		double Time(size_t timestep) const { return options.startTime + (timestep + 0.5) * options.interval; }
+
+		/** Appends the rows of the timesteps that follow the existing ones, as the writer of the observation would. */
+		void Append(size_t timestepCount)
+		{
+			{
+				casacore::MeasurementSet writer(filename, casacore::Table::Update);
+				const size_t firstRow = writer.nrow();
+				writer.addRow(timestepCount * options.rowsPerTimestep);
+				casacore::MSMainColumns columns(writer);
+				for(size_t row=firstRow; row!=writer.nrow(); ++row)
+				{
+					const size_t timestep = writtenTimesteps + (row - firstRow) / options.rowsPerTimestep;
+					columns.time().put(row, Time(timestep));
+					columns.fieldId().put(row, 0);
+					columns.dataDescId().put(row, 0);
+				}
+				writtenTimesteps += timestepCount;
+			}
+			ms->resync();
+		}
+
+		TemporaryDirectory directory;
+		std::string filename;
+		SyntheticMSOptions options;
+		StationCache stationCache;
+		std::unique_ptr<casacore::MeasurementSet> ms;
+		MetaData metaData;
+		size_t writtenTimesteps = 4;
+	};
+}
+
+BOOST_AUTO_TEST_SUITE(observation)
+
+BOOST_AUTO_TEST_CASE( append_new_timesteps )
+{
+	GrowingObservation observation;
+	const TimeSelection selection;
+	ObservationInfo info = observation.Read(selection);
+	BOOST_REQUIRE_EQUAL(info.fields.size(), 1u);
+	const FieldInfo& field = info.fields[0];
+	BOOST_REQUIRE_EQUAL(field.times.size(), 4u);
+	BOOST_CHECK_EQUAL(info.rowCount, 8u);
+	BOOST_CHECK_EQUAL(AppendNewTimesteps(info, *observation.ms, selection), 0u);
+
+	observation.Append(3);
+	BOOST_CHECK_EQUAL(AppendNewTimesteps(info, *observation.ms, selection), 3u);
+	BOOST_CHECK_EQUAL(info.rowCount, 14u);
+	BOOST_REQUIRE_EQUAL(field.times.size(), 7u);
+	for(size_t timestep=0; timestep!=7; ++timestep)
+		BOOST_CHECK_EQUAL(field.times[timestep], observation.Time(timestep));
+	BOOST_CHECK_EQUAL(field.engine->TimeCount(), 7u);
+	// Rows that were already read are not added again
+	BOOST_CHECK_EQUAL(AppendNewTimesteps(info, *observation.ms, selection), 0u);
+	BOOST_CHECK_EQUAL(field.times.size(), 7u);
+}
+
+BOOST_AUTO_TEST_CASE( stride_and_range )
+{
+	GrowingObservation observation;
+	TimeSelection strided;
+	strided.stride = 2;
+	ObservationInfo stridedInfo = observation.Read(strided);
+	BOOST_CHECK_EQUAL(stridedInfo.fields[0].times.size(), 2u);
+
+	TimeSelection range;
+	range.start = observation.Time(1);
+	range.end = observation.Time(5);
+	ObservationInfo rangeInfo = observation.Read(range);
+	BOOST_CHECK_EQUAL(rangeInfo.fields[0].times.size(), 3u);
+
+	observation.Append(3);
+	// The stride continues from timestep 4, selecting timesteps 4 and 6
+	BOOST_CHECK_EQUAL(AppendNewTimesteps(stridedInfo, *observation.ms, strided), 2u);
+	const std::vector<double>& stridedTimes = stridedInfo.fields[0].times;
+	BOOST_REQUIRE_EQUAL(stridedTimes.size(), 4u);
+	BOOST_CHECK_EQUAL(stridedTimes[2], observation.Time(4));
+	BOOST_CHECK_EQUAL(stridedTimes[3], observation.Time(6));
+	// Only timesteps 4 and 5 are in the range
+	BOOST_CHECK_EQUAL(AppendNewTimesteps(rangeInfo, *observation.ms, range), 2u);
+	BOOST_CHECK_EQUAL(rangeInfo.fields[0].times.back(), observation.Time(5));
+}
+
+BOOST_AUTO_TEST_CASE( removed_rows )
+{
+	GrowingObservation observation;
+	const TimeSelection selection;
+	ObservationInfo info = observation.Read(selection);
+	{
+		casacore::MeasurementSet writer(observation.filename, casacore::Table::Update);
+		writer.removeRow(writer.nrow() - 1);
+	}
+	observation.ms->resync();
+	BOOST_CHECK_THROW(AppendNewTimesteps(info, *observation.ms, selection), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
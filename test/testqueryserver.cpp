@@ -0,0 +1,179 @@
+#include "testdata.h"
+
+#include "../benchmark/syntheticdata.h"
+
+#include "../metadata.h"
+#include "../observation.h"
+#include "../queryserver.h"
+
+#include "../model/model.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <csignal>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+	/** A model with a valid source and a source whose SED has a flux density that is not a number. */
+	const char* brokenModel =
+		"skymodel fileformat 1.1\n"
+		"source {\n"
+		"  name \"good\"\n"
+		"  component {\n"
+		"    type point\n"
+		"    position 08h13m36.0s 48d12m15.0s\n"
+		"    sed {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy 2 0 0 0\n"
+		"      spectral-index { -0.7 }\n"
+		"    }\n"
+		"  }\n"
+		"}\n"
+		"source {\n"
+		"  name \"broken\"\n"
+		"  component {\n"
+		"    type point\n"
+		"    position 08h13m40.0s 48d12m15.0s\n"
+		"    sed {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy abc 0 0 0\n"
+		"      spectral-index { -0.7 }\n"
+		"    }\n"
+		"  }\n"
+		"}\n";
+
+	QueryServer::QueryRecord makeQuery(double time, uint32_t field, uint32_t nameOffset, uint32_t nameLength)
+	{
+		QueryServer::QueryRecord query = QueryServer::QueryRecord();
+		query.time = time;
+		query.frequency = 150e6;
+		query.field = field;
+		query.nameOffset = nameOffset;
+		query.nameLength = nameLength;
+		return query;
+	}
+
+	/** Sends a request and returns the results, or an empty list after an error reply. */
+	std::vector<QueryServer::ResultRecord> request(int fd, const std::vector<QueryServer::QueryRecord>& queries, const std::string& strings)
+	{
+		QueryServer::RequestHeader header;
+		std::memcpy(header.magic, "SRQUERY1", 8);
+		header.count = queries.size();
+		header.stringTableSize = strings.size();
+		BOOST_REQUIRE_EQUAL(write(fd, &header, sizeof(header)), ssize_t(sizeof(header)));
+		BOOST_REQUIRE_EQUAL(write(fd, queries.data(), queries.size()*sizeof(queries[0])), ssize_t(queries.size()*sizeof(queries[0])));
+		BOOST_REQUIRE_EQUAL(write(fd, strings.data(), strings.size()), ssize_t(strings.size()));
+		QueryServer::ReplyHeader reply;
+		BOOST_REQUIRE_EQUAL(recv(fd, &reply, sizeof(reply), MSG_WAITALL), ssize_t(sizeof(reply)));
+		BOOST_REQUIRE(std::memcmp(reply.magic, "SRREPLY1", 8) == 0);
+		if(reply.errorLength != 0)
+			return std::vector<QueryServer::ResultRecord>();
+		std::vector<QueryServer::ResultRecord> results(reply.count);
+		BOOST_REQUIRE_EQUAL(recv(fd, results.data(), results.size()*sizeof(results[0]), MSG_WAITALL), ssize_t(results.size()*sizeof(results[0])));
+		return results;
+	}
+	/**
+	 * A daemon on a small synthetic observation with the model above, and a
+	 * client connected to it.
+	 */
+	struct Daemon
+	{
+		Daemon() :
+			stationCache("analytic"),
+			stop(0)
+		{
+			options.stationCount = 3;
+			options.elementsPerStation = 4;
+			options.timestepCount = 1;
+			CreateSyntheticMS(directory.File("observation.ms"), options);
+			std::ofstream(directory.File("model.txt")) << brokenModel;
+			model = Model::ReadIndex(directory.File("model.txt"));
+
+			std::unique_ptr<casacore::MeasurementSet> ms;
+			const MetaData metaData = ReadMetaData(directory.File("observation.ms"), std::string(), ms);
+			std::vector<QueryServer::Field> fields(1);
+			fields[0].delayDirection = metaData.DelayDirection(0);
+			fields[0].tileBeamDirection = metaData.TileBeamDirection(0);
+			const std::string socketPath = directory.File("query.sock");
+			server.reset(new QueryServer(socketPath, ReadBeam(metaData, stationCache), fields, model, 2));
+			serverThread = std::thread([this]() { server->Run(stop); });
+
+			fd = socket(AF_UNIX, SOCK_STREAM, 0);
+			sockaddr_un address = sockaddr_un();
+			address.sun_family = AF_UNIX;
+			std::strcpy(address.sun_path, socketPath.c_str());
+			BOOST_REQUIRE_EQUAL(connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+		}
+
+		~Daemon()
+		{
+			close(fd);
+			stop = 1;
+			serverThread.join();
+		}
+
+		TemporaryDirectory directory;
+		SyntheticMSOptions options;
+		StationCache stationCache;
+		Model model;
+		std::unique_ptr<QueryServer> server;
+		volatile std::sig_atomic_t stop;
+		std::thread serverThread;
+		int fd;
+	};
+}
+
+BOOST_AUTO_TEST_SUITE(queryserver)
+
+BOOST_AUTO_TEST_CASE( invalid_sed )
+{
+	Daemon daemon;
+	const std::string strings = "goodbrokenmissing";
+	const double time = daemon.options.startTime;
+	const std::vector<QueryServer::QueryRecord> queries = {
+		makeQuery(time, 0, 0, 4), makeQuery(time, 0, 4, 6), makeQuery(time, 0, 10, 7), makeQuery(time + 10.0, 0, 4, 6), makeQuery(time, 0, 0, 4)
+	};
+	// The broken SED is reported twice, and does not affect the other queries
+	for(size_t repeat=0; repeat!=2; ++repeat)
+	{
+		const std::vector<QueryServer::ResultRecord> results = request(daemon.fd, queries, strings);
+		BOOST_REQUIRE_EQUAL(results.size(), queries.size());
+		BOOST_CHECK_EQUAL(results[0].status, uint32_t(QueryServer::Ok));
+		BOOST_CHECK(results[0].averageFlux > 0.0);
+		BOOST_CHECK_EQUAL(results[1].status, uint32_t(QueryServer::InvalidSED));
+		BOOST_CHECK_EQUAL(results[1].maxFlux, 0.0);
+		BOOST_CHECK_EQUAL(results[2].status, uint32_t(QueryServer::UnknownSource));
+		BOOST_CHECK_EQUAL(results[3].status, uint32_t(QueryServer::InvalidSED));
+		BOOST_CHECK_EQUAL(results[4].status, uint32_t(QueryServer::Ok));
+		BOOST_CHECK_EQUAL(results[4].averageFlux, results[0].averageFlux);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( non_finite_time )
+{
+	Daemon daemon;
+	const double time = daemon.options.startTime;
+	const std::vector<QueryServer::QueryRecord> queries = {
+		makeQuery(time, 0, 0, 0), makeQuery(std::nan(""), 0, 0, 0), makeQuery(time, 0, 0, 4), makeQuery(INFINITY, 0, 0, 4), makeQuery(std::nan(""), 0, 0, 4)
+	};
+	const std::vector<QueryServer::ResultRecord> results = request(daemon.fd, queries, "good");
+	BOOST_REQUIRE_EQUAL(results.size(), queries.size());
+	BOOST_CHECK_EQUAL(results[0].status, uint32_t(QueryServer::Ok));
+	BOOST_CHECK_EQUAL(results[1].status, uint32_t(QueryServer::InvalidTime));
+	BOOST_CHECK_EQUAL(results[2].status, uint32_t(QueryServer::Ok));
+	BOOST_CHECK_EQUAL(results[3].status, uint32_t(QueryServer::InvalidTime));
+	BOOST_CHECK_EQUAL(results[4].status, uint32_t(QueryServer::InvalidTime));
+	BOOST_CHECK_EQUAL(results[4].averageFlux, 0.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
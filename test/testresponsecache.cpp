@@ -0,0 +1,90 @@
+#include "testdata.h"
+
+#include "../responsecache.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <memory>
+#include <vector>
+
+namespace {
+	std::vector<ResponseCache::Sample> makeSamples(double time)
+	{
+		std::vector<ResponseCache::Sample> samples(10);
+		for(size_t i=0; i!=samples.size(); ++i)
+		{
+			samples[i].time = time + i;
+			samples[i].maxGain = 1.0;
+			samples[i].averageGain = 0.5;
+		}
+		return samples;
+	}
+
+	/** The size of the entries that makeSamples() produces, in bytes. */
+	uint64_t entrySize()
+	{
+		TemporaryDirectory directory;
+		ResponseCache cache(directory.Path(), 1 << 20);
+		cache.Store(1, makeSamples(0.0));
+		const std::filesystem::directory_iterator file(directory.Path());
+		BOOST_REQUIRE(file != std::filesystem::directory_iterator());
+		return file->file_size();
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(responsecache)
+
+BOOST_AUTO_TEST_CASE( store_and_find )
+{
+	TemporaryDirectory directory;
+	ResponseCache cache(directory.Path(), 1 << 20);
+	BOOST_CHECK(!cache.Find(5));
+	cache.Store(5, makeSamples(100.0));
+	std::unique_ptr<ResponseCache::Entry> entry = cache.Find(5);
+	BOOST_REQUIRE(entry);
+	BOOST_REQUIRE_EQUAL(entry->end() - entry->begin(), 10);
+	BOOST_CHECK_EQUAL(entry->begin()->time, 100.0);
+	BOOST_CHECK_EQUAL((entry->end() - 1)->time, 109.0);
+	BOOST_CHECK_EQUAL(cache.HitCount(), 1u);
+	BOOST_CHECK_EQUAL(cache.MissCount(), 1u);
+
+	// A new cache on the same directory finds the stored entries
+	ResponseCache reopened(directory.Path(), 1 << 20);
+	BOOST_CHECK(reopened.Find(5));
+}
+
+BOOST_AUTO_TEST_CASE( keys )
+{
+	const uint64_t key = ResponseCache::MakeKey(1, 150e6, 1.0, 0.5);
+	BOOST_CHECK_EQUAL(ResponseCache::MakeKey(1, 150e6, 1.0, 0.5), key);
+	BOOST_CHECK_NE(ResponseCache::MakeKey(2, 150e6, 1.0, 0.5), key);
+	BOOST_CHECK_NE(ResponseCache::MakeKey(1, 160e6, 1.0, 0.5), key);
+	BOOST_CHECK_NE(ResponseCache::MakeKey(1, 150e6, 1.0, 0.6), key);
+}
+
+BOOST_AUTO_TEST_CASE( eviction )
+{
+	TemporaryDirectory directory;
+	ResponseCache cache(directory.Path(), 3 * entrySize());
+	for(uint64_t key=0; key!=3; ++key)
+		cache.Store(key, makeSamples(key));
+	// Using entry 0 makes entry 1 the least recently used one
+	BOOST_CHECK(cache.Find(0));
+	cache.Store(3, makeSamples(3.0));
+	BOOST_CHECK(cache.Find(0));
+	BOOST_CHECK(!cache.Find(1));
+	BOOST_CHECK(cache.Find(2));
+	BOOST_CHECK(cache.Find(3));
+
+	// An entry that is in use stays readable after it is evicted
+	std::unique_ptr<ResponseCache::Entry> entry = cache.Find(0);
+	BOOST_REQUIRE(entry);
+	cache.Store(4, makeSamples(4.0));
+	cache.Store(5, makeSamples(5.0));
+	cache.Store(6, makeSamples(6.0));
+	BOOST_CHECK(!cache.Find(0));
+	BOOST_CHECK_EQUAL(entry->begin()->time, 0.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
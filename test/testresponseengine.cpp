@@ -0,0 +1,108 @@
+#include "../beambackend.h"
+#include "../directionconverter.h"
+#include "../responseengine.h"
+
+#include <casacore/measures/Measures/MEpoch.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <cmath>
+#include <complex>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+	/** A backend of one station that records the directions it is evaluated in. */
+	class DirectionRecorder : public BeamBackend
+	{
+	public:
+		const char* Name() const override { return "recorder"; }
+
+		size_t StationCount() const override { return 1; }
+
+		const std::string& StationName(size_t) const override { return _name; }
+
+		void Response(size_t, double, double, const Vector3& direction, const Vector3&, const Vector3&, std::complex<double>* jones) const override
+		{
+			_directions.push_back(direction);
+			jones[0] = 1.0; jones[1] = 0.0;
+			jones[2] = 0.0; jones[3] = 1.0;
+		}
+
+		const std::vector<Vector3>& Directions() const { return _directions; }
+
+	private:
+		std::string _name = "station";
+		mutable std::vector<Vector3> _directions;
+	};
+
+	double angle(const BeamBackend::Vector3& a, const BeamBackend::Vector3& b)
+	{
+		const double difference[3] = { a[0]-b[0], a[1]-b[1], a[2]-b[2] };
+		return 2.0 * std::asin(0.5 * std::sqrt(difference[0]*difference[0] + difference[1]*difference[1] + difference[2]*difference[2]));
+	}
+
+	BeamBackend::Vector3 j2000Vector(double ra, double dec)
+	{
+		const BeamBackend::Vector3 vector = {{ std::cos(dec) * std::cos(ra), std::cos(dec) * std::sin(ra), std::sin(dec) }};
+		return vector;
+	}
+
+	BeamBackend::Vector3 sunDirection(double time)
+	{
+		const casacore::MeasFrame frame(casacore::MEpoch(casacore::Quantity(time, "s"), casacore::MEpoch::UTC));
+		const casacore::MDirection sun = casacore::MDirection::Convert(casacore::MDirection(casacore::MDirection::SUN), casacore::MDirection::Ref(casacore::MDirection::J2000, frame))();
+		const casacore::Vector<double> value = sun.getValue().getValue();
+		const BeamBackend::Vector3 result = {{ value[0], value[1], value[2] }};
+		return result;
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(responseengine)
+
+BOOST_AUTO_TEST_CASE( j2000_to_itrf )
+{
+	// Directions all over the sky, at times spread over a year so that the Sun
+	// and the aberration move around
+	std::vector<double> ra, dec;
+	for(int decDegrees=-90; decDegrees<=90; decDegrees+=10)
+	{
+		for(int raDegrees=0; raDegrees<360; raDegrees+=10)
+		{
+			ra.push_back(raDegrees * M_PI / 180.0);
+			dec.push_back(decDegrees * M_PI / 180.0);
+		}
+	}
+	std::vector<double> times;
+	for(size_t i=0; i!=6; ++i)
+		times.push_back((58849.0 + i * 61.0) * 86400.0 + i * 3600.0);
+
+	const std::shared_ptr<DirectionRecorder> recorder = std::make_shared<DirectionRecorder>();
+	const casacore::MDirection phaseCentre(casacore::MVDirection(2.1537, 0.8413), casacore::MDirection::J2000);
+	ResponseEngine engine(recorder, phaseCentre, phaseCentre);
+	engine.AddTimes(times.data(), times.size());
+	const double frequency = 150e6;
+	std::vector<std::complex<double>> jones(ra.size() * times.size() * 4);
+	engine.Jones(ra.data(), dec.data(), ra.size(), 0, times.size(), &frequency, 1, jones.data());
+	BOOST_REQUIRE_EQUAL(recorder->Directions().size(), ra.size() * times.size());
+
+	const double arcsecond = M_PI / 180.0 / 3600.0;
+	for(size_t timestep=0; timestep!=times.size(); ++timestep)
+	{
+		DirectionConverter converter(times[timestep]);
+		const BeamBackend::Vector3 sun = sunDirection(times[timestep]);
+		for(size_t d=0; d!=ra.size(); ++d)
+		{
+			const BeamBackend::Vector3& direction = recorder->Directions()[timestep * ra.size() + d];
+			const double error = angle(direction, converter.J2000ToITRF(ra[d], dec[d]));
+			// Only the deflection of light by the Sun is not part of the approximation
+			if(angle(j2000Vector(ra[d], dec[d]), sun) > 20.0 * M_PI / 180.0)
+				BOOST_CHECK_LT(error, 0.1 * arcsecond);
+			else
+				BOOST_CHECK_LT(error, 2.0 * arcsecond);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
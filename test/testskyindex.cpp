@@ -0,0 +1,129 @@
+#include "../model/skyindex.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace {
+	/** Random directions, uniform on the sphere, with some duplicated directions. */
+	struct Directions
+	{
+		explicit Directions(size_t count)
+		{
+			std::mt19937 rng(1);
+			std::uniform_real_distribution<double> uniform(0.0, 1.0);
+			for(size_t i=0; i!=count; ++i)
+			{
+				if(i % 100 == 7)
+				{
+					ra.push_back(ra.back());
+					dec.push_back(dec.back());
+				}
+				else {
+					ra.push_back(uniform(rng) * 2.0 * M_PI);
+					dec.push_back(std::asin(2.0 * uniform(rng) - 1.0));
+				}
+			}
+		}
+
+		/** The distances to all directions, nearest first, by brute force. */
+		std::vector<std::pair<double, size_t>> SortedDistances(double queryRA, double queryDec) const
+		{
+			std::vector<std::pair<double, size_t>> distances;
+			for(size_t i=0; i!=ra.size(); ++i)
+				distances.emplace_back(SkyIndex::Distance(queryRA, queryDec, ra[i], dec[i]), i);
+			std::sort(distances.begin(), distances.end());
+			return distances;
+		}
+
+		std::vector<double> ra, dec;
+	};
+
+	/** Adds the directions, building the index halfway so that both the tree and the unbuilt tail are searched. */
+	void fill(SkyIndex& index, const Directions& directions)
+	{
+		for(size_t i=0; i!=directions.ra.size(); ++i)
+		{
+			index.Add(directions.ra[i], directions.dec[i], i);
+			if(i == directions.ra.size() / 2)
+				index.Build();
+		}
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(skyindex)
+
+BOOST_AUTO_TEST_CASE( distance )
+{
+	BOOST_CHECK_SMALL(SkyIndex::Distance(1.0, 0.5, 1.0, 0.5), 1e-15);
+	BOOST_CHECK_CLOSE(SkyIndex::Distance(0.0, 0.0, M_PI * 0.5, 0.0), M_PI * 0.5, 1e-10);
+	BOOST_CHECK_CLOSE(SkyIndex::Distance(0.0, M_PI * 0.5, 2.0, 0.0), M_PI * 0.5, 1e-10);
+	// Across the wrap of the right ascension
+	BOOST_CHECK_CLOSE(SkyIndex::Distance(2.0 * M_PI - 1e-6, 0.0, 1e-6, 0.0), 2e-6, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE( cone_search )
+{
+	const Directions directions(5000);
+	SkyIndex index;
+	fill(index, directions);
+	std::mt19937 rng(2);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	for(size_t query=0; query!=50; ++query)
+	{
+		const double ra = uniform(rng) * 2.0 * M_PI, dec = std::asin(2.0 * uniform(rng) - 1.0), radius = uniform(rng) * 0.2;
+		const std::vector<std::pair<double, size_t>> expected = directions.SortedDistances(ra, dec);
+		const std::vector<size_t> cone = index.ConeSearch(ra, dec, radius);
+		size_t count = 0;
+		while(count != expected.size() && expected[count].first <= radius)
+			++count;
+		BOOST_REQUIRE_EQUAL(cone.size(), count);
+		// Nearest first
+		for(size_t i=0; i!=count; ++i)
+			BOOST_CHECK_CLOSE(SkyIndex::Distance(ra, dec, directions.ra[cone[i]], directions.dec[cone[i]]), expected[i].first, 1e-9);
+	}
+}
+
+BOOST_AUTO_TEST_CASE( nearest_neighbours )
+{
+	const Directions directions(5000);
+	SkyIndex index;
+	fill(index, directions);
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<double> uniform(0.0, 1.0);
+	for(size_t query=0; query!=50; ++query)
+	{
+		const double ra = uniform(rng) * 2.0 * M_PI, dec = std::asin(2.0 * uniform(rng) - 1.0);
+		const std::vector<std::pair<double, size_t>> expected = directions.SortedDistances(ra, dec);
+		const std::vector<size_t> nearest = index.NearestNeighbours(ra, dec, 8);
+		BOOST_REQUIRE_EQUAL(nearest.size(), 8u);
+		for(size_t i=0; i!=nearest.size(); ++i)
+			BOOST_CHECK_CLOSE(SkyIndex::Distance(ra, dec, directions.ra[nearest[i]], directions.dec[nearest[i]]), expected[i].first, 1e-9);
+
+		const size_t single = index.FindNearest(ra, dec, expected[0].first * 1.001);
+		BOOST_REQUIRE(single != SkyIndex::npos);
+		BOOST_CHECK_CLOSE(SkyIndex::Distance(ra, dec, directions.ra[single], directions.dec[single]), expected[0].first, 1e-9);
+		BOOST_CHECK_EQUAL(index.FindNearest(ra, dec, expected[0].first * 0.999), SkyIndex::npos);
+	}
+	BOOST_CHECK_EQUAL(index.NearestNeighbours(0.0, 0.0, 10000).size(), directions.ra.size());
+}
+
+BOOST_AUTO_TEST_CASE( find_exact )
+{
+	const Directions directions(1000);
+	SkyIndex index;
+	fill(index, directions);
+	for(size_t i=0; i!=directions.ra.size(); ++i)
+	{
+		// A duplicated direction is found at its first occurrence
+		const size_t found = index.FindExact(directions.ra[i], directions.dec[i]);
+		BOOST_CHECK_EQUAL(found, i % 100 == 7 ? i - 1 : i);
+	}
+	BOOST_CHECK_EQUAL(index.FindExact(directions.ra[0] + 1e-12, directions.dec[0]), SkyIndex::npos);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,178 @@
+#include "../model/model.h"
+#include "../model/modelparser.h"
+#include "../model/tokenizer.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+	/** All tokens of the text, as the stream tokenizer returned them. */
+	std::vector<std::string> tokenize(const std::string& text)
+	{
+		Tokenizer tokenizer;
+		tokenizer.SetText(text.data(), text.data() + text.size());
+		std::vector<std::string> tokens;
+		std::string_view token;
+		while(tokenizer.getToken(token))
+			tokens.emplace_back(token);
+		BOOST_CHECK(token.empty());
+		return tokens;
+	}
+
+	bool throwsMessage(const std::runtime_error& error, const std::string& message)
+	{
+		return error.what() == message;
+	}
+
+	void parse(const std::string& text)
+	{
+		Model model;
+		ModelParser().Parse(model, text.data(), text.size());
+	}
+}
+
+BOOST_AUTO_TEST_SUITE(tokenizer)
+
+BOOST_AUTO_TEST_CASE( tokens )
+{
+	typedef std::vector<std::string> Tokens;
+	BOOST_CHECK(tokenize("") == Tokens());
+	BOOST_CHECK(tokenize(" \t\n ") == Tokens());
+	BOOST_CHECK((tokenize("source {\n\tname \"a\"\n}") == Tokens{"source", "{", "name", "\"a\"", "}"}));
+	BOOST_CHECK((tokenize("a;b c") == Tokens{"a", "b", "c"}));
+	// The first character belongs to the token, even when it is a ';'
+	BOOST_CHECK((tokenize(";x") == Tokens{";x"}));
+	BOOST_CHECK((tokenize("a;;b") == Tokens{"a", ";b"}));
+	BOOST_CHECK((tokenize("a ; b") == Tokens{"a", ";", "b"}));
+	BOOST_CHECK((tokenize("a/b x") == Tokens{"a/b", "x"}));
+	BOOST_CHECK((tokenize("last") == Tokens{"last"}));
+}
+
+BOOST_AUTO_TEST_CASE( strings )
+{
+	typedef std::vector<std::string> Tokens;
+	BOOST_CHECK((tokenize("\"a b;c // d\" e") == Tokens{"\"a b;c // d\"", "e"}));
+	BOOST_CHECK((tokenize("\"two\nlines\"") == Tokens{"\"two\nlines\""}));
+	// The character after a string is not consumed as a separator
+	BOOST_CHECK((tokenize("\"a\"b") == Tokens{"\"a\"", "b"}));
+	BOOST_CHECK((tokenize("\"\" x") == Tokens{"\"\"", "x"}));
+
+	const std::string text = "\"name\" \"\" x";
+	Tokenizer tokenizer;
+	tokenizer.SetText(text.data(), text.data() + text.size());
+	BOOST_CHECK_EQUAL(tokenizer.getString(), "name");
+	BOOST_CHECK_EQUAL(tokenizer.getString(), "");
+	BOOST_CHECK_EXCEPTION(tokenizer.getString(), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Expecting string"); });
+}
+
+BOOST_AUTO_TEST_CASE( unterminated_string )
+{
+	typedef std::vector<std::string> Tokens;
+	// An unterminated string runs until the end of the text
+	BOOST_CHECK((tokenize("a \"open { b\n}") == Tokens{"a", "\"open { b\n}"}));
+	BOOST_CHECK((tokenize("\"") == Tokens{"\""}));
+
+	const std::string text = "\"open";
+	Tokenizer tokenizer;
+	tokenizer.SetText(text.data(), text.data() + text.size());
+	BOOST_CHECK_EXCEPTION(tokenizer.getString(), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Expecting string"); });
+	BOOST_CHECK_THROW(parse("skymodel fileformat 1.1\nsource {\n  name \"open\n}\n"), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( comments )
+{
+	typedef std::vector<std::string> Tokens;
+	BOOST_CHECK((tokenize("a // b \"c {\nd") == Tokens{"a", "d"}));
+	BOOST_CHECK((tokenize("// only\n// comments") == Tokens()));
+	BOOST_CHECK((tokenize("a //") == Tokens{"a"}));
+	// A comment only starts between tokens
+	BOOST_CHECK((tokenize("a//b c") == Tokens{"a//b", "c"}));
+	// A lone slash at the end of the text ends it
+	BOOST_CHECK((tokenize("a /") == Tokens{"a"}));
+
+	const std::string text = "a /b";
+	Tokenizer tokenizer;
+	tokenizer.SetText(text.data(), text.data() + text.size());
+	std::string_view token;
+	BOOST_CHECK(tokenizer.getToken(token));
+	BOOST_CHECK_EXCEPTION(tokenizer.getToken(token), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Incorrect /"); });
+}
+
+BOOST_AUTO_TEST_CASE( numbers )
+{
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("1.5"), 1.5);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("+1.5"), 1.5);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("-0.75"), -0.75);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("1e3"), 1000.0);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("2.5E-1"), 0.25);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("0"), 0.0);
+	// As with atof(), characters after the number are ignored
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("2x"), 2.0);
+	BOOST_CHECK_EQUAL(Tokenizer::toDouble("3;"), 3.0);
+
+	// Where atof() returned zero, a number is now required
+	for(const char* token : { "abc", "", "+", "-", "x2", "++1" })
+	{
+		const std::string message = std::string("Expecting number, got '") + token + "'";
+		BOOST_CHECK_EXCEPTION(Tokenizer::toDouble(token), std::runtime_error, [&](const std::runtime_error& e) { return throwsMessage(e, message); });
+	}
+
+	const std::string text = "150 MHz";
+	Tokenizer tokenizer;
+	tokenizer.SetText(text.data(), text.data() + text.size());
+	BOOST_CHECK_EQUAL(tokenizer.getTokenAsDouble(), 150.0);
+	BOOST_CHECK_THROW(tokenizer.getTokenAsDouble(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE( booleans )
+{
+	const std::string text = "1 true True 0 false False yes";
+	Tokenizer tokenizer;
+	tokenizer.SetText(text.data(), text.data() + text.size());
+	for(size_t i=0; i!=3; ++i)
+		BOOST_CHECK(tokenizer.getTokenAsBool());
+	for(size_t i=0; i!=3; ++i)
+		BOOST_CHECK(!tokenizer.getTokenAsBool());
+	BOOST_CHECK_EXCEPTION(tokenizer.getTokenAsBool(), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Expecting boolean"); });
+}
+
+BOOST_AUTO_TEST_CASE( strict_numbers_in_models )
+{
+	const std::string header = "skymodel fileformat 1.1\n";
+	const std::string source =
+		"source {\n"
+		"  name \"s\"\n"
+		"  component {\n"
+		"    type point\n"
+		"    position 08h13m36.0s 48d12m15.0s\n"
+		"    measurement {\n"
+		"      frequency 150 MHz\n"
+		"      fluxdensity Jy FLUX 0 0 0\n"
+		"    }\n"
+		"  }\n"
+		"}\n";
+	const auto withFlux = [&](const std::string& flux)
+	{
+		std::string text = header + source;
+		text.replace(text.find("FLUX"), 4, flux);
+		return text;
+	};
+
+	Model model;
+	const std::string valid = withFlux("+2.5");
+	ModelParser().Parse(model, valid.data(), valid.size());
+	BOOST_REQUIRE_EQUAL(model.SourceCount(), 1u);
+	BOOST_CHECK_EQUAL(model.Source(0).Peak().MSED().FluxAtLowestFrequency(), 2.5);
+
+	BOOST_CHECK_EXCEPTION(parse(withFlux("abc")), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Expecting number, got 'abc'"); });
+	std::string shape = header + source;
+	shape.replace(shape.find("FLUX"), 4, "1");
+	shape.insert(shape.find("    measurement"), "    shape 10 five 0\n");
+	BOOST_CHECK_EXCEPTION(parse(shape), std::runtime_error, [](const std::runtime_error& e) { return throwsMessage(e, "Expecting number, got 'five'"); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
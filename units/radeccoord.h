@@ -1,7 +1,9 @@
 #ifndef RADECCOORD_H
 #define RADECCOORD_H
 
+#include <charconv>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <stdexcept>
 #include <cstdlib>
@@ -16,10 +18,42 @@ class RaDecCoord
 	private:
 		static bool isRASeparator(char c) { return c==':' || c==' '; }
 		static bool isDecSeparator(char c) { return c=='.' || c==' '; }
+		
+		/**
+		 * Parses a number at the start of [first, last) like strtol() or
+		 * strtold(), but without requiring a terminating null character.
+		 * Returns the end of the number, or first and a value of zero when
+		 * there is no number.
+		 */
+		template<typename T>
+		static const char* parseNumber(const char* first, const char* last, T& value)
+		{
+			const char* position = first;
+			while(position != last && (*position == ' ' || *position == '\t'))
+				++position;
+			const bool negative = position != last && *position == '-';
+			if(position != last && (*position == '+' || *position == '-'))
+				++position;
+			value = 0;
+			const std::from_chars_result result = std::from_chars(position, last, value);
+			if(result.ec == std::errc::invalid_argument)
+				return first;
+			if(negative)
+				value = -value;
+			return result.ptr;
+		}
+		
+		static char at(const char* position, const char* end) { return position == end ? 0 : *position; }
+		
 	public:
-		static long double ParseRA(const std::string &str)
+		/**
+		 * The coordinates are parsed from a string_view, so that a token of a
+		 * model file can be parsed without copying it into a string.
+		 */
+		static long double ParseRA(std::string_view str)
 		{
-			char *cstr;
+			const char* const end = str.data() + str.size();
+			const char *cstr;
 			bool sign = false;
 			for(size_t i=0; i!=str.size(); ++i)
 			{
@@ -33,45 +67,50 @@ class RaDecCoord
 					break;
 				}
 			}
-			long double secs=0.0, mins=0.0,
-				hrs = strtol(str.c_str(), &cstr, 10);
+			long hrsInt, minsInt;
+			long double secs=0.0, mins=0.0;
+			cstr = parseNumber(str.data(), end, hrsInt);
+			const long double hrs = hrsInt;
 			// Parse format '00h00m00.0s'
-			if(*cstr == 'h')
+			if(at(cstr, end) == 'h')
 			{
 				++cstr;
-				mins = strtol(cstr, &cstr, 10);
-				if(*cstr == 'm')
+				cstr = parseNumber(cstr, end, minsInt);
+				mins = minsInt;
+				if(at(cstr, end) == 'm')
 				{
 					++cstr;
-					secs = strtold(cstr, &cstr);
-					if(*cstr == 's')
+					cstr = parseNumber(cstr, end, secs);
+					if(at(cstr, end) == 's')
 						++cstr;
 					else throw std::runtime_error("Missing 's'");
 				} else throw std::runtime_error("Missing 'm'");
 			}
 			// Parse format '00:00:00.0'
-			else if(isRASeparator(*cstr))
+			else if(isRASeparator(at(cstr, end)))
 			{
 				++cstr;
-				mins = strtol(cstr, &cstr, 10);
-				if(isRASeparator(*cstr))
+				cstr = parseNumber(cstr, end, minsInt);
+				mins = minsInt;
+				if(isRASeparator(at(cstr, end)))
 				{
 					++cstr;
-					secs = strtold(cstr, &cstr);
+					cstr = parseNumber(cstr, end, secs);
 				} else throw std::runtime_error("Missing ':' after minutes");
 			}
-			else throw std::runtime_error("Missing 'h' or ':' in string '" + str + "'");
-			if(*cstr != 0)
-				throw std::runtime_error("Could not parse RA '" + str + "' (string contains more tokens than expected)");
+			else throw std::runtime_error("Missing 'h' or ':' in string '" + std::string(str) + "'");
+			if(cstr != end)
+				throw std::runtime_error("Could not parse RA '" + std::string(str) + "' (string contains more tokens than expected)");
 			if(sign)
 				return (hrs/24.0 - mins/(24.0*60.0) - secs/(24.0*60.0*60.0))*2.0*M_PIl;
 			else
 				return (hrs/24.0 + mins/(24.0*60.0) + secs/(24.0*60.0*60.0))*2.0*M_PIl;
 		}
 		
-		static long double ParseDec(const std::string &str)
+		static long double ParseDec(std::string_view str)
 		{
-			char *cstr;
+			const char* const end = str.data() + str.size();
+			const char *cstr;
 			bool sign = false;
 			for(size_t i=0; i!=str.size(); ++i)
 			{
@@ -85,35 +124,39 @@ class RaDecCoord
 					break;
 				}
 			}
-			long double secs=0.0, mins=0.0,
-				degs = strtol(str.c_str(), &cstr, 10);
+			long degsInt, minsInt;
+			long double secs=0.0, mins=0.0;
+			cstr = parseNumber(str.data(), end, degsInt);
+			const long double degs = degsInt;
 			// Parse format '00d00m00.0s'
-			if(*cstr == 'd')
+			if(at(cstr, end) == 'd')
 			{
 				++cstr;
-				mins = strtol(cstr, &cstr, 10);
-				if(*cstr == 'm')
+				cstr = parseNumber(cstr, end, minsInt);
+				mins = minsInt;
+				if(at(cstr, end) == 'm')
 				{
 					++cstr;
-					secs = strtold(cstr, &cstr);
-					if(*cstr == 's')
+					cstr = parseNumber(cstr, end, secs);
+					if(at(cstr, end) == 's')
 						++cstr;
 					else throw std::runtime_error("Missing 's'");
 				} else throw std::runtime_error("Missing 'm'");
 			}
 			// Parse format '00.00.00.0'
-			else if(isDecSeparator(*cstr))
+			else if(isDecSeparator(at(cstr, end)))
 			{
 				++cstr;
-				mins = strtol(cstr, &cstr, 10);
-				if(isDecSeparator(*cstr))
+				cstr = parseNumber(cstr, end, minsInt);
+				mins = minsInt;
+				if(isDecSeparator(at(cstr, end)))
 				{
 					++cstr;
-					secs = strtold(cstr, &cstr);
+					cstr = parseNumber(cstr, end, secs);
 				} else throw std::runtime_error("Missing '.' after minutes");
 			}
 			else throw std::runtime_error("Missing 'd' or '.' after degrees");
-			if(*cstr != 0)
+			if(cstr != end)
 				throw std::runtime_error("Could not parse Dec (string contains more tokens than expected)");
 			else if(sign)
 				return (degs/360.0 - mins/(360.0*60.0) - secs/(360.0*60.0*60.0))*2.0*M_PIl;